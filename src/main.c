@@ -34,7 +34,7 @@
  * - Generate random values for a column
  * ~ Add the --auto flag to automatically coerce types in cases
  *   where needed.
- * - Work on offset and count to give the ability to process only
+ * ~ Work on offset and count to give the ability to process only
  *   a subset of rows WITHOUT having to write a custom query
  * - Open the code to run on Windows
  * - Add ability to generate random test data
@@ -57,11 +57,14 @@
 #include <stdio.h>
 #include <dirent.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <strings.h>
 #include <errno.h>
 #include <time.h>
 #include <limits.h>
+#include <math.h>
 #include <sys/mman.h>
+#include <pthread.h>
 #include "../vendor/zwalker.h"
 #include "../vendor/util.h"
 
@@ -86,6 +89,64 @@
 /* Terminating character in typemaps */
 #define TYPEMAP_TERM INT_MIN
 
+/* Most session settings a bulk profile can hold for one engine */
+#define BULK_MAX 16
+
+/* Rows read from an input per batch */
+#define BATCH_SIZE 1000
+
+/* Rows written to SQLite3 per transaction */
+#define SQLITE_TXN_ROWS 500000
+
+/* Everything after this in a DSN is the path to an SQLite3 database */
+#define SQLITE_PREFIX "sqlite3://"
+
+/* Name of the cursor used to stream Postgres input */
+#define PG_CURSOR "briggs_cursor"
+#define PARALLEL_DEPTH 4 // Batches each --parallel-read connection can get ahead by
+
+/* Bytes of COPY data --pipeline hands over at a time */
+#define PIPE_CHUNK 65536
+
+/* Sidecar line indexes are written next to the file with this suffix */
+#define INDEX_SUFFIX ".bidx"
+#define INDEX_MAGIC "BRIGGSI1"
+#define INDEX_STRIDE 65536 // Records between each offset kept in an index
+#define INDEX_SAMPLE 4096 // Bytes hashed from each end of a file to tell if it changed
+
+/* Types inferred for a file layout are cached in the --cache directory with this suffix */
+#define CACHE_SUFFIX ".bcache"
+#define CACHE_MAGIC "BRIGGSC1"
+
+/* Rows of a file looked at to infer types, unless --sample says otherwise */
+#define SAMPLE_ROWS 1000
+#define SAMPLE_THREADS 8 // Most threads a sample is split over
+#define SAMPLE_MIN_BYTES 4194304 // Least bytes worth giving a thread of their own
+
+/* Decimals inferred from a file, sized so MySQL can take them too */
+#define DECIMAL_DIGITS 15 // Digits a double holds, more than this needs a decimal
+#define DECIMAL_WHOLE 10 // Least whole digits given, since a sample can miss the biggest value
+#define DECIMAL_MAX_PRECISION 65
+#define DECIMAL_MAX_SCALE 30
+
+/* Column statistics gathered by --profile */
+#define PROFILE_HLL_BITS 12 // 4096 HyperLogLog registers per column, about 1.6% error
+#define PROFILE_TOPK 8 // Most common values printed per column
+#define PROFILE_SKETCH 64 // Values counted per column, exactly until there are more than this
+#define PROFILE_VARCHAR_MAX 255 // Longest string that gets a VARCHAR instead of TEXT
+
+/* Column names are cut to this many bytes (less the terminator) and interned */
+#define LABEL_MAX 128
+#define STRTAB_BLOCK 4096 // Bytes of interned names allocated at a time
+#define NAMEIDX_MIN 16 // Slots in a new name index
+
+/* What date_from_text() found */
+#define DATE_HAS_DATE 1
+#define DATE_HAS_TIME 2
+
+/* Days between the Unix and Postgres epochs (2000-01-01) */
+#define PG_EPOCH_DAYS 10957
+
 /* Print an error code and return 1 (false) on the command line */
 #define ERRPRINTF( C, ... ) \
 	fprintf( stderr, "briggs: " ) && (fprintf( stderr, __VA_ARGS__ ) ? C : C )
@@ -256,6 +317,8 @@ typedef enum type_t {
 	T_BOOLEAN,
 	T_BINARY, /* Assume that unsigned char * is what is expected */
 	T_DATE, //- Conversion to a base type (via tv_sec, tv_nsec ) might make the most sense)
+	T_DECIMAL, /* Exact numbers, kept as text so no digits are lost */
+	T_UUID, /* 8-4-4-4-12 hex, or 16 bytes on the wire */
 } type_t;
 
 
@@ -334,6 +397,37 @@ typedef enum {
 } dbtype_t;
 
 
+/**
+ * bulkopt_t
+ *
+ * A session setting applied to an output database when --bulk is used.
+ *
+ */
+typedef struct bulkopt_t {
+	dbtype_t type;
+	const char *name;
+	const char *value;
+	int optional; /* Some settings need privileges, so a refusal is not fatal */
+} bulkopt_t;
+
+
+/**
+ * ddl_t
+ *
+ * An index or constraint dropped from an output table for the 
+ * duration of a load, and the statements needed to put it back.
+ *
+ */
+typedef struct ddl_t {
+	char name[ 128 ];
+	char *drop;
+	char *create;
+	char *finish; /* Optional follow-up (e.g. VALIDATE CONSTRAINT) */
+	int online; /* Can be rebuilt without blocking writers */
+	int dropped;
+} ddl_t;
+
+
 /**
  * typemap_t
  *
@@ -350,6 +444,24 @@ typedef struct typemap_t {
 } typemap_t;
 
 
+/**
+ * index_t
+ *
+ * The header of a sidecar line index.  It is followed by olen offsets,
+ * where offsets[ i ] is the start of record i * stride.
+ *
+ */
+typedef struct index_t {
+	char magic[ 8 ];
+	unsigned long long size; // the file's size when it was indexed
+	long long mtime; // and when it was last changed
+	unsigned long long hash; // FNV-1a of the first and last INDEX_SAMPLE bytes
+	unsigned long long rows; // records after the header
+	unsigned long long stride; // records between two offsets
+	unsigned long long olen; // number of offsets
+} index_t;
+
+
 /**
  * file_t
  *
@@ -362,10 +474,43 @@ typedef struct file_t {
 	const void *start;  // free this at the end
 	unsigned long size; // the file's size
 	unsigned int offset;
+	zw_t walker; // where records_from_dsn() left off
+	index_t *index; // the sidecar index from --index, offsets follow it
 // int limit;
 } file_t;
 
 
+/**
+ * typedef union mysql_value_t 
+ *
+ * Native storage for one bound MySQL parameter.
+ *
+ */
+typedef union mysql_value_t {
+	long long i;
+	double d;
+	signed char t;
+	MYSQL_TIME ts;
+	unsigned char u[ 16 ];
+} mysql_value_t;
+
+
+/**
+ * typedef struct mysql_param_t 
+ *
+ * Everything one MySQL parameter points at.  The MYSQL_BIND keeps
+ * pointing here from row to row, so the statement only has to be
+ * bound again when a value changes buffer types.
+ *
+ */
+typedef struct mysql_param_t {
+	mysql_value_t val;
+	unsigned long len;
+	unsigned char *copy; // Text and raw bytes, copied out of the row
+	unsigned long size;
+} mysql_param_t;
+
+
 /**
  * typedef struct mysql_t 
  *
@@ -376,6 +521,9 @@ typedef struct mysql_t {
 	MYSQL *conn;
 	MYSQL_STMT *stmt;
 	MYSQL_BIND *bindargs;
+	mysql_param_t *params;
+	int plen;
+	int rebind; // A MYSQL_BIND changed since mysql_stmt_bind_param()
 	MYSQL_RES *res;
 	const char *query;
 } mysql_t;
@@ -392,22 +540,53 @@ typedef struct pgsql_t {
 	PGresult *res;
 	char **bindargs;
 	int *bindlens;
-	Oid *bindoids;
+	Oid *targets; // What the INSERT's parameters turned out to be, from the table itself
 	int *bindfmts; // the smallest I can think of
 	int arglen;	
 	const char *query;
+	int copy; // Rows go through COPY ... FROM STDIN instead of INSERT
+	char *copybuf;
+	int copysize;
+	unsigned char *argbuf; // Binary parameter values for the current row
+	int argsize;
+	int chunked; // Input rows arrive in chunks from one query
+	int cursor; // Input rows come from FETCH on a server-side cursor
+	int consumed; // res has been handed to records_from_dsn() already
+	int copyout; // Input rows come from COPY ... TO STDOUT (see copy_t)
+	int copydone;
+	int binary; // Input rows come back in binary (see --binary)
 } pgsql_t;
 
 
-#if 0
-// TODO: If we ever add the SQLite backend support...
+#ifdef BSQLITE_H
+/**
+ * typedef struct sqlite3_t 
+ *
+ * Collection of common SQLite3 structures.
+ *
+ */
 typedef struct sqlite3_t {
 	sqlite3 *conn;
 	sqlite3_stmt *stmt;
+	int pending; // Rows written since the last COMMIT
+	int status; // Last sqlite3_step() on an input, SQLITE_ROW while a row is waiting
 } sqlite3_t;
 #endif
 
 
+/**
+ * typedef enum copy_t
+ *
+ * Formats --copy can read Postgres input in.
+ *
+ */
+typedef enum {
+	COPY_NONE,
+	COPY_TEXT,
+	COPY_CSV
+} copy_t;
+
+
 /**
  * typedef enum bindtype_t
  *
@@ -424,6 +603,37 @@ typedef enum {
 } bindtype_t;
 
 
+/**
+ * typedef struct nameidx_t 
+ *
+ * Open-addressed hash table from names to anything, so that wide
+ * tables don't compare every column name to every other name.
+ * Names are not copied, and the first value added for one wins.
+ *
+ */
+typedef struct nameidx_t {
+	const char **keys;
+	void **values;
+	unsigned int size; // Always a power of two
+	unsigned int count;
+	int nocase; // Names match with strcasecmp()
+} nameidx_t;
+
+
+/**
+ * typedef struct strtab_t 
+ *
+ * Interned strings, kept in blocks so that they never move.
+ *
+ */
+typedef struct strtab_t {
+	nameidx_t idx;
+	char **blocks;
+	int blen;
+	int used; // Bytes taken from the last block
+} strtab_t;
+
+
 /**
  * header_t
  *
@@ -431,8 +641,8 @@ typedef enum {
  *
  */
 typedef struct header_t {
-	/* Name of the column */
-	char label[ 128 ];
+	/* Name of the column, interned in the source's strtab_t */
+	const char *label;
 
 	/* Whether or not this column should be treated as a primary key */
 	int primary;
@@ -454,6 +664,19 @@ typedef struct header_t {
 	/* The preferred type to use */
 	typemap_t *ptype;
 
+	/* Each shape of date seen in a file column (1 << what date_from_text() found) */
+	int date;
+
+	/* Total and fractional digits of a T_DECIMAL column, if known */
+	int precision;
+	int scale;
+
+	/* What --profile found: the longest value (if it chose a VARCHAR), 
+	   whether there were no blanks, and whether every value looked unique */
+	int maxlen;
+	int notnull;
+	int candidate;
+
 } header_t;
 
 
@@ -480,13 +703,19 @@ typedef struct record_t {
  *
  */
 typedef struct column_t {
-  char *k;
+  const char *k;
   unsigned char *v;
 	type_t type;
 	type_t exptype;
 	int realtype;
 	unsigned long len;
 	date_t date;
+	int dated; // What date_from_text() found in v, once date holds it
+	int typed; // Postgres type OID while v still holds a binary value (see --binary)
+	union {
+		long long i;
+		double d;
+	} num; // ...and that value decoded
 } column_t;
 
 
@@ -500,6 +729,8 @@ typedef struct column_t {
 typedef struct row_t {
 	column_t **columns;
 	int clen;
+	void *data; // Values owned by this row (if the source can't keep them around)
+	void (*freedata)( void * ); // How to free data, if not free()
 #if 0
 	// The database engines have some strange requirements
 #endif
@@ -527,10 +758,12 @@ typedef struct dsn_t {
 	void *conn;
 	//void *res;
 	header_t **headers;
+	strtab_t labels;
 	row_t **rows;
 	int hlen;
 	int rlen;
 	int clen;
+	unsigned long rtotal; // Rows handled across every batch
 	//char **defs;
 	//FILE *output;
 	const typemap_t *typemap;
@@ -540,6 +773,31 @@ typedef struct dsn_t {
 	stream_t stream;
 	int input;
 
+	/* Session values saved before --bulk changed them (see bulk_profile) */
+	char bulksaved[ BULK_MAX ][ 64 ];
+	char bulkstate[ BULK_MAX ];
+
+	/* Indexes and constraints dropped by --defer-indexes */
+	ddl_t **ddl;
+	int ddllen;
+	char ddlfile[ 256 ];
+
+	/* The real table when --stage is loading into a shadow table */
+	char livename[ 64 ];
+
+	/* Connections splitting the read for --parallel-read */
+	struct parallel_t *parallel;
+	int range; // This is one of them, so an empty result is fine
+
+	/* Connections sharing the writes for --parallel-write */
+	struct writers_t *writers;
+
+	/* Both tables are on one server, so copy with INSERT ... SELECT */
+	int pushdown;
+
+	/* Postgres to Postgres, so COPY BINARY goes straight through (see pipe_dsn) */
+	int pipe;
+
 	char *rowd;
 	char *cold;
 } dsn_t;
@@ -600,6 +858,27 @@ typedef struct config_t {
 	char wnounsigned;
 	char wspcase;
 	char wstats;   // Use the stats
+	char wbulk;   // Tune output sessions for bulk loading
+	char wdefer;   // Drop secondary indexes during a load and rebuild them after
+	char wstage;   // Load into a shadow table and swap it with the real one
+	char wcopy;   // Read Postgres input with COPY ... TO STDOUT (a copy_t)
+	char wbinary;   // Read Postgres input in binary instead of text
+	int wparallel;   // Read the input over this many connections
+	char *wsplitcol;   // Column to split --parallel-read ranges on
+	char wordered;   // Keep --parallel-read rows in order
+	int wwriters;   // Write the output over this many connections
+	char wnopushdown;   // Always move rows through here, even on the same server
+	char wpipeline;   // Read and write a Postgres to Postgres pipe on separate threads
+	unsigned long wlimit;   // Read no more than this many rows
+	unsigned long woffset;   // Skip this many rows before reading
+	char windex;   // Keep a sidecar line index next to file inputs
+	char wcount;   // Count the rows of the input only
+	char wprogress;   // Show progress while converting
+	unsigned long wsample;   // Rows of a file to infer types from, 0 for all of them
+	char wspread;   // Spread the --sample rows across the whole file
+	char wprofile;   // Profile every column of a file input
+	char *wcache;   // Directory to cache the types inferred for a file layout in
+	char wrefresh;   // Infer types again, even if they are cached
 	char *wid;   // Use a unique ID when reading from a datasource
 	char *wcutcols;  // The user wants to cut columns
 	char *widname;  // The unique ID column name
@@ -615,11 +894,128 @@ typedef struct config_t {
 	char *wcold;
 #ifdef DEBUG_H
 	char wdumpdsn;
+	char wbenchtypes;
 #endif
 
 } config_t;
 
 
+/**
+ * typedef struct batch_t 
+ *
+ * Rows read by one --parallel-read connection, or waiting for a 
+ * --parallel-write connection.
+ *
+ */
+typedef struct batch_t {
+	row_t **rows;
+	int rlen;
+	void *res; // Postgres result the values point into
+	unsigned long first; // Number of rows read before this batch
+} batch_t;
+
+
+/**
+ * typedef struct reader_t 
+ *
+ * One --parallel-read connection and the range it reads.
+ *
+ */
+typedef struct reader_t {
+	dsn_t dsn;
+	config_t conf;
+	char query[ 2048 ];
+	struct parallel_t *p;
+	pthread_t thread;
+	int started;
+	batch_t queue[ PARALLEL_DEPTH ];
+	int head;
+	int count;
+	int done; // 1 when the range is read, -1 if it failed
+	char err[ ERRLEN ];
+} reader_t;
+
+
+/**
+ * typedef struct parallel_t 
+ *
+ * Readers for --parallel-read, and the queue between them and the writer.
+ *
+ */
+typedef struct parallel_t {
+	reader_t *readers;
+	int rlen;
+	int next; // Reader to take the next batch from
+	int ordered;
+	int stop;
+	void *held; // Result behind the batch being written now
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+} parallel_t;
+
+
+/**
+ * typedef struct writer_t 
+ *
+ * One --parallel-write connection.
+ *
+ */
+typedef struct writer_t {
+	dsn_t dsn;
+	dsn_t source; // The input, pointing at the batch being written
+	struct writers_t *w;
+	pthread_t thread;
+	int started;
+	char err[ ERRLEN ];
+} writer_t;
+
+
+/**
+ * typedef struct writers_t 
+ *
+ * Writers for --parallel-write, and the queue the reader fills for them.
+ * Each batch is written in its own transaction, so a batch is either 
+ * acknowledged whole or not written at all.
+ *
+ */
+typedef struct writers_t {
+	writer_t *writers;
+	int wlen;
+	batch_t *queue;
+	int head;
+	int count;
+	int size;
+	int closed; // Nothing more is coming
+	int stop;
+	int failed;
+	unsigned long acked; // Rows in batches that were committed
+	unsigned long failfirst, faillast; // Rows in the batch that failed
+	char err[ ERRLEN ];
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+} writers_t;
+
+
+/**
+ * typedef struct pipe_t 
+ *
+ * COPY data read by the --pipeline thread, waiting to be written.
+ *
+ */
+typedef struct pipe_t {
+	void *conn; // The input's PGconn
+	struct { char *data; int len; } chunks[ PARALLEL_DEPTH ];
+	int head;
+	int count;
+	int done; // 1 when the COPY finished, -1 when it failed
+	int stop;
+	unsigned long rows; // What the server said it sent
+	char err[ ERRLEN ];
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+} pipe_t;
+
+
 /* --Data */
 streamtype_t streams[] = {
 #if 0
@@ -658,6 +1054,8 @@ static const char * itypes[] = {
 	[T_BOOLEAN] = "T_BOOLEAN",
 	[T_BINARY] = "T_BINARY",
 	[T_DATE] = "T_DATE",
+	[T_DECIMAL] = "T_DECIMAL",
+	[T_UUID] = "T_UUID",
 };
 
 
@@ -681,6 +1079,8 @@ const typemap_t default_map[] = {
 	{ T_BINARY, N(T_BINARY), "BLOB", T_BINARY, 0, 1 },
 	{ T_BOOLEAN, N(T_BOOLEAN), "BOOLEAN", T_BOOLEAN, 0, 1 },
 	{ T_DATE, N(T_DATE), "DATE", T_DATE, 0, 1 },
+	{ T_DECIMAL, N(T_DECIMAL), "DECIMAL", T_DECIMAL, 0, 1 },
+	{ T_UUID, N(T_UUID), "CHAR(36)", T_UUID, 16, 1 },
 
 	/* Supporting base dates is EXTREMELY difficult... be careful supporting it */
 	{ TYPEMAP_TERM },
@@ -689,13 +1089,18 @@ const typemap_t default_map[] = {
 
 const typemap_t sqlite3_map[] = {
 	{ T_NULL, N(T_NULL), NULL, T_NULL, 0 },
-	{ T_STRING, N(T_STRING), "TEXT", T_STRING, 1 },
+	{ T_STRING, N(T_STRING), "TEXT", T_STRING, 0, 1 },
 	/* NOTE: This will force STRING to take precedence over CHAR.  DO NOT TOUCH THIS */
-	{ T_CHAR, N(T_CHAR), "TEXT", T_CHAR, 1 },
-	{ T_INTEGER, N(T_INTEGER), "INTEGER", T_INTEGER, 1 },
-	{ T_DOUBLE, N(T_DOUBLE), "REAL", T_DOUBLE, 1 },
-	{ T_BINARY, N(T_BINARY), "BLOB", T_BINARY, 1 },
-	{ T_INTEGER, N(T_INTEGER), "INTEGER", T_BOOLEAN, 1 },
+	{ T_CHAR, N(T_CHAR), "TEXT", T_CHAR, 0, 1 },
+	{ T_INTEGER, N(T_INTEGER), "INTEGER", T_INTEGER, 0, 1 },
+	{ T_DOUBLE, N(T_DOUBLE), "REAL", T_DOUBLE, 0, 1 },
+	{ T_BINARY, N(T_BINARY), "BLOB", T_BINARY, 0, 1 },
+	{ T_INTEGER, N(T_INTEGER), "INTEGER", T_BOOLEAN, 0, 1 },
+	/* SQLite has no date type, ISO 8601 text sorts and compares fine */
+	{ T_DATE, N(T_DATE), "TEXT", T_DATE, 0, 1 },
+	/* ...and no decimal or UUID type either, NUMERIC would turn 12.50 into a REAL */
+	{ T_DECIMAL, N(T_DECIMAL), "TEXT", T_DECIMAL, 0, 1 },
+	{ T_UUID, N(T_UUID), "TEXT", T_UUID, 0, 1 },
 	{ TYPEMAP_TERM },
 };
 
@@ -734,13 +1139,17 @@ static const char * dbtypes[] = {
 #define PG_BITOID 1560
 #define PG_VARBITOID 1562
 #define PG_INTERVALOID 1186
+#define PG_UUIDOID 2950
+
+/* Named, since the BEGIN and COMMIT around each batch would throw away an unnamed statement */
+#define PG_INSERT_STMT "briggs_insert"
 
 static const typemap_t pgsql_map[] = {
 	{ PG_INT2OID, N(PG_INT2OID), "smallint", T_INTEGER, sizeof( short ), 0 },
 	{ PG_INT4OID, N(PG_INT4OID), "int", T_INTEGER, sizeof( int ), 1, },
 	{ PG_INT4OID, N(PG_INT4OID), "integer", T_INTEGER, sizeof( int ), 0, },
-	{ PG_INT8OID, N(PG_INT8OID), "bigint", T_INTEGER, sizeof( int ), 0 },
-	{ PG_NUMERICOID, N(PG_NUMERICOID), "numeric", T_DOUBLE, sizeof( double ),  0 },
+	{ PG_INT8OID, N(PG_INT8OID), "bigint", T_INTEGER, sizeof( long long ), 0 },
+	{ PG_NUMERICOID, N(PG_NUMERICOID), "numeric", T_DECIMAL, 0, 1 },
 	{ PG_FLOAT4OID, N(PG_FLOAT4OID), "real", T_DOUBLE, sizeof( double ), 1 }, /* or float4 */
 	{ PG_FLOAT8OID, N(PG_FLOAT8OID), "double precision", T_DOUBLE, sizeof( double ), 0 }, /* or float8 */
 	{ PG_TEXTOID, N(PG_TEXTOID), "text", T_STRING, 0, 1 },
@@ -752,6 +1161,7 @@ static const typemap_t pgsql_map[] = {
 	{ PG_DATEOID, N(PG_DATEOID), "date", T_DATE, 0 },
 	{ PG_TIMEOID, N(PG_TIMEOID), "time", T_DATE, 0 },
 	{ PG_TIMESTAMPOID, N(PG_TIMESTAMPOID), "timestamp", T_DATE, 0, 1 },
+	{ PG_UUIDOID, N(PG_UUIDOID), "uuid", T_UUID, 16, 1 },
 #if 0
 	{ PG_INTERVALOID, N(PG_INTERVALOID), "interval", T_DATE },
 	{ PG_DATETIMEOID, N(PG_DATETIMEOID), "datetime", T_DATE },
@@ -771,19 +1181,23 @@ static const typemap_t pgsql_map[] = {
 
 #ifdef BMYSQL_H
 static const typemap_t mysql_map[] = {
-	{ MYSQL_TYPE_TINY, N(MYSQL_TYPE_TINY), "TINYINT", T_INTEGER, sizeof( short ) },
-	{ MYSQL_TYPE_SHORT, N(MYSQL_TYPE_SHORT), "SMALLINT", T_INTEGER, sizeof( int ) },
-	{ MYSQL_TYPE_LONG, N(MYSQL_TYPE_LONG), "INT", T_INTEGER, sizeof( long ), 1 },
+	{ MYSQL_TYPE_TINY, N(MYSQL_TYPE_TINY), "TINYINT", T_INTEGER, sizeof( char ) },
+	{ MYSQL_TYPE_SHORT, N(MYSQL_TYPE_SHORT), "SMALLINT", T_INTEGER, sizeof( short ) },
+	{ MYSQL_TYPE_LONG, N(MYSQL_TYPE_LONG), "INT", T_INTEGER, sizeof( int ), 1 },
 	{ MYSQL_TYPE_LONG, N(MYSQL_TYPE_LONG), "INTEGER", T_INTEGER, sizeof( int ), 0 },
-	{ MYSQL_TYPE_INT24, N(MYSQL_TYPE_INT24), "MEDIUMINT", T_INTEGER, sizeof( int ) },
-	{ MYSQL_TYPE_LONGLONG, N(MYSQL_TYPE_LONGLONG), "BIGINT", T_INTEGER, sizeof( int ) },
+	{ MYSQL_TYPE_INT24, N(MYSQL_TYPE_INT24), "MEDIUMINT", T_INTEGER, 3 },
+	{ MYSQL_TYPE_LONGLONG, N(MYSQL_TYPE_LONGLONG), "BIGINT", T_INTEGER, sizeof( long long ) },
 	{ MYSQL_TYPE_DOUBLE, N(MYSQL_TYPE_DOUBLE), "DOUBLE", T_DOUBLE, sizeof( double ), 0 },
-	{ MYSQL_TYPE_DECIMAL, N(MYSQL_TYPE_DECIMAL), "DECIMAL", T_DOUBLE, sizeof( double ) }, /* or NUMERIC */
-	{ MYSQL_TYPE_NEWDECIMAL, N(MYSQL_TYPE_NEWDECIMAL), "NUMERIC", T_DOUBLE, sizeof( double ) }, /* or NUMERIC */
+	{ MYSQL_TYPE_NEWDECIMAL, N(MYSQL_TYPE_NEWDECIMAL), "DECIMAL", T_DECIMAL, 0, 1 }, /* or NUMERIC */
+	{ MYSQL_TYPE_NEWDECIMAL, N(MYSQL_TYPE_NEWDECIMAL), "NUMERIC", T_DECIMAL, 0 },
+	{ MYSQL_TYPE_DECIMAL, N(MYSQL_TYPE_DECIMAL), "DECIMAL", T_DECIMAL, 0 }, /* Before MySQL 5.0.3 */
 	{ MYSQL_TYPE_FLOAT, N(MYSQL_TYPE_FLOAT), "FLOAT", T_DOUBLE, sizeof( double ), 1 },
 	{ MYSQL_TYPE_STRING, N(MYSQL_TYPE_STRING), "CHAR", T_CHAR, 0, 1 },
 	{ MYSQL_TYPE_VAR_STRING, N(MYSQL_TYPE_VAR_STRING), "TEXT", T_STRING, 0, 1 },
+	{ MYSQL_TYPE_VAR_STRING, N(MYSQL_TYPE_VAR_STRING), "VARCHAR", T_STRING, 0, 0 },
 	{ MYSQL_TYPE_BLOB, N(MYSQL_TYPE_BLOB), "BLOB", T_BINARY, 0, 1 },
+	/* No UUID type, but 16 raw bytes beat 36 characters */
+	{ MYSQL_TYPE_STRING, N(MYSQL_TYPE_STRING), "BINARY(16)", T_UUID, 16, 1 },
 	/* This just maps to TINYINT behind the scenes */ 
 	{ MYSQL_TYPE_TINY, N(MYSQL_TYPE_TINY), "BOOL", T_BOOLEAN, 0, 1 },
 #if 1
@@ -801,6 +1215,35 @@ static const typemap_t mysql_map[] = {
 #endif
 
 
+/*
+ * Session settings applied by --bulk when an output database is opened.
+ * Whatever the session had before is saved and put back by close_dsn().
+ */
+static const bulkopt_t bulk_profile[] = {
+#ifdef BPGSQL_H
+	/* Don't wait for the WAL flush on every commit */
+	{ DB_POSTGRESQL, "synchronous_commit", "off", 0 },
+	/* Index builds after the load get more room to sort */
+	{ DB_POSTGRESQL, "maintenance_work_mem", "'1GB'", 0 },
+#endif
+#ifdef BMYSQL_H
+	{ DB_MYSQL, "unique_checks", "0", 0 },
+	{ DB_MYSQL, "foreign_key_checks", "0", 0 },
+	/* Needs SUPER or BINLOG ADMIN */
+	{ DB_MYSQL, "sql_log_bin", "0", 1 },
+#endif
+#ifdef BSQLITE_H
+	/* A crash mid-load can leave the file corrupt, but it is being rebuilt anyway */
+	{ DB_SQLITE, "journal_mode", "OFF", 0 },
+	{ DB_SQLITE, "synchronous", "OFF", 0 },
+	/* About 256MB of page cache (negative is in KiB) */
+	{ DB_SQLITE, "cache_size", "-262144", 0 },
+	{ DB_SQLITE, "temp_store", "MEMORY", 0 },
+#endif
+	{ DB_NONE, NULL, NULL, 0 },
+};
+
+
 
 // Global variables to ease testing
 char delset[ 8 ] = { 13 /*'\r'*/, 10 /*'\n'*/, 0, 0, 0, 0, 0, 0 };
@@ -876,6 +1319,12 @@ void print_ctypes( coerce_t ** );
 #endif
 
 void free_ctypes( coerce_t **ctypes );
+int date_from_text( const unsigned char *v, unsigned long len, date_t *d );
+static int uuid_from_text( const unsigned char *v, unsigned long len, unsigned char *out );
+static void select_for_dsn ( dsn_t *conn, config_t *conf, char *query, int len );
+int records_from_readers( dsn_t *conn, char *err, int errlen );
+int transform_from_dsn( dsn_t *iconn, dsn_t *oconn, int count, int offset, char *err, int errlen );
+void close_dsn( dsn_t *conn );
 
 /**
  * static const char * get_conn_type( dbtype_t t ) 
@@ -916,7 +1365,7 @@ typemap_t * get_typemap_by_ntype ( const typemap_t *types, int type ) {
 typemap_t * get_typemap_by_nname ( const typemap_t *types, const char *name ) {
 	for ( const typemap_t *t = types; t->ntype != TYPEMAP_TERM; t++ ) {
 		//DPRINTF( "%s: Checking types: %s ?= %s\n", __func__, name, t->name ); 
-		if ( !strcasecmp( name, t->name ) ) {
+		if ( t->name && !strcasecmp( name, t->name ) ) {
 			return (typemap_t *)t;
 		}
 	}
@@ -924,6 +1373,168 @@ typemap_t * get_typemap_by_nname ( const typemap_t *types, const char *name ) {
 }
 
 
+/**
+ * static unsigned int hash_name ( const char *s, int nocase ) 
+ *
+ * FNV-1a over a name, folding case if asked to.
+ *
+ */
+static unsigned int hash_name ( const char *s, int nocase ) {
+	unsigned int h = 2166136261U;
+	for ( ; *s; s++ ) {
+		h = ( h ^ (unsigned char)( ( nocase ) ? tolower( (unsigned char)*s ) : *s ) ) * 16777619U;
+	}
+	return h;
+}
+
+
+/**
+ * static unsigned int nameidx_find ( const nameidx_t *idx, const char *key ) 
+ *
+ * Find the slot holding key, or the empty one where it would go.
+ *
+ */
+static unsigned int nameidx_find ( const nameidx_t *idx, const char *key ) {
+	unsigned int i = hash_name( key, idx->nocase ) & ( idx->size - 1 );
+	for ( ; idx->keys[ i ]; i = ( i + 1 ) & ( idx->size - 1 ) ) {
+		if ( !( ( idx->nocase ) ? strcasecmp( idx->keys[ i ], key ) : strcmp( idx->keys[ i ], key ) ) ) break;
+	}
+	return i;
+}
+
+
+/**
+ * static void * nameidx_get ( const nameidx_t *idx, const char *key ) 
+ *
+ * Get whatever was added under key, or NULL.
+ *
+ */
+static void * nameidx_get ( const nameidx_t *idx, const char *key ) {
+	return ( idx->size ) ? idx->values[ nameidx_find( idx, key ) ] : NULL;
+}
+
+
+/**
+ * static int nameidx_add ( nameidx_t *idx, const char *key, void *value ) 
+ *
+ * Add a name to an index, unless it is already there.  key has to 
+ * live as long as the index does.
+ *
+ */
+static int nameidx_add ( nameidx_t *idx, const char *key, void *value ) {
+	unsigned int i = 0;
+
+	// Stay at most half full, so that probes stay short
+	if ( ( idx->count + 1 ) * 2 > idx->size ) {
+		nameidx_t n = { NULL, NULL, ( idx->size ) ? idx->size * 2 : NAMEIDX_MIN, 0, idx->nocase };
+
+		if ( !( n.keys = malloc( sizeof( char * ) * n.size ) ) || !( n.values = malloc( sizeof( void * ) * n.size ) ) ) {
+			free( n.keys );
+			return 0;
+		}
+
+		memset( n.keys, 0, sizeof( char * ) * n.size ), memset( n.values, 0, sizeof( void * ) * n.size );
+		for ( unsigned int j = 0; j < idx->size; j++ ) {
+			if ( idx->keys[ j ] ) {
+				i = nameidx_find( &n, idx->keys[ j ] );
+				n.keys[ i ] = idx->keys[ j ], n.values[ i ] = idx->values[ j ], n.count++;
+			}
+		}
+
+		free( idx->keys ), free( idx->values );
+		*idx = n;
+	}
+
+	if ( !idx->keys[ i = nameidx_find( idx, key ) ] ) {
+		idx->keys[ i ] = key, idx->values[ i ] = value, idx->count++;
+	}
+
+	return 1;
+}
+
+
+/**
+ * static void free_nameidx ( nameidx_t *idx ) 
+ *
+ * Free a name index, but not the names.
+ *
+ */
+static void free_nameidx ( nameidx_t *idx ) {
+	free( idx->keys ), free( idx->values );
+	memset( idx, 0, sizeof( nameidx_t ) );
+}
+
+
+/**
+ * static int index_typemap ( nameidx_t *idx, const typemap_t *types ) 
+ *
+ * Index a typemap by name, the same way get_typemap_by_nname() 
+ * would find them.
+ *
+ */
+static int index_typemap ( nameidx_t *idx, const typemap_t *types ) {
+	idx->nocase = 1;
+	for ( const typemap_t *t = types; t->ntype != TYPEMAP_TERM; t++ ) {
+		if ( t->name && !nameidx_add( idx, t->name, (void *)t ) ) return 0;
+	}
+	return 1;
+}
+
+
+/**
+ * static const char * intern ( strtab_t *tab, const char *s, int len ) 
+ *
+ * Get the one copy of the first len bytes of s (cut to LABEL_MAX) 
+ * kept in tab, adding it if this is the first time it was seen.
+ *
+ */
+static const char * intern ( strtab_t *tab, const char *s, int len ) {
+	char b[ LABEL_MAX ] = { 0 };
+	char *block = NULL;
+	const char *v = NULL;
+
+	len = ( len < sizeof( b ) ) ? len : sizeof( b ) - 1;
+	memcpy( b, s, len );
+	if ( ( v = nameidx_get( &tab->idx, b ) ) ) {
+		return v;
+	}
+
+	// Start a new block when this one is full
+	if ( !tab->blen || tab->used + len + 1 > STRTAB_BLOCK ) {
+		if ( !( block = malloc( STRTAB_BLOCK ) ) || !add_item( &tab->blocks, block, char *, &tab->blen ) ) {
+			free( block );
+			return NULL;
+		}
+		tab->used = 0;
+	}
+
+	block = &tab->blocks[ tab->blen - 1 ][ tab->used ];
+	memcpy( block, b, len + 1 );
+	if ( !nameidx_add( &tab->idx, block, block ) ) {
+		return NULL;
+	}
+
+	tab->used += len + 1;
+	return block;
+}
+
+
+/**
+ * static void free_strtab ( strtab_t *tab ) 
+ *
+ * Free every string interned in tab.
+ *
+ */
+static void free_strtab ( strtab_t *tab ) {
+	for ( char **b = tab->blocks; b && *b; b++ ) {
+		free( *b );
+	}
+	free( tab->blocks );
+	free_nameidx( &tab->idx );
+	memset( tab, 0, sizeof( strtab_t ) );
+}
+
+
 /**
  * typemap_t * get_typemap_by_btype ( const typemap_t *types, int btype ) 
  *
@@ -947,6 +1558,40 @@ typemap_t * get_typemap_by_btype ( const typemap_t *types, int btype ) {
 }
 
 
+/**
+ * typemap_t * get_typemap_by_date ( const typemap_t *types, int found ) 
+ *
+ * Get the date, time or timestamp type that fits what date_from_text()
+ * found in a column.  Engines without a separate date or time type 
+ * get their preferred one.
+ *
+ */
+typemap_t * get_typemap_by_date ( const typemap_t *types, int found ) {
+	const char *name = ( found == DATE_HAS_DATE ) ? "date" : ( found == DATE_HAS_TIME ) ? "time" : NULL;
+	for ( const typemap_t *t = types; name && t->ntype != TYPEMAP_TERM; t++ ) {
+		if ( t->basetype == T_DATE && !strcasecmp( name, t->name ) ) return (typemap_t *)t;
+	}
+	return get_typemap_by_btype( types, T_DATE );
+}
+
+
+/**
+ * typemap_t * get_typemap_by_size ( const typemap_t *types, int btype, unsigned long size ) 
+ *
+ * Get the smallest type of a base type that is at least size bytes,
+ * for engines that have more than one.  Types without a size don't
+ * count.
+ *
+ */
+typemap_t * get_typemap_by_size ( const typemap_t *types, int btype, unsigned long size ) {
+	const typemap_t *best = NULL;
+	for ( const typemap_t *t = types; t->ntype != TYPEMAP_TERM; t++ ) {
+		if ( btype == t->basetype && t->size >= size && ( !best || t->size < best->size ) ) best = t;
+	}
+	return (typemap_t *)best;
+}
+
+
 /**
  * static void snakecase ( char **k ) 
  *
@@ -1075,6 +1720,52 @@ static char * copy( char *src, int size, int *ns, case_t t ) {
 }
 
 
+/**
+ * vclass
+ *
+ * The class of every byte a value can hold.  get_type() ORs together
+ * the classes of a value's bytes and decides from the result, instead
+ * of branching on each character.  Tabs are text, and so is every
+ * byte above 0x7f, so that UTF-8 stays a string.  Only control bytes
+ * are binary.
+ *
+ */
+#define VC_DIGIT 0x01
+#define VC_DOT 0x02
+#define VC_MINUS 0x04
+#define VC_TEXT 0x08
+#define VC_BINARY 0x10
+
+#define D VC_DIGIT
+#define P VC_DOT
+#define M VC_MINUS
+#define T VC_TEXT
+#define B VC_BINARY
+static const unsigned char vclass[ 256 ] = {
+	B, B, B, B, B, B, B, B, B, T, B, B, B, B, B, B, // 0x00
+	B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, // 0x10
+	T, T, T, T, T, T, T, T, T, T, T, T, T, M, P, T, // 0x20
+	D, D, D, D, D, D, D, D, D, D, T, T, T, T, T, T, // 0x30
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0x40
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0x50
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0x60
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, B, // 0x70
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0x80
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0x90
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0xa0
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0xb0
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0xc0
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0xd0
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0xe0
+	T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, // 0xf0
+};
+#undef D
+#undef P
+#undef M
+#undef T
+#undef B
+
+
 /**
  * static type_t get_type( unsigned char *v, type_t deftype, unsigned int len ) 
  *
@@ -1082,18 +1773,79 @@ static char * copy( char *src, int size, int *ns, case_t t ) {
  *
  */
 static type_t get_type( unsigned char *v, type_t deftype, unsigned int len ) {
-	type_t t = T_INTEGER;
+	unsigned char m = 0, m1 = 0, m2 = 0, m3 = 0;
+	unsigned int i = 0;
 
 	// If the value is blank, then we need some help...
 	// Use deftype in this case...
-	//if ( strlen( v ) == 0 ) {
 	if ( !len )
 		return deftype;
 
 	// If it's just one character, should check if it's a number or char
 	if ( len == 1 ) {
-		// TODO: Can do boolean evaluation here too
-		if ( memchr( "TtFf", *v, 4 ) ) {
+		if ( memchr( "TtFf", *v, 4 ) )
+			return T_BOOLEAN;
+		return ( vclass[ *v ] == VC_DIGIT ) ? T_INTEGER : T_CHAR;
+	}
+
+	// Boolean true or false (regardless of spelling)
+	if ( ( len == 4 && !strncasecmp( (char *)v, "true", 4 ) ) || ( len == 5 && !strncasecmp( (char *)v, "false", 5 ) ) ) {
+		return T_BOOLEAN;
+	}
+
+	// If we start w/ '-', then this COULD mean that we're dealing with negative numbers
+	i = ( *v == '-' );
+
+	// Four independent accumulators keep the loop free of dependencies between bytes
+	for ( ; i + 4 <= len; i += 4 ) {
+		m |= vclass[ v[ i ] ], m1 |= vclass[ v[ i + 1 ] ];
+		m2 |= vclass[ v[ i + 2 ] ], m3 |= vclass[ v[ i + 3 ] ];
+	}
+
+	for ( ; i < len; i++ ) {
+		m |= vclass[ v[ i ] ];
+	}
+
+	// Any control byte makes it binary, and any other non-number a string
+	m |= m1 | m2 | m3;
+	if ( m & VC_BINARY )
+		return T_BINARY;
+	else if ( ( m & ( VC_TEXT | VC_MINUS ) ) || !( m & VC_DIGIT ) ) {
+		date_t d;
+		// Only something laid out like YYYY-MM-DD or HH:MM is worth parsing as a date
+		if ( ( m & VC_DIGIT ) && len >= 5 && ( v[ 4 ] == '-' || v[ 2 ] == ':' ) && date_from_text( v, len, &d ) )
+			return T_DATE;
+		else if ( len == 36 && uuid_from_text( v, len, NULL ) ) {
+			return T_UUID;
+		}
+		return T_STRING;
+	}
+
+	return ( m & VC_DOT ) ? T_DOUBLE : T_INTEGER;
+}
+
+
+#ifdef DEBUG_H
+/**
+ * static type_t get_type_scalar( unsigned char *v, type_t deftype, unsigned int len ) 
+ *
+ * The character by character classifier that get_type() replaced.  
+ * It's only kept so --bench-types has something to compare against.
+ *
+ */
+static type_t get_type_scalar( unsigned char *v, type_t deftype, unsigned int len ) {
+	type_t t = T_INTEGER;
+
+	// If the value is blank, then we need some help...
+	// Use deftype in this case...
+	//if ( strlen( v ) == 0 ) {
+	if ( !len )
+		return deftype;
+
+	// If it's just one character, should check if it's a number or char
+	if ( len == 1 ) {
+		// TODO: Can do boolean evaluation here too
+		if ( memchr( "TtFf", *v, 4 ) ) {
 			t = T_BOOLEAN;
 		}
 
@@ -1157,6 +1909,34 @@ static type_t get_type( unsigned char *v, type_t deftype, unsigned int len ) {
 
 	return t;
 }
+#endif
+
+
+/**
+ * static type_t widen_type( type_t a, type_t b ) 
+ *
+ * Find the narrowest type that holds values of both a and b.  Blank 
+ * values (T_NULL) fit anything, integers widen to doubles, integers 
+ * and doubles both fit a decimal, binary takes everything, and 
+ * anything else mixed together is a string.
+ * Booleans are only ever spelled out (get_type() calls 0 and 1 
+ * integers), so they can't widen to integers.
+ *
+ */
+static type_t widen_type( type_t a, type_t b ) {
+	if ( a == b || b == T_NULL )
+		return a;
+	else if ( a == T_NULL )
+		return b;
+	else if ( a == T_BINARY || b == T_BINARY )
+		return T_BINARY;
+	else if ( ( a == T_INTEGER && b == T_DOUBLE ) || ( a == T_DOUBLE && b == T_INTEGER ) )
+		return T_DOUBLE;
+	else if ( ( a == T_DECIMAL && ( b == T_INTEGER || b == T_DOUBLE ) ) || ( b == T_DECIMAL && ( a == T_INTEGER || a == T_DOUBLE ) ) ) {
+		return T_DECIMAL;
+	}
+	return T_STRING;
+}
 
 
 /**
@@ -1317,6 +2097,442 @@ int usafecpynumeric( unsigned char *numtext, long l ) {
 }
 
 
+/**
+ * int bool_from_text( const unsigned char *v, unsigned long len, int *out ) 
+ *
+ * Parse a boolean the way get_type() finds them: one of TtYy1FfNn0, or
+ * true and false in any case.  Returns 0 if the value is something else.
+ *
+ */
+int bool_from_text( const unsigned char *v, unsigned long len, int *out ) {
+	if ( len == 1 && memchr( "TtYy1FfNn0", *v, 10 ) )
+		*out = ( memchr( "TtYy1", *v, 5 ) != NULL );
+	else if ( len == 4 && !strncasecmp( (const char *)v, "true", 4 ) )
+		*out = 1;
+	else if ( len == 5 && !strncasecmp( (const char *)v, "false", 5 ) )
+		*out = 0;
+	else {
+		return 0;
+	}
+	return 1;
+}
+
+
+/**
+ * int int_from_text( const unsigned char *v, unsigned long len, long long *out ) 
+ *
+ * Parse a signed integer that is not NUL terminated.  Returns 0 if the 
+ * value is not a plain integer or does not fit.
+ *
+ */
+int int_from_text( const unsigned char *v, unsigned long len, long long *out ) {
+	unsigned long long n = 0, max = LLONG_MAX;
+	int neg = 0;
+
+	if ( len && ( *v == '-' || *v == '+' ) ) {
+		neg = ( *v == '-' ), v++, len--, max += neg;
+	}
+
+	if ( !len ) {
+		return 0;
+	}
+
+	for ( ; len; v++, len-- ) {
+		if ( *v < '0' || *v > '9' || n > ( max - ( *v - '0' ) ) / 10 ) {
+			return 0;
+		}
+		n = ( n * 10 ) + ( *v - '0' );
+	}
+
+	*out = ( neg && n ) ? -(long long)( n - 1 ) - 1 : (long long)n;
+	return 1;
+}
+
+
+/**
+ * int double_from_text( const unsigned char *v, unsigned long len, double *out ) 
+ *
+ * Parse a floating point value that is not NUL terminated.
+ *
+ */
+int double_from_text( const unsigned char *v, unsigned long len, double *out ) {
+	char buf[ 64 ] = { 0 };
+	char *end = NULL;
+
+	if ( !len || len >= sizeof( buf ) ) {
+		return 0;
+	}
+
+	memcpy( buf, v, len );
+	*out = strtod( buf, &end );
+	return ( end == &buf[ len ] );
+}
+
+
+/**
+ * static int digits_from_text( const unsigned char *v, int n ) 
+ *
+ * Read exactly n digits, or return -1.
+ *
+ */
+static int digits_from_text( const unsigned char *v, int n ) {
+	int num = 0;
+	for ( ; n; n--, v++ ) {
+		if ( *v < '0' || *v > '9' ) return -1;
+		num = ( num * 10 ) + ( *v - '0' );
+	}
+	return num;
+}
+
+
+/**
+ * int date_from_text( const unsigned char *v, unsigned long len, date_t *d ) 
+ *
+ * Fill out a date_t from YYYY-MM-DD, HH:MM[:SS[.ffffff]] or both 
+ * separated by a space or 'T'.  Returns DATE_HAS_DATE and/or 
+ * DATE_HAS_TIME depending on what was found, or 0 if the value
+ * is something else (time zones included).
+ *
+ */
+int date_from_text( const unsigned char *v, unsigned long len, date_t *d ) {
+	int found = 0;
+	memset( d, 0, sizeof( date_t ) );
+
+	// Date part
+	if ( len >= 10 && v[ 4 ] == '-' && v[ 7 ] == '-' ) {
+		static const int mdays[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+		int y = digits_from_text( v, 4 ), m = digits_from_text( &v[ 5 ], 2 ), dd = digits_from_text( &v[ 8 ], 2 );
+		if ( y < 0 || m < 1 || m > 12 || dd < 1 || dd > mdays[ m - 1 ] ) {
+			return 0;
+		}
+
+		// February 29th only happens in leap years
+		if ( m == 2 && dd == 29 && ( y % 4 || ( y % 100 == 0 && y % 400 ) ) ) {
+			return 0;
+		}
+		d->year = y, d->month = m, d->day = dd;
+		found |= DATE_HAS_DATE, v += 10, len -= 10;
+
+		if ( !len ) {
+			return found;
+		}
+
+		if ( *v != ' ' && *v != 'T' ) {
+			return 0;
+		}
+		v++, len--;
+	}
+
+	// Time part
+	if ( len >= 5 && v[ 2 ] == ':' ) {
+		int h = digits_from_text( v, 2 ), mi = digits_from_text( &v[ 3 ], 2 ), sec = 0;
+		if ( h < 0 || h > 23 || mi < 0 || mi > 59 ) {
+			return 0;
+		}
+		v += 5, len -= 5;
+
+		if ( len >= 3 && *v == ':' ) {
+			if ( ( sec = digits_from_text( &v[ 1 ], 2 ) ) < 0 || sec > 59 ) {
+				return 0;
+			}
+			v += 3, len -= 3;
+		}
+
+		// Fractional seconds, microsecond precision is all we keep
+		if ( len && *v == '.' ) {
+			int scale = 100000;
+			for ( v++, len--; len && *v >= '0' && *v <= '9'; v++, len--, scale /= 10 ) {
+				d->micro += ( *v - '0' ) * scale;
+			}
+		}
+
+		d->hour = h, d->minute = mi, d->second = sec;
+		found |= DATE_HAS_TIME;
+	}
+
+	return ( len ) ? 0 : found;
+}
+
+
+/**
+ * static int date_from_column( column_t *col, date_t *d ) 
+ *
+ * Get the date in a column, from what records_from_dsn() parsed 
+ * already if it did, or from its text otherwise.
+ *
+ */
+static int date_from_column( column_t *col, date_t *d ) {
+	if ( col->dated ) {
+		*d = col->date;
+		return col->dated;
+	}
+	return date_from_text( col->v, col->len, d );
+}
+
+
+/**
+ * long days_from_civil( int y, int m, int d ) 
+ *
+ * Days since 1970-01-01 for a date in the proleptic Gregorian calendar.
+ *
+ */
+long days_from_civil( int y, int m, int d ) {
+	y -= ( m <= 2 );
+	long era = ( y >= 0 ? y : y - 399 ) / 400;
+	unsigned int yoe = (unsigned int)( y - era * 400 );
+	unsigned int doy = ( 153 * ( m + ( m > 2 ? -3 : 9 ) ) + 2 ) / 5 + d - 1;
+	unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return ( era * 146097 ) + (long)doe - 719468;
+}
+
+
+/**
+ * static void put_be( unsigned char *p, unsigned long long v, int bytes ) 
+ *
+ * Write an integer in network byte order.
+ *
+ */
+static void put_be( unsigned char *p, unsigned long long v, int bytes ) {
+	for ( int i = bytes - 1; i >= 0; i--, v >>= 8 ) {
+		p[ i ] = v & 0xff;
+	}
+}
+
+
+/**
+ * static unsigned long long get_be( const unsigned char *p, int bytes ) 
+ *
+ * Read an integer in network byte order.
+ *
+ */
+static unsigned long long get_be( const unsigned char *p, int bytes ) {
+	unsigned long long v = 0;
+	for ( int i = 0; i < bytes; i++ ) {
+		v = ( v << 8 ) | p[ i ];
+	}
+	return v;
+}
+
+
+/**
+ * void date_from_days( long z, date_t *d ) 
+ *
+ * Fill out the date part of a date_t from days since 1970-01-01.
+ * This is the inverse of days_from_civil().
+ *
+ */
+void date_from_days( long z, date_t *d ) {
+	z += 719468;
+	long era = ( z >= 0 ? z : z - 146096 ) / 146097;
+	unsigned int doe = (unsigned int)( z - era * 146097 );
+	unsigned int yoe = ( doe - doe / 1460 + doe / 36524 - doe / 146096 ) / 365;
+	unsigned int doy = doe - ( 365 * yoe + yoe / 4 - yoe / 100 );
+	unsigned int mp = ( 5 * doy + 2 ) / 153;
+	d->day = doy - ( 153 * mp + 2 ) / 5 + 1;
+	d->month = ( mp < 10 ) ? mp + 3 : mp - 9;
+	d->year = yoe + ( era * 400 ) + ( d->month <= 2 );
+}
+
+
+/**
+ * static int uuid_from_text( const unsigned char *v, unsigned long len, unsigned char *out ) 
+ *
+ * Check for a UUID written as 8-4-4-4-12 hex digits, and decode it 
+ * into 16 bytes at `out` if that's not NULL.  Returns 1 if it is one.
+ *
+ */
+static int uuid_from_text( const unsigned char *v, unsigned long len, unsigned char *out ) {
+	unsigned char b[ 16 ];
+	int n = 0;
+
+	if ( len != 36 || v[ 8 ] != '-' || v[ 13 ] != '-' || v[ 18 ] != '-' || v[ 23 ] != '-' ) {
+		return 0;
+	}
+
+	for ( unsigned long i = 0; i < len; i++ ) {
+		int x = 0;
+		if ( i == 8 || i == 13 || i == 18 || i == 23 )
+			continue;
+		else if ( v[ i ] >= '0' && v[ i ] <= '9' )
+			x = v[ i ] - '0';
+		else if ( ( v[ i ] | 0x20 ) >= 'a' && ( v[ i ] | 0x20 ) <= 'f' )
+			x = ( v[ i ] | 0x20 ) - 'a' + 10;
+		else {
+			return 0;
+		}
+		b[ n / 2 ] = ( n % 2 ) ? b[ n / 2 ] | x : x << 4, n++;
+	}
+
+	if ( out ) {
+		memcpy( out, b, sizeof( b ) );
+	}
+	return 1;
+}
+
+
+/**
+ * static int uuid_to_text( const unsigned char *v, char *out ) 
+ *
+ * Write 16 bytes of UUID as text, the inverse of uuid_from_text().  
+ * `out` needs 37 bytes.  Returns the length written.
+ *
+ */
+static int uuid_to_text( const unsigned char *v, char *out ) {
+	int n = 0;
+	for ( int i = 0; i < 16; i++ ) {
+		n += sprintf( &out[ n ], &"-%02x"[ !( i == 4 || i == 6 || i == 8 || i == 10 ) ], v[ i ] );
+	}
+	return n;
+}
+
+
+#ifdef BPGSQL_H
+/**
+ * int numeric_to_pg( const unsigned char *v, unsigned long len, unsigned char *out ) 
+ *
+ * Encode a decimal string in Postgres' binary NUMERIC format (base 10000
+ * digits with a weight, sign and display scale).  `out` needs at least 
+ * len + 16 bytes.  Returns the encoded size or 0 if `v` is not a plain
+ * decimal number.
+ *
+ */
+int numeric_to_pg( const unsigned char *v, unsigned long len, unsigned char *out ) {
+	const unsigned char *ip = NULL, *fp = NULL;
+	unsigned long ilen = 0, flen = 0;
+	int neg = 0, weight = 0, n = 0, lead = 0, ndigits = 0;
+	unsigned char *d = &out[ 8 ];
+
+	if ( len && ( *v == '-' || *v == '+' ) ) {
+		neg = ( *v == '-' ), v++, len--;
+	}
+
+	// Split into integer and fractional digits
+	for ( ip = v; ilen < len && ip[ ilen ] >= '0' && ip[ ilen ] <= '9'; ilen++ );
+	if ( ilen < len && ip[ ilen ] == '.' ) {
+		fp = &ip[ ilen + 1 ];
+		for ( ; ilen + 1 + flen < len && fp[ flen ] >= '0' && fp[ flen ] <= '9'; flen++ );
+		if ( ilen + 1 + flen != len ) {
+			return 0;
+		}
+	}
+	else if ( ilen != len ) {
+		return 0;
+	}
+
+	if ( !ilen && !flen ) {
+		return 0;
+	}
+
+	for ( ; ilen && *ip == '0'; ip++, ilen-- );
+
+	// Integer digits are grouped from the decimal point to the left
+	weight = (int)( ( ilen + 3 ) / 4 ) - 1;
+	for ( unsigned long i = 0, g = ( ilen % 4 ) ? ilen % 4 : 4; i < ilen; g = 4, n++ ) {
+		int val = 0;
+		for ( unsigned long k = 0; k < g; k++, i++ ) {
+			val = ( val * 10 ) + ( ip[ i ] - '0' );
+		}
+		put_be( &d[ n * 2 ], val, 2 );
+	}
+
+	// ...and fractional digits from the decimal point to the right
+	for ( unsigned long i = 0; i < flen; n++ ) {
+		int val = 0;
+		for ( int k = 0; k < 4; k++, i++ ) {
+			val = ( val * 10 ) + ( ( i < flen ) ? fp[ i ] - '0' : 0 );
+		}
+		put_be( &d[ n * 2 ], val, 2 );
+	}
+
+	// Zero groups at either end aren't stored
+	for ( ; lead < n && !d[ lead * 2 ] && !d[ lead * 2 + 1 ]; lead++, weight-- );
+	for ( ; n > lead && !d[ ( n - 1 ) * 2 ] && !d[ ( n - 1 ) * 2 + 1 ]; n-- );
+	if ( ( ndigits = n - lead ) && lead ) {
+		memmove( d, &d[ lead * 2 ], ndigits * 2 );
+	}
+
+	if ( !ndigits ) {
+		weight = 0, neg = 0;
+	}
+
+	put_be( &out[ 0 ], ndigits, 2 );
+	put_be( &out[ 2 ], (unsigned short)weight, 2 );
+	put_be( &out[ 4 ], neg ? 0x4000 : 0x0000, 2 );
+	put_be( &out[ 6 ], flen, 2 );
+	return 8 + ( ndigits * 2 );
+}
+
+
+/**
+ * int numeric_from_pg( const unsigned char *v, unsigned long len, char *out ) 
+ *
+ * Write a binary Postgres NUMERIC as a decimal string, the inverse of
+ * numeric_to_pg().  `out` needs numeric_text_size() bytes.  Returns 
+ * the length written or -1 if `v` is malformed.
+ *
+ */
+int numeric_from_pg( const unsigned char *v, unsigned long len, char *out ) {
+	int ndigits = 0, weight = 0, sign = 0, dscale = 0;
+	char *p = out;
+
+	if ( len < 8 ) {
+		return -1;
+	}
+
+	ndigits = get_be( v, 2 ), weight = (short)get_be( &v[ 2 ], 2 );
+	sign = get_be( &v[ 4 ], 2 ), dscale = get_be( &v[ 6 ], 2 );
+	if ( len < 8 + ( ndigits * 2UL ) ) {
+		return -1;
+	}
+	else if ( sign == 0xC000 || sign == 0xD000 || sign == 0xF000 ) {
+		const char *special = ( sign == 0xC000 ) ? "NaN" : ( sign == 0xD000 ) ? "Infinity" : "-Infinity";
+		return sprintf( out, "%s", special );
+	}
+
+	if ( sign == 0x4000 && ndigits ) {
+		*p++ = '-';
+	}
+
+	// Integer groups, the first one isn't padded
+	if ( weight < 0 ) {
+		*p++ = '0';
+	}
+	for ( int i = 0; i <= weight; i++ ) {
+		int g = ( i < ndigits ) ? (int)get_be( &v[ 8 + i * 2 ], 2 ) : 0;
+		p += sprintf( p, ( i ) ? "%04d" : "%d", g );
+	}
+
+	// Fractional groups, cut off at the display scale
+	if ( dscale > 0 ) {
+		*p++ = '.';
+		for ( int i = weight + 1, n = 0; n < dscale; i++ ) {
+			char g[ 8 ];
+			sprintf( g, "%04d", ( i >= 0 && i < ndigits ) ? (int)get_be( &v[ 8 + i * 2 ], 2 ) : 0 );
+			for ( int k = 0; k < 4 && n < dscale; k++, n++ ) {
+				*p++ = g[ k ];
+			}
+		}
+	}
+
+	*p = '\0';
+	return p - out;
+}
+
+
+/**
+ * int numeric_text_size( const unsigned char *v, unsigned long len ) 
+ *
+ * How much space numeric_from_pg() needs for a value.
+ *
+ */
+int numeric_text_size( const unsigned char *v, unsigned long len ) {
+	int weight = ( len < 8 ) ? 0 : (short)get_be( &v[ 2 ], 2 );
+	int dscale = ( len < 8 ) ? 0 : (int)get_be( &v[ 6 ], 2 );
+	return 16 + ( ( ( weight < 0 ) ? -weight : weight ) + 1 ) * 4 + dscale;
+}
+#endif
+
+
 /**
  * int parse_dsn_info( dsn_t *conn, char *err, int errlen ) 
  *
@@ -1364,11 +2580,12 @@ int parse_dsn_info( dsn_t *conn, char *err, int errlen ) {
 		dsn += len, dsnlen -= len;
 	}
 #endif
-	else if ( STRLCMP( dsn, "sqlite3://" ) ) {
+	else if ( STRLCMP( dsn, SQLITE_PREFIX ) ) {
+		// The rest is a path, so none of the parsing below applies
 		conn->type = DB_SQLITE;
 		conn->port = 0;
-		conn->typemap = default_map;
-		dsn += 10, dsnlen -= 10;
+		conn->typemap = sqlite3_map;
+		return 1;
 	}
 	else {
 		if ( strlen( dsn ) == 1 && *dsn == '-' )
@@ -1625,23 +2842,37 @@ void destroy_dsn_headers ( dsn_t *t ) {
 		free( *s );
 	}
 	free( t->headers );
+	free_strtab( &t->labels );
 }
 
 
 /**
- * void destroy_dsn_rows ( dsn_t *t ) 
+ * void destroy_row ( row_t *r ) 
  *
- * Free all rows allocated when interacting with a data source.
+ * Free one row, its columns and whatever values it owns.
  *
  */
-void destroy_dsn_rows ( dsn_t *t ) {
-	WHERE();
+void destroy_row ( row_t *r ) {
+	for ( column_t **c = r->columns; c && *c; c++ ) free( (*c) );
+	free( r->columns );
+	( r->freedata ) ? r->freedata( r->data ) : free( r->data );
+	free( r );
+}
+
+
+/**
+ * void destroy_dsn_rows ( dsn_t *t ) 
+ *
+ * Free all rows allocated when interacting with a data source.
+ *
+ */
+void destroy_dsn_rows ( dsn_t *t ) {
+	WHERE();
 	for ( row_t **r = t->rows; r && *r; r++ ) {
-		for ( column_t **c = (*r)->columns; c && *c; c++ ) free( (*c) );
-		free( (*r)->columns );
-		free( (*r) );
+		destroy_row( *r );
 	}
 	free( t->rows );
+	t->rows = NULL, t->rlen = 0;
 }
 
 
@@ -1715,6 +2946,32 @@ int schema_from_dsn( dsn_t *iconn, dsn_t *oconn, char *fm, int fmtlen, char *err
 		written = snprintf( fmt, fmtlen, "\t%s %s", (*s)->label, (*s)->ptype->name );
 		fmtlen -= written, fmt += written;
 
+		// Decimals carry the digits they were seen (or declared) with, SQLite just keeps the text
+		if ( (*s)->ptype->basetype == T_DECIMAL && oconn->typemap != sqlite3_map ) {
+			int precision = (*s)->precision, scale = (*s)->scale;
+		#ifdef BMYSQL_H
+			// MySQL takes a bare DECIMAL as DECIMAL(10,0), so leave room for anything
+			if ( !precision && oconn->type == DB_MYSQL ) {
+				precision = DECIMAL_MAX_PRECISION, scale = DECIMAL_MAX_SCALE;
+			}
+		#endif
+			if ( precision ) {
+				written = snprintf( fmt, fmtlen, "(%d,%d)", precision, scale );
+				fmtlen -= written, fmt += written;
+			}
+		}
+
+		// --profile knows how long strings get, and whether there are blanks
+		if ( (*s)->maxlen ) {
+			written = snprintf( fmt, fmtlen, "(%d)", (*s)->maxlen );
+			fmtlen -= written, fmt += written;
+		}
+
+		if ( (*s)->notnull ) {
+			written = snprintf( fmt, fmtlen, " NOT NULL" );
+			fmtlen -= written, fmt += written;
+		}
+
 		// Are we trying to populate or create a MySQL database
 		// Does anyone else support this syntax?
 		if ( len == 1 && (*s)->primary ) {
@@ -1734,6 +2991,20 @@ int schema_from_dsn( dsn_t *iconn, dsn_t *oconn, char *fm, int fmtlen, char *err
 	// Terminate the schema
 	written = snprintf( fmt, fmtlen, ");\n" );
 	fmtlen -= written, fmt += written;
+
+	// Columns that look unique are only suggested, since the profile can't be sure
+	len = 0;
+	for ( header_t **s = iconn->headers; s && *s; s++ ) {
+		if ( (*s)->candidate ) {
+			written = snprintf( fmt, fmtlen, "%s%s", ( len++ ) ? ", " : "-- Candidate primary keys: ", (*s)->label );
+			fmtlen -= written, fmt += written;
+		}
+	}
+
+	if ( len ) {
+		written = snprintf( fmt, fmtlen, "\n" );
+		fmtlen -= written, fmt += written;
+	}
 	return 1;
 }
 
@@ -1763,9 +3034,35 @@ int test_dsn (dsn_t *conn, char *err, int errlen) {
 		return 1;
 	}
 	else if ( conn->type == DB_SQLITE ) {
-		// Same here.  Access could technically be used with the database name or path specified
+	#ifdef BSQLITE_H
+		sqlite3 *db = NULL;
+		sqlite3_stmt *stmt = NULL;
+		const char query[] = "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?";
+		int found = 0;
+
+		// A database that isn't there yet doesn't have the table either
+		if ( sqlite3_open_v2( &conn->connstr[ sizeof( SQLITE_PREFIX ) - 1 ], &db, SQLITE_OPEN_READONLY, NULL ) != SQLITE_OK ) {
+			snprintf( err, errlen, "%s", sqlite3_errmsg( db ) );
+			sqlite3_close( db );
+			return 0;
+		}
+
+		if ( sqlite3_prepare_v2( db, query, -1, &stmt, NULL ) == SQLITE_OK ) {
+			sqlite3_bind_text( stmt, 1, conn->tablename, -1, SQLITE_STATIC );
+			found = sqlite3_step( stmt ) == SQLITE_ROW;
+		}
+
+		if ( !found ) {
+			snprintf( err, errlen, "Table '%s' does not exist", conn->tablename );
+		}
+
+		sqlite3_finalize( stmt );
+		sqlite3_close( db );
+		return found;
+	#else
 FPRINTF( "SQlite output conn test failed.\n" );
 		return 0;
+	#endif
 	}
 	else if ( conn->type == DB_MYSQL ) {
 		// You'll need to be able to connect and test for existence of db and table
@@ -1827,7 +3124,31 @@ fprintf( stdout, "Generated schema: %s\n", schema_fmt );
 
 	// SQLite: create table (db ought to be created when you open it)
 	if ( oc->type == DB_SQLITE ) {
+	#ifdef BSQLITE_H
+		sqlite3 *db = NULL;
+		char *msg = NULL;
+		const int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+		if ( sqlite3_open_v2( &oc->connstr[ sizeof( SQLITE_PREFIX ) - 1 ], &db, flags, NULL ) != SQLITE_OK ) {
+			const char fmt[] = "Couldn't open SQLite3 database: %s";
+			snprintf( err, errlen, fmt, sqlite3_errmsg( db ) );
+			sqlite3_close( db );
+			return 0;
+		}
 
+		if ( sqlite3_exec( db, schema_fmt, NULL, NULL, &msg ) != SQLITE_OK ) {
+			const char fmt[] = "Failed to create SQLite3 table: %s";
+			snprintf( err, errlen, fmt, msg );
+			sqlite3_free( msg );
+			sqlite3_close( db );
+			return 0;
+		}
+
+		sqlite3_close( db );
+	#else
+		snprintf( err, errlen, "SQLite3 support was not compiled in" );
+		return 0;
+	#endif
 	}
 #ifdef BMYSQL_H
 	// MySQL: create db & table (use an if not exists?, etc)
@@ -1981,1202 +3302,4825 @@ static int modify_pgconnstr ( char *connstr, int fmtlen ) {
 
 
 /**
- * int open_dsn ( dsn_t *conn, config_t *conf, const char *qopt, char *err, int errlen ) 
+ * int query_dsn ( dsn_t *conn, const char *query, char *val, int vallen, char *err, int errlen ) 
  *
- * Open a manage a data source.
+ * Run a one-off statement against an open database connection.  If
+ * `val` is not NULL, the first column of the first row returned is 
+ * copied there.
  *
  */
-int open_dsn ( dsn_t *conn, config_t *conf, char *err, int errlen ) {
-	WPRINTF( "Attempting to open connection indicated by '%s'", conn->connstr );
-	char query[ 2048 ];
-	memset( query, 0, sizeof( query ) );
-
-	// Handle opening the database first
-	if ( conn->type == DB_FILE ) {
-		// An mmap() implementation for speedy reading and less refactoring
-		struct stat sb;
-		file_t *file = NULL;
+int query_dsn ( dsn_t *conn, const char *query, char *val, int vallen, char *err, int errlen ) {
+#ifdef BMYSQL_H
+	if ( conn->type == DB_MYSQL ) {
+		mysql_t *db = (mysql_t *)conn->conn;
+		MYSQL_RES *res = NULL;
 
-		// Create a file structure
-		if ( !( file = malloc( sizeof( file_t ) ) ) || !memset( file, 0, sizeof( file_t ) ) ) {
-			snprintf( err, errlen, "malloc() %s", strerror( errno ) );
+		if ( mysql_query( db->conn, query ) != 0 ) {
+			const char fmt[] = "MySQL query '%s' failed: %s";
+			snprintf( err, errlen, fmt, query, mysql_error( db->conn ) );
 			return 0;
 		}
 
-		// Handle stdout (since there will be no size, and it doesn't make tons of sense to mmap() it)
-		if ( STRLCMP( conn->connstr, "/dev/stdout" ) ) {
-			file->fd = 1;
-			file->start = file->map = NULL;
-			conn->conn = file;
-			return 1;
+		// Statements like SET won't return a result set
+		if ( ( res = mysql_store_result( db->conn ) ) ) {
+			MYSQL_ROW r = mysql_fetch_row( res );
+			if ( val && r && *r ) {
+				snprintf( val, vallen, "%s", *r );
+			}
+			mysql_free_result( res );
 		}
+		return 1;
+	}
+#endif
+#ifdef BPGSQL_H
+	if ( conn->type == DB_POSTGRESQL ) {
+		pgsql_t *db = (pgsql_t *)conn->conn;
+		PGresult *res = PQexec( db->conn, query );
+		ExecStatusType status = PQresultStatus( res );
 
-		// Initialize the stat buffer and check for the file
-		if ( memset( &sb, 0, sizeof( struct stat ) ) && stat( conn->connstr, &sb ) == -1 ) {
-			snprintf( err, errlen, "stat() %s", strerror( errno ) );
-			free( file );
+		if ( status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK ) {
+			const char fmt[] = "PostgreSQL query '%s' failed: %s";
+			snprintf( err, errlen, fmt, query, PQerrorMessage( db->conn ) );
+			PQclear( res );
 			return 0;
 		}
 
-		// Open the file
-		//fprintf( stderr, "Attempt to open %s\n", conn->connstr );
-		if ( conn->input ) {
-			if ( ( file->fd = open( conn->connstr, O_RDONLY ) ) == -1 ) {
-				snprintf( err, errlen, "open() %s", strerror( errno ) );
-				free( file );
-				return 0;
-			}
+		if ( val && status == PGRES_TUPLES_OK && PQntuples( res ) > 0 ) {
+			snprintf( val, vallen, "%s", PQgetvalue( res, 0, 0 ) );
 		}
-		else {
-			if ( ( file->fd = open( conn->connstr, O_RDWR, 0644 ) ) == -1 ) {
-				snprintf( err, errlen, "open() %s", strerror( errno ) );
-				free( file );
-				return 0;
+		PQclear( res );
+		return 1;
+	}
+#endif
+#ifdef BSQLITE_H
+	if ( conn->type == DB_SQLITE ) {
+		sqlite3_t *db = (sqlite3_t *)conn->conn;
+		sqlite3_stmt *stmt = NULL;
+		int status = SQLITE_ERROR;
+
+		if ( sqlite3_prepare_v2( db->conn, query, -1, &stmt, NULL ) == SQLITE_OK ) {
+			// PRAGMAs return their value as a row
+			if ( ( status = sqlite3_step( stmt ) ) == SQLITE_ROW && val && sqlite3_column_text( stmt, 0 ) ) {
+				snprintf( val, vallen, "%s", (const char *)sqlite3_column_text( stmt, 0 ) );
 			}
 		}
 
-		// If this is an output source, no reason to mmap()
-		if ( conn->input ) {
-			if ( ( file->size = sb.st_size ) == 0 ) {
-				snprintf( err, errlen, "You've specified a zero-length input source.  Aborting...\n" );
-				free( file );
-				return 0;
-			}
-
-			file->map = mmap( 0, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0 );
-			if ( file->map == MAP_FAILED ) {
-				snprintf( err, errlen, "mmap() mount failure %s", strerror( errno ) );
-				free( file );
-				return 0;
-			}
+		if ( status != SQLITE_ROW && status != SQLITE_DONE ) {
+			const char fmt[] = "SQLite3 query '%s' failed: %s";
+			snprintf( err, errlen, fmt, query, sqlite3_errmsg( db->conn ) );
+			sqlite3_finalize( stmt );
+			return 0;
 		}
 
-		file->start = file->map;
-		file->offset = 0;
-		conn->conn = file;
+		sqlite3_finalize( stmt );
 		return 1;
 	}
+#endif
+	snprintf( err, errlen, "Can't run queries against %s datasources", get_conn_type( conn->type ) );
+	return 0;
+}
 
-	// Stop if no table name was specified
-	if ( !conf->wtable && ( !( *conn->tablename ) || strlen( conn->tablename ) < 1 ) ) {
-		snprintf( err, errlen, "No table name specified for source data." );
-		return 0;
-	}
 
-	// Create the final query from here too
-	if ( conf->wquery )
-		snprintf( query, sizeof( query ) - 1, "%s", conf->wquery );
-	else {
-		snprintf( query, sizeof( query ) - 1, "SELECT * FROM %s", conn->tablename );
-	}
+/**
+ * int apply_bulk_profile ( dsn_t *conn, char *err, int errlen ) 
+ *
+ * Save the current value of each setting in bulk_profile for this 
+ * engine, then change it for the rest of the session.
+ *
+ */
+int apply_bulk_profile ( dsn_t *conn, char *err, int errlen ) {
+	const char *getfmt = NULL, *setfmt = NULL;
 
+	if ( 0 ) ;
+#ifdef BPGSQL_H
+	else if ( conn->type == DB_POSTGRESQL )
+		getfmt = "SELECT current_setting('%s')", setfmt = "SET %s = %s";
+#endif
 #ifdef BMYSQL_H
-	if ( conn->type == DB_MYSQL ) {
-		// Switch everything to use this format now
-		mysql_t *db = NULL;
+	else if ( conn->type == DB_MYSQL )
+		getfmt = "SELECT @@SESSION.%s", setfmt = "SET SESSION %s = %s";
+#endif
+#ifdef BSQLITE_H
+	else if ( conn->type == DB_SQLITE )
+		getfmt = "PRAGMA %s", setfmt = "PRAGMA %s = %s";
+#endif
+	else {
+		// Nothing to tune for files
+		return 1;
+	}
 
-		if ( !( db = malloc( sizeof( mysql_t ) ) ) || !memset( db, 0, sizeof( mysql_t ) ) ) {
-			const char fmt[] = "Memory constraint encountered initializing MySQL connection.";
-			snprintf( err, errlen, fmt );
-			return 0;
-		}
+	for ( int i = 0; bulk_profile[ i ].name && i < BULK_MAX; i++ ) {
+		const bulkopt_t *b = &bulk_profile[ i ];
+		char query[ 256 ] = { 0 };
 
-		// Initialize the connection
-		if ( !( db->conn = mysql_init( 0 ) ) ) {
-			const char fmt[] = "Couldn't initialize MySQL connection: %s";
-			snprintf( err, errlen, fmt, mysql_error( db->conn ) );
-			mysql_close( db->conn );
-			return 0;
+		if ( b->type != conn->type ) {
+			continue;
 		}
 
-		// Open the connection
-		MYSQL *t = mysql_real_connect(
-			db->conn,
-			conn->hostname,
-			conn->username,
-			conn->password,
-			conn->dbname,
-			conn->port,
-			NULL,
-			0
-		);
-
-		// Check the connection
-		if ( !t ) {
-			const char fmt[] = "Couldn't connect to server: %s";
-			snprintf( err, errlen, fmt, mysql_error( t ) );
+		// Save whatever the session is using now
+		snprintf( query, sizeof( query ), getfmt, b->name );
+		if ( !query_dsn( conn, query, conn->bulksaved[ i ], sizeof( conn->bulksaved[ i ] ), err, errlen ) ) {
 			return 0;
 		}
 
-		// Execute whatever query
-		if ( mysql_query( t, query ) > 0 ) {
-			const char fmt[] = "Failed to run query against selected db and table: %s";
-			snprintf( err, errlen, fmt, mysql_error( t ) );
-			mysql_close( t );
-			return 0;
+		snprintf( query, sizeof( query ), setfmt, b->name, b->value );
+		if ( query_dsn( conn, query, NULL, 0, err, errlen ) )
+			conn->bulkstate[ i ] = 1;
+		else if ( b->optional ) {
+			fprintf( stderr, "WARNING: --bulk could not set %s: %s\n", b->name, err );
+			memset( err, 0, errlen );
+			conn->bulkstate[ i ] = -1;
 		}
-
-		// Use the result
-		if ( !( db->res = mysql_store_result( t ) ) ) {
-			const char fmt[] = "Failed to store results set from last query: %s";
-			snprintf( err, errlen, fmt, mysql_error( t ) );
-			mysql_close( t );
+		else {
 			return 0;
 		}
-
-		// Set both of these
-		db->conn = t;
-		conn->conn = (void *)db;
 	}
-#endif
-
-#ifdef BPGSQL_H
-	if ( conn->type == DB_POSTGRESQL ) {
-		// Switch everything to use this format now
-		pgsql_t *db = NULL;
 
-		if ( !( db = malloc( sizeof( pgsql_t ) ) ) || !memset( db, 0, sizeof( pgsql_t ) ) ) {
-			const char fmt[] = "Memory constraint encountered initializing Postgres connection.";
-			snprintf( err, errlen, fmt );
-			return 0;
-		}
+	return 1;
+}
 
-		// Attempt to open the connection and handle errors
-		if ( PQstatus( ( db->conn = PQconnectdb( conn->connstr ) ) ) != CONNECTION_OK ) {
-			const char fmt[] = "Couldn't initialize PostsreSQL connection: %s";
-			snprintf( err, errlen, fmt, PQerrorMessage( db->conn ) );
-			PQfinish( db->conn );
-			return 0;
-		}
 
-		// Run the query
-		if ( !( db->res = PQexec( db->conn, query ) ) ) {
-			const char fmt[] = "Failed to run query against selected db and table: '%s'";
-			snprintf( err, errlen, fmt, PQerrorMessage( db->conn ) );
-			//PQclear( res );
-			PQfinish( db->conn );
-			return 0;
-		}
+/**
+ * void restore_bulk_profile ( dsn_t *conn ) 
+ *
+ * Put back any session settings changed by apply_bulk_profile().
+ *
+ */
+void restore_bulk_profile ( dsn_t *conn ) {
+	const char *fmt = NULL;
+	char err[ ERRLEN ] = { 0 };
 
-		// Set both of these
-		conn->conn = (void *)db;
-	}
+	if ( 0 ) ;
+#ifdef BPGSQL_H
+	else if ( conn->type == DB_POSTGRESQL )
+		fmt = "SET %s = '%s'";
 #endif
-	#if 0
-	else if ( conn->type == DB_SQLITE ) {
-		sqlite3_t *db = NULL;
-		if ( !( db = malloc( sizeof( pgsql_t ) ) ) || !memset( db, 0, sizeof( pgsql_t ) ) ) {
-			const char fmt[] = "Memory constraint encountered initializing SQLite3 connection.";
-			snprintf( err, errlen, fmt );
-			return 0;
-		}
+#ifdef BMYSQL_H
+	else if ( conn->type == DB_MYSQL )
+		fmt = "SET SESSION %s = %s";
+#endif
+#ifdef BSQLITE_H
+	else if ( conn->type == DB_SQLITE )
+		fmt = "PRAGMA %s = %s";
+#endif
+	else {
+		return;
+	}
 
-		//db->conn = sqlite3_open( );
+	for ( int i = 0; bulk_profile[ i ].name && i < BULK_MAX; i++ ) {
+		char query[ 256 ] = { 0 };
+		if ( conn->bulkstate[ i ] != 1 ) {
+			continue;
+		}
 
-		conn->conn = (void *)db;
+		snprintf( query, sizeof( query ), fmt, bulk_profile[ i ].name, conn->bulksaved[ i ] );
+		if ( !query_dsn( conn, query, NULL, 0, err, sizeof( err ) ) ) {
+			fprintf( stderr, "WARNING: Failed to restore %s: %s\n", bulk_profile[ i ].name, err );
+		}
 	}
-	#endif
-
-	return 1;
 }
 
 
 /**
- * static const char * find_ctype ( coerce_t **list, const char *name ) 
+ * void print_bulk_profile ( dsn_t *conn ) 
  *
- * Locate a specific coerced type.
+ * Dump the settings --bulk changed on a datasource (used by --stats).
  *
  */
-static const char * find_ctype ( coerce_t **list, const char *name ) {
-	for ( coerce_t **x = list; x && *x; x++ ) {
-		if ( !strcasecmp( (*x)->misc, name ) ) return (*x)->typename;
+void print_bulk_profile ( dsn_t *conn ) {
+	int first = 1;
+	for ( int i = 0; bulk_profile[ i ].name && i < BULK_MAX; i++ ) {
+		const bulkopt_t *b = &bulk_profile[ i ];
+		if ( b->type != conn->type || !conn->bulkstate[ i ] ) {
+			continue;
+		}
+
+		if ( first ) {
+			fprintf( stdout, "Bulk profile (%s):\n", get_conn_type( conn->type ) );
+			first = 0;
+		}
+
+		if ( conn->bulkstate[ i ] == -1 )
+			fprintf( stdout, "  %-24s refused by server\n", b->name );
+		else {
+			fprintf( stdout, "  %-24s %s (was %s)\n", b->name, b->value, conn->bulksaved[ i ] );
+		}
 	}
-	return NULL;
 }
 
 
 /**
- * static const char * find_atype ( coerce_t **list, const char *name ) 
+ * static int add_ddl ( dsn_t *conn, const char *name, const char *drop, const char *create, const char *finish, int online ) 
  *
- * Locate a specific coerced type.
+ * Record an index or constraint that can be dropped now and rebuilt later.
  *
  */
-static const char * find_atype ( coerce_t **list, const char *typename ) {
-	for ( coerce_t **x = list; x && *x; x++ ) {
-		if ( !strcasecmp( (*x)->misc, typename ) ) return (*x)->typename;
-	}
-	return NULL;
-}
+static int add_ddl ( dsn_t *conn, const char *name, const char *drop, const char *create, const char *finish, int online ) {
+	ddl_t *d = NULL;
 
+	if ( !( d = malloc( sizeof( ddl_t ) ) ) || !memset( d, 0, sizeof( ddl_t ) ) ) {
+		return 0;
+	}
+
+	snprintf( d->name, sizeof( d->name ), "%s", name );
+	d->online = online;
+	if ( !( d->drop = strdup( drop ) ) || !( d->create = strdup( create ) ) ) {
+		free( d->drop ), free( d );
+		return 0;
+	}
+
+	if ( finish && *finish && !( d->finish = strdup( finish ) ) ) {
+		free( d->drop ), free( d->create ), free( d );
+		return 0;
+	}
+
+	add_item( &conn->ddl, d, ddl_t *, &conn->ddllen );
+	return 1;
+}
 
 
 /**
- * coerce_t * create_ctypes( const char *src, char *err, int errlen ) 
+ * void destroy_dsn_ddl ( dsn_t *conn ) 
  *
- * Create a key-value list of column names and their "coerced" type matches.
+ * Free any DDL captured by capture_ddl().
  *
  */
-coerce_t ** create_ctypes( const char *src, dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) {
-
-	// Define stuff
-	coerce_t **ctypes = NULL;
-	int ctypeslen = 0;
-	zw_t pp = { 0 };
-	const char *fmt = ( !iconn ) ? "--coerce" : "--auto";
-
-	// No matter who is calling, `oconn` is always needed
-	if ( !oconn ) {
-		fprintf( stderr, "NO OUPTUT CONNECTION GIVEN TO %s", __func__ );
-		return NULL;
+void destroy_dsn_ddl ( dsn_t *conn ) {
+	for ( ddl_t **d = conn->ddl; d && *d; d++ ) {
+		free( (*d)->drop ), free( (*d)->create ), free( (*d)->finish ), free( *d );
 	}
+	free( conn->ddl );
+	conn->ddl = NULL, conn->ddllen = 0;
+}
 
-	// Loop through however many may exist
-	for ( coerce_t *t = NULL; strwalk( &pp, src, "," ); t = NULL ) {
-		if ( pp.size - 1 ) {
-			zw_t px = { 0 };
-			unsigned char *n = NULL; 
-			char p[ 256 ] = { 0 };
-			int len = pp.size - 1;
-
-			// Copy to new buffer or fail
-			if ( ( pp.size - 1 ) < sizeof( p ) ) {
-				n = trim( (unsigned char *)&src[ pp.pos ], " ", pp.size - 1, &len );
-				memcpy( p, n, len );
-			}
-			else {
-				memcpy( p, &src[ pp.pos ], 32 );
-				memcpy( &p[ 32 ], "...", 3 );
-				snprintf( err, errlen, "Argument given to %s will truncate: '%s'", fmt, p );
-				return NULL;
-			}
-		
-			// Stop if there are too many
-			if ( memchrocc( p, '=', strlen( p ) ) != 1 ) {
-				snprintf( err, errlen, "Argument given to %s is misformatted: '%s'", fmt, p );
-				return NULL;
-			}
-
-			// Catch allocation failures
-			if ( !( t = malloc( sizeof( coerce_t ) ) ) || !memset( t, 0, sizeof( coerce_t ) ) ) {
-				snprintf( err, errlen, "Allocation failed(): %s\n", strerror( errno ) );
-				return NULL;
-			}
-
-			// Then break the type and thing 
-			for ( int i = 0; strwalk( &px, p, "=" ); i++ ) {
-				// Define more
-				int len = 0;
-				char b[ 128 ] = { 0 };
-				unsigned char *n = NULL;
-				typemap_t *tmap = NULL;
-
-				// Check for zero-length or overflow and copy to buffer
-				if ( ( px.size - 1 ) < 1 ) {
-					// This is a format error
-					snprintf( err, errlen, "Got zero-length argument at %s", fmt );
-					return NULL;
-				}
-				else if ( ( px.size - 1 ) > sizeof( b ) ) {
-					snprintf( err, errlen, "Argument given to %s will truncate: '%s'", fmt, p );
-					return NULL;
-				}
-				else {
-					n = trim( (unsigned char *)&p[ px.pos ], " ", px.size - 1, &len );
-					memcpy( b, n, len );
-				}	
-
-				// Get the key
-				if ( i )
-					snprintf( (char *)t->typename, sizeof( t->typename ), "%s", b );
-				else {
-					// No input means that this first key is a column label
-					if ( !iconn )
-						snprintf( (char *)t->misc, sizeof( t->misc ), "%s", b );
-					else {
-						// Check that the input type is even supported
-						if ( !( tmap = get_typemap_by_nname( iconn->typemap, b ) ) ) {
-							free( t );
-							snprintf( err, errlen, "Type '%s' not found in argument at %s", b, fmt );
-							return NULL;	
-						}
-
-						snprintf( (char *)t->misc, sizeof( t->misc ), "%s", tmap->name );
-					}
-				}
-			}
 
-			// Add this to the list...
-			add_item( &ctypes, t, coerce_t *, &ctypeslen );
-		}
+/**
+ * static char * escape_dsn ( dsn_t *conn, const char *v, char *buf, int buflen ) 
+ *
+ * Escape `v` into `buf` so that it can go between single quotes in a
+ * query on `conn`.  `buf` needs twice the length of `v` plus one.
+ *
+ */
+static char * escape_dsn ( dsn_t *conn, const char *v, char *buf, int buflen ) {
+	size_t len = strlen( v );
+	len = ( len > ( buflen - 1 ) / 2 ) ? ( buflen - 1 ) / 2 : len;
+	*buf = '\0';
+#ifdef BMYSQL_H
+	if ( conn->type == DB_MYSQL ) {
+		mysql_real_escape_string( ( (mysql_t *)conn->conn )->conn, buf, v, len );
 	}
-
-	return ctypes;
+#endif
+#ifdef BPGSQL_H
+	if ( conn->type == DB_POSTGRESQL ) {
+		PQescapeStringConn( ( (pgsql_t *)conn->conn )->conn, buf, v, len, NULL );
+	}
+#endif
+	return buf;
 }
 
 
 /**
- * headers_from_dsn( dsn_t * )
+ * int capture_ddl ( dsn_t *conn, char *err, int errlen ) 
  *
- * Print the headers from a data source.
+ * Find the secondary indexes and constraints on an output table and 
+ * save the statements needed to drop and rebuild them.  Primary keys
+ * are always left alone.
  *
  */
-int headers_from_dsn ( dsn_t *conn, config_t *conf, char *err, int errlen ) {
-
-	// Empty condition to assist with compiling out code
-	if ( conn->type == DB_FILE ) {
-		// TODO: Reimplement this to read line-by-line
-		zw_t p;
-		file_t *file = NULL;
-
-		// Prepare this structure
-		memset( &p, 0, sizeof( zw_t ) );
+int capture_ddl ( dsn_t *conn, char *err, int errlen ) {
+	char query[ 4096 ] = { 0 }, name[ 2 * sizeof( conn->tablename ) + 1 ] = { 0 };
 
-		// Copy the delimiter to whatever this is
-		memcpy( &delset[ strlen( delset ) ], DELIM, strlen( DELIM ) );
+	// The name goes into string literals below
+	escape_dsn( conn, conn->tablename, name, sizeof( name ) );
 
-		// Check anyway in case something wonky happened
-		if ( !( file = (file_t *)conn->conn ) ) {
-			const char fmt[] = "mmap() src was lost.";
-			snprintf( err, errlen, fmt );
+#ifdef BPGSQL_H
+	if ( conn->type == DB_POSTGRESQL ) {
+		pgsql_t *db = (pgsql_t *)conn->conn;
+		PGresult *res = NULL;
+
+		// Foreign keys come first so nothing depends on a unique constraint when it's dropped.
+		// Unique constraints are rebuilt as an index first so that it can be built concurrently.
+		const char fmt[] = 
+			"SELECT name, dropstmt, createstmt, finishstmt, online FROM ( "
+			" SELECT c.conname AS name, "
+			"  'ALTER TABLE ' || c.conrelid::regclass || ' DROP CONSTRAINT ' || quote_ident( c.conname ) AS dropstmt, "
+			"  CASE WHEN c.contype = 'u' THEN pg_get_indexdef( c.conindid ) "
+			"   ELSE 'ALTER TABLE ' || c.conrelid::regclass || ' ADD CONSTRAINT ' || quote_ident( c.conname ) "
+			"    || ' ' || pg_get_constraintdef( c.oid ) || CASE WHEN c.contype = 'f' THEN ' NOT VALID' ELSE '' END "
+			"  END AS createstmt, "
+			"  CASE WHEN c.contype = 'u' THEN 'ALTER TABLE ' || c.conrelid::regclass || ' ADD CONSTRAINT ' "
+			"    || quote_ident( c.conname ) || ' UNIQUE USING INDEX ' || c.conindid::regclass "
+			"   WHEN c.contype = 'f' THEN 'ALTER TABLE ' || c.conrelid::regclass || ' VALIDATE CONSTRAINT ' || quote_ident( c.conname ) "
+			"   ELSE '' "
+			"  END AS finishstmt, "
+			"  ( c.contype = 'u' )::int AS online, "
+			"  CASE WHEN c.contype = 'f' THEN 0 ELSE 1 END AS ord "
+			" FROM pg_constraint c "
+			" WHERE c.conrelid = '%s'::regclass AND c.contype IN ( 'u', 'f', 'x' ) "
+			" UNION ALL "
+			" SELECT i.relname, 'DROP INDEX ' || x.indexrelid::regclass, pg_get_indexdef( x.indexrelid ), '', 1, 2 "
+			" FROM pg_index x JOIN pg_class i ON i.oid = x.indexrelid "
+			" WHERE x.indrelid = '%s'::regclass AND NOT x.indisprimary "
+			" AND NOT EXISTS ( SELECT 1 FROM pg_constraint c WHERE c.conindid = x.indexrelid AND c.conrelid = x.indrelid ) "
+			") d ORDER BY ord, name";
+
+		snprintf( query, sizeof( query ), fmt, name, name );
+		res = PQexec( db->conn, query );
+		if ( PQresultStatus( res ) != PGRES_TUPLES_OK ) {
+			snprintf( err, errlen, "Failed to read indexes on '%s': %s", conn->tablename, PQerrorMessage( db->conn ) );
+			PQclear( res );
 			return 0;
 		}
 
-		// Walk through and find each column first
-		for ( int len = 0; strwalk( &p, (char *)file->map, delset ); ) {
-			char *t = ( !p.size ) ? no_header : copy( &((char *)file->map)[ p.pos ], p.size - 1, &len, case_type );
-			header_t *st = NULL;
-
-			// ...
-			if ( !( st = malloc( sizeof( header_t ) ) ) || !memset( st, 0, sizeof( header_t ) ) ) {
-				const char fmt[] = "Memory constraints encountered while fetching headers from file '%s'";
-				snprintf( err, errlen, fmt, conn->connstr );
+		for ( int i = 0, rcount = PQntuples( res ); i < rcount; i++ ) {
+			const char *online = PQgetvalue( res, i, 4 );
+			if ( !add_ddl( conn, PQgetvalue( res, i, 0 ), PQgetvalue( res, i, 1 ), PQgetvalue( res, i, 2 ), PQgetvalue( res, i, 3 ), *online == '1' ) ) {
+				snprintf( err, errlen, "Out of memory saving index definitions: %s", strerror( errno ) );
+				PQclear( res );
 				return 0;
 			}
-
-			snprintf( st->label, sizeof( st->label ) - 1, "%s", t );
-			add_item( &conn->headers, st, header_t *, &conn->hlen );
-			free( t );
-			if ( p.chr == '\n' || p.chr == '\r' ) break;
 		}
 
-		// TODO: You CAN still make a schema with an empty query...
-		// But this is kind of tricky to allow.
-		if ( !conn->hlen ) {
-			const char fmt[] = "No header data found, please double check the file or input query.";  
-			snprintf( err, errlen, fmt );
-			return 0;
-		}
-		else if ( conn->hlen < 2 ) {
-			const char fmt[] = "Array size is less than 2.  Does this look correct?: %s";  
-			header_t **header = conn->headers;
-			snprintf( err, errlen, fmt, (*header)->label );
-			return 0;
-		}
+		PQclear( res );
 	}
+#endif
 #ifdef BMYSQL_H
-	else if ( conn->type == DB_MYSQL ) {
+	if ( conn->type == DB_MYSQL ) {
 		mysql_t *db = (mysql_t *)conn->conn;
+		MYSQL_RES *res = NULL;
+
+		// Indexes backing a foreign key can't be dropped, and expression indexes
+		// (no COLUMN_NAME) can't be rebuilt from here, so both are left alone.
+		// An index backs a foreign key when the key's columns are its leading
+		// columns, in order, whatever either of them is called.
+		const char fmt[] = 
+			"SELECT s.INDEX_NAME, MAX( s.NON_UNIQUE ), MAX( s.INDEX_TYPE ), "
+			" GROUP_CONCAT( CONCAT( '`', s.COLUMN_NAME, '`', "
+			"  IF( s.SUB_PART IS NULL, '', CONCAT( '(', s.SUB_PART, ')' ) ) ) ORDER BY s.SEQ_IN_INDEX ) "
+			"FROM information_schema.STATISTICS s "
+			"WHERE s.TABLE_SCHEMA = DATABASE() AND s.TABLE_NAME = '%s' AND s.INDEX_NAME <> 'PRIMARY' "
+			"AND s.INDEX_NAME NOT IN ( "
+			" SELECT i.INDEX_NAME FROM information_schema.KEY_COLUMN_USAGE k "
+			" JOIN information_schema.STATISTICS i ON i.TABLE_SCHEMA = k.TABLE_SCHEMA AND i.TABLE_NAME = k.TABLE_NAME "
+			"  AND i.COLUMN_NAME = k.COLUMN_NAME AND i.SEQ_IN_INDEX = k.ORDINAL_POSITION "
+			" WHERE k.TABLE_SCHEMA = DATABASE() AND k.TABLE_NAME = '%s' AND k.REFERENCED_TABLE_NAME IS NOT NULL "
+			" GROUP BY k.CONSTRAINT_NAME, i.INDEX_NAME "
+			" HAVING COUNT( * ) = ( "
+			"  SELECT COUNT( * ) FROM information_schema.KEY_COLUMN_USAGE f "
+			"  WHERE f.TABLE_SCHEMA = DATABASE() AND f.TABLE_NAME = '%s' AND f.CONSTRAINT_NAME = k.CONSTRAINT_NAME ) ) "
+			"GROUP BY s.INDEX_NAME "
+			"HAVING COUNT( s.COLUMN_NAME ) = COUNT( * ) "
+			"ORDER BY s.INDEX_NAME";
+
+		snprintf( query, sizeof( query ), fmt, name, name, name );
+		if ( mysql_query( db->conn, query ) != 0 || !( res = mysql_store_result( db->conn ) ) ) {
+			snprintf( err, errlen, "Failed to read indexes on '%s': %s", conn->tablename, mysql_error( db->conn ) );
+			return 0;
+		}
 
-		for ( int i = 0, fcount = mysql_field_count( db->conn ); i < fcount; i++ ) {
-			MYSQL_FIELD *f = mysql_fetch_field_direct( db->res, i );
-			header_t *st = NULL;
+		for ( MYSQL_ROW r = NULL; ( r = mysql_fetch_row( res ) ); ) {
+			char drop[ 512 ] = { 0 }, create[ 2048 ] = { 0 };
+			const char *kind = "";
+			int online = 1;
+
+			if ( !strcmp( r[ 2 ], "FULLTEXT" ) )
+				kind = "FULLTEXT ", online = 0;
+			else if ( !strcmp( r[ 2 ], "SPATIAL" ) )
+				kind = "SPATIAL ", online = 0;
+			else if ( !strcmp( r[ 1 ], "0" ) ) {
+				kind = "UNIQUE ";
+			}
 
-			if ( !( st = malloc( sizeof( header_t ) )) || !memset( st, 0, sizeof( header_t ) ) ) {
-			//if ( CALLOC_NEW_FAILS( st, header_t ) ) {
-				const char fmt[] = "Memory constraints encountered while fetching headers from DSN %s";
-				snprintf( err, errlen, fmt, conn->connstr );
+			snprintf( drop, sizeof( drop ), "ALTER TABLE `%s` DROP INDEX `%s`", conn->tablename, r[ 0 ] );
+			snprintf( create, sizeof( create ), "ALTER TABLE `%s` ADD %sINDEX `%s` (%s)", conn->tablename, kind, r[ 0 ], r[ 3 ] );
+			if ( !add_ddl( conn, r[ 0 ], drop, create, NULL, online ) ) {
+				snprintf( err, errlen, "Out of memory saving index definitions: %s", strerror( errno ) );
+				mysql_free_result( res );
 				return 0;
 			}
-
-			// Get the actual type from the database engine
-			//st->ntype = f->type;
-			snprintf( st->label, sizeof( st->label ), "%s", f->name );
-			add_item( &conn->headers, st, header_t *, &conn->hlen );
 		}
 
-		// TODO: You CAN still make a schema with an empty query...
-		// But this is kind of tricky to allow.
-		if ( conn->hlen < 1 ) {
-			const char fmt[] = "No data was returned in the query.  Not attempting to generate headers.";
-			snprintf( err, errlen, fmt );
-			return 0;
-		}
+		mysql_free_result( res );
 	}
 #endif
 
-#ifdef BPGSQL_H
-	else if ( conn->type == DB_POSTGRESQL ) {
-		pgsql_t *db = (pgsql_t *)conn->conn;
+	return 1;
+}
 
-		for ( int i = 0, fcount = PQnfields( db->res ); i < fcount; i++ ) {
-			const char *name = PQfname( db->res, i );
-			header_t *st = NULL;
 
-			if ( !( st = malloc( sizeof( header_t ) ) ) || !memset( st, 0, sizeof( header_t ) ) ) {
-			//if ( CALLOC_NEW_FAILS( st, header_t ) ) {
-				fprintf( stderr, "Memory constraints encountered while building schema" );
-				return 0;
-			}
+/**
+ * int recreate_ddl ( dsn_t *conn, int concurrent, char *err, int errlen ) 
+ *
+ * Rebuild everything that defer_ddl() dropped, in the reverse order it
+ * was dropped.  If `concurrent` is set, indexes are built without 
+ * blocking writers where the engine supports it.
+ *
+ */
+int recreate_ddl ( dsn_t *conn, int concurrent, char *err, int errlen ) {
+	int failed = 0;
+	char ferr[ ERRLEN ] = { 0 };
 
-			// Get the actual type from the database engine
-			snprintf( st->label, sizeof( st->label ), "%s", name );
-			add_item( &conn->headers, st, header_t *, &conn->hlen );
+	for ( int i = conn->ddllen - 1; i >= 0; i-- ) {
+		ddl_t *d = conn->ddl[ i ];
+		char stmt[ 4096 ] = { 0 };
+		const char *create = d->create;
+
+		if ( !d->dropped ) {
+			continue;
+		}
+
+		// Ask for an online build if we can get one
+		if ( concurrent && d->online ) {
+		#ifdef BPGSQL_H
+			if ( conn->type == DB_POSTGRESQL && STRLCMP( create, "CREATE INDEX " ) )
+				snprintf( stmt, sizeof( stmt ), "CREATE INDEX CONCURRENTLY %s", &create[ 13 ] ), create = stmt;
+			else if ( conn->type == DB_POSTGRESQL && STRLCMP( create, "CREATE UNIQUE INDEX " ) )
+				snprintf( stmt, sizeof( stmt ), "CREATE UNIQUE INDEX CONCURRENTLY %s", &create[ 20 ] ), create = stmt;
+		#endif
+		#ifdef BMYSQL_H
+			if ( conn->type == DB_MYSQL )
+				snprintf( stmt, sizeof( stmt ), "%s, ALGORITHM=INPLACE, LOCK=NONE", create ), create = stmt;
+		#endif
+		}
+
+		if ( !query_dsn( conn, create, NULL, 0, ferr, sizeof( ferr ) ) ) {
+			fprintf( stderr, "WARNING: Failed to rebuild '%s': %s\n", d->name, ferr );
+			failed++;
+			continue;
+		}
+
+		if ( d->finish && !query_dsn( conn, d->finish, NULL, 0, ferr, sizeof( ferr ) ) ) {
+			fprintf( stderr, "WARNING: Failed to finish rebuilding '%s': %s\n", d->name, ferr );
+			failed++;
+			continue;
 		}
 
+		d->dropped = 0;
 	}
-#endif
-#ifdef BSQLITE_H
-	else if ( conn->type == DB_SQLITE ) {
-		snprintf( err, errlen, "%s", "SQLite3 driver not done yet" );
+
+	if ( failed ) {
+		const char fmt[] = "%d index(es) or constraint(s) on '%s' could not be rebuilt.  "
+			"Their definitions are saved in %s";
+		snprintf( err, errlen, fmt, failed, conn->tablename, conn->ddlfile );
 		return 0;
 	}
-#endif
-
 
+	// Everything is back, so the saved copy is no longer needed
+	if ( *conn->ddlfile ) {
+		unlink( conn->ddlfile );
+	}
+	destroy_dsn_ddl( conn );
 	return 1;
 }
 
 
-
-#if 0
-// TODO: This is coming back, just not right now...
 /**
- * struct_from_dsn( dsn_t * )
+ * int defer_ddl ( dsn_t *conn, char *err, int errlen ) 
  *
- * Create a struct from data source.
+ * Drop the secondary indexes and constraints of an output table 
+ * before a load.  The definitions are written to a file first, so 
+ * they can be restored by hand if briggs never gets the chance.
  *
  */
-int struct_from_dsn( dsn_t * conn ) {
+int defer_ddl ( dsn_t *conn, char *err, int errlen ) {
+	FILE *f = NULL;
+	const char *tmpdir = getenv( "TMPDIR" );
 
-	char **defs = NULL;
-	if ( classdata ) {
-		fprintf( stdout, "class %s {\n", root );
+	if ( !capture_ddl( conn, err, errlen ) ) {
+		return 0;
 	}
-	else {
-		fprintf( stdout, "struct %s {\n", root );
+
+	if ( !conn->ddllen ) {
+		return 1;
 	}
 
-	// Add the rest of the rows
-for ( header_t **s = conn->headers; s && *s; s++ ) {
-	fprintf( stdout, "\t%s %s;\n", defs[ (*s)->type ], (*s)->label );
-}
+	// Save a copy of everything before touching the table
+	snprintf( conn->ddlfile, sizeof( conn->ddlfile ), "%s/briggs-%s-%d.sql",
+		tmpdir ? tmpdir : "/tmp", conn->tablename, (int)getpid() );
 
-return 1;
+	if ( !( f = fopen( conn->ddlfile, "w" ) ) ) {
+		snprintf( err, errlen, "Couldn't save index definitions to %s: %s", conn->ddlfile, strerror( errno ) );
+		return 0;
+	}
+
+	for ( ddl_t **d = conn->ddl; d && *d; d++ ) {
+		fprintf( f, "%s;\n", (*d)->create );
+		( (*d)->finish ) ? fprintf( f, "%s;\n", (*d)->finish ) : 0;
+	}
+	fclose( f );
+
+	// Drop them, and put back what we already dropped if one fails
+	for ( ddl_t **d = conn->ddl; d && *d; d++ ) {
+		if ( !query_dsn( conn, (*d)->drop, NULL, 0, err, errlen ) ) {
+			char rerr[ ERRLEN ] = { 0 };
+			if ( !recreate_ddl( conn, 0, rerr, sizeof( rerr ) ) ) {
+				fprintf( stderr, "WARNING: %s\n", rerr );
+			}
+			return 0;
+		}
+		(*d)->dropped = 1;
+	}
+
+	return 1;
 }
-#endif
 
 
 /**
- * char * create_sql_insert_statement ( dsn_t *oconn, dsn_t *iconn, bindtype_t bindtype, char *err, int errlen ) 
+ * static int exec_rows_dsn ( dsn_t *conn, const char *query, char *err, int errlen ) 
  *
- * Create an SQL insert statement suitable for a specific type of database engine.
+ * Run a query that generates SQL, then run each statement it returned.
+ * A second column, if not empty, is run right after the first.
  *
  */
-char * create_sql_insert_statement ( dsn_t *oconn, dsn_t *iconn, bindtype_t bindtype, char *err, int errlen ) {
-	int p = 0;
-	char *bindstmt = NULL;
-	char  buffer[ 512 ] = { 0 };
-	const char *fmt = NULL;
+static int exec_rows_dsn ( dsn_t *conn, const char *query, char *err, int errlen ) {
+#ifdef BPGSQL_H
+	if ( conn->type == DB_POSTGRESQL ) {
+		pgsql_t *db = (pgsql_t *)conn->conn;
+		PGresult *res = PQexec( db->conn, query );
 
-	// TODO: Complians about not const string, fix this...
-	if ( bindtype == BINDTYPE_ANON )
-		fmt = bindtypes[ BINDTYPE_ANON ];
-	else if ( bindtype == BINDTYPE_NUMERIC )
-		fmt = bindtypes[ BINDTYPE_NUMERIC ];
-	else if ( bindtype == BINDTYPE_ALPHA )
-		fmt = bindtypes[ BINDTYPE_ALPHA ];
-	else if ( bindtype == BINDTYPE_AT ) {
-		fmt = bindtypes[ BINDTYPE_AT ];
-	}
+		if ( PQresultStatus( res ) != PGRES_TUPLES_OK ) {
+			snprintf( err, errlen, "%s", PQerrorMessage( db->conn ) );
+			PQclear( res );
+			return 0;
+		}
 
-	// Also go ahead and create the reusable bind statement
-	if ( !( bindstmt = malloc( 1 ) ) || !memset( bindstmt, 0, 1 ) ) {
-		const char fmt[] = "%s: out of memory occurred allocating MySQL bind statement: %s";
-		snprintf( err, errlen, fmt, __func__, strerror( errno ) );
-		return 0;	
-	}
+		for ( int i = 0, rcount = PQntuples( res ); i < rcount; i++ ) {
+			for ( int c = 0; c < PQnfields( res ) && c < 2; c++ ) {
+				const char *stmt = PQgetvalue( res, i, c );
+				if ( *stmt && !query_dsn( conn, stmt, NULL, 0, err, errlen ) ) {
+					PQclear( res );
+					return 0;
+				}
+			}
+		}
 
-	// Write the "preamble"
-	p = snprintf( buffer, sizeof( buffer ), "INSERT INTO %s ( ", oconn->tablename ); 
-	if ( p >= sizeof( buffer ) - 1 || buffer[p] != '\0' ) {
-		const char fmt[] = "%s: Truncation occurred writing MySQL bind statement";
-		snprintf( err, errlen, fmt, __func__ );
-		return 0;
+		PQclear( res );
 	}
+#endif
+#ifdef BMYSQL_H
+	if ( conn->type == DB_MYSQL ) {
+		mysql_t *db = (mysql_t *)conn->conn;
+		MYSQL_RES *res = NULL;
+		char **stmts = NULL;
+		int slen = 0, status = 1;
 
-	// Copy it and then loop through the rest
-	bindstmt = realloc( bindstmt, p );
-	memcpy( bindstmt, buffer, p );
+		// The result has to be drained before anything else can run
+		if ( mysql_query( db->conn, query ) != 0 || !( res = mysql_store_result( db->conn ) ) ) {
+			snprintf( err, errlen, "%s", mysql_error( db->conn ) );
+			return 0;
+		}
 
-	// All column headers 
-	for ( header_t **h = iconn->headers; h && *h; h++ ) {
-		int i = p;
-		int size = 0;
-		memset( buffer, 0, sizeof( buffer ) );
-		size = snprintf( buffer, sizeof( buffer ) - 1 , &",%s"[ ( *iconn->headers == *h ) ], (*h)->label );
-		p += size;
-		bindstmt = realloc( bindstmt, p );
-		memcpy( &bindstmt[ i ], buffer, size );	
-	}
+		for ( MYSQL_ROW r = NULL; ( r = mysql_fetch_row( res ) ); ) {
+			for ( unsigned int c = 0; c < mysql_num_fields( res ) && c < 2; c++ ) {
+				char *stmt = NULL;
+				if ( r[ c ] && *r[ c ] && ( stmt = strdup( r[ c ] ) ) ) {
+					add_item( &stmts, stmt, char *, &slen );
+				}
+			}
+		}
+		mysql_free_result( res );
 
-	// Then VALUES string
-	if ( 1 ) {
-		int i = p;
-		int size = 0;
-		memset( buffer, 0, sizeof( buffer ) );
-		size = snprintf( buffer, sizeof( buffer ), " ) VALUES ( " );
-		p += size;
-		bindstmt = realloc( bindstmt, p );
-		memcpy( &bindstmt[ i ], buffer, size );
-	}
+		for ( char **st = stmts; st && *st; st++ ) {
+			if ( status && !query_dsn( conn, *st, NULL, 0, err, errlen ) ) {
+				status = 0;
+			}
+			free( *st );
+		}
 
-	// Then each parameter 
-	// All column headers 
-	int column = 1;
-	for ( header_t **h = iconn->headers; h && *h; h++, column++ ) {
-		int i = p;
-		int size = 0;
-		int f = ( *iconn->headers == *h ) ? 0 : 1;
-		memset( buffer, 0, sizeof( buffer ) );
+		free( stmts );
+		return status;
+	}
+#endif
 
-		if ( f ) {
-			size = snprintf( buffer, sizeof( buffer ), "," );
-		} 
+	return 1;
+}
 
-		if ( bindtype == BINDTYPE_ANON )
-			size += snprintf( &buffer[f], sizeof( buffer ) - 1, "%s", fmt );
-		else if ( bindtype == BINDTYPE_NUMERIC )
-			size += snprintf( &buffer[f], sizeof( buffer ) - 1 , fmt, column ); 
-		else if ( bindtype == BINDTYPE_ALPHA )
-			size += snprintf( &buffer[f], sizeof( buffer ) - 1 , fmt, (*h)->label );
-		else if ( bindtype == BINDTYPE_AT ) {
-			size += snprintf( &buffer[f], sizeof( buffer ) - 1 , fmt, (*h)->label ); 
-		}
 
-		p += size;
-		bindstmt = realloc( bindstmt, p );
-		memcpy( &bindstmt[ i ], buffer, size );	
+#ifdef BPGSQL_H
+/**
+ * static int start_pgsql_copy ( dsn_t *oconn, dsn_t *iconn, const char *with, char *err, int errlen ) 
+ *
+ * Start a COPY ... FROM STDIN into oconn's table for the columns of 
+ * iconn.  `with` is added after the column list (e.g. COPY options).
+ *
+ */
+static int start_pgsql_copy ( dsn_t *oconn, dsn_t *iconn, const char *with, char *err, int errlen ) {
+	pgsql_t *t = (pgsql_t *)oconn->conn;
+	char stmt[ MAX_STMT_SIZE ] = { 0 };
+	PGresult *res = NULL;
+	int p = snprintf( stmt, sizeof( stmt ), "COPY %s ( ", oconn->tablename );
+
+	for ( header_t **h = iconn->headers; h && *h && p < sizeof( stmt ); h++ ) {
+		p += snprintf( &stmt[ p ], sizeof( stmt ) - p, &",%s"[ *iconn->headers == *h ], (*h)->label );
 	}
-	
-	// Then the end	
-	if ( 1 ) {
-		int i = p;
-		int size = 0;
-		memset( buffer, 0, sizeof( buffer ) );
-		size = snprintf( buffer, sizeof( buffer ), " )" );
-		p += size;
-		bindstmt = realloc( bindstmt, p );
-		memcpy( &bindstmt[ i ], buffer, size );
+
+	if ( p >= sizeof( stmt ) - 32 ) {
+		snprintf( err, errlen, "%s: Truncation occurred writing COPY statement", __func__ );
+		return 0;
 	}
 
-	// Terminate 
-	bindstmt = realloc( bindstmt, p + 1 );
-	memcpy( &bindstmt[ p ], "\0", 1 );
-	return bindstmt;
+	snprintf( &stmt[ p ], sizeof( stmt ) - p, " ) FROM STDIN%s", with );
+	if ( PQresultStatus( ( res = PQexec( t->conn, stmt ) ) ) != PGRES_COPY_IN ) {
+		snprintf( err, errlen, "Failed to start COPY: %s", PQerrorMessage( t->conn ) );
+		PQclear( res );
+		return 0;
+	}
+	PQclear( res );
+	return 1;
 }
 
 
 /**
- * int prepare_dsn_for_read ( dsn_t *conn, char *err, int errlen ) 
+ * static int end_pgsql_copy ( pgsql_t *db, char *err, int errlen ) 
  *
- * Prepare DSN for reading.  If we processed a limit, that would
- * really be the only way to make this work sensibly with SQL.
+ * Finish a COPY ... FROM STDIN and check that the server took it.
  *
  */
-int prepare_dsn_for_read ( dsn_t *conn, char *err, int errlen ) {
-	// Move up the buffer so that we start from the right offset
-	//while ( *(buffer++) != '\n' );
-	WHERE();
+static int end_pgsql_copy ( pgsql_t *db, char *err, int errlen ) {
+	PGresult *res = NULL;
+	int status = 1;
 
-	if ( conn->type == DB_FILE ) {
-		file_t *file = (file_t *)conn->conn;
-		int len = file->size;
+	if ( PQputCopyEnd( db->conn, NULL ) != 1 ) {
+		snprintf( err, errlen, "Failed to finish COPY: %s", PQerrorMessage( db->conn ) );
+		return 0;
+	}
 
-		// Move to the end of the first row
-		while ( len-- && *(file->map)++ != '\n' ) {
-			//file->map++, len--;
+	while ( ( res = PQgetResult( db->conn ) ) ) {
+		if ( PQresultStatus( res ) != PGRES_COMMAND_OK ) {
+			snprintf( err, errlen, "COPY failed: %s", PQresultErrorMessage( res ) );
+			status = 0;
 		}
-
-		file->offset = file->size - len;
-		DPRINTF( "file->offset: %d\n", file->offset );
-		DPRINTF( "file->size: %ld\n", file->size );
-		DPRINTF( "file->map: %p\n", (void *)file->map );
+		PQclear( res );
 	}
 
-	else if ( conn->type == DB_MYSQL ) {
-	}
+	return status;
+}
+#endif
 
-	else if ( conn->type == DB_POSTGRESQL ) {
-	}
 
-	return 1;
+#ifdef BPGSQL_H
+/**
+ * static char * pgsql_ident ( PGconn *conn, const char *name ) 
+ *
+ * Quote a table name for Postgres, folded to lower case the way it 
+ * is read unquoted everywhere else.  Free it with PQfreemem().
+ *
+ */
+static char * pgsql_ident ( PGconn *conn, const char *name ) {
+	char folded[ 64 ] = { 0 };
+	for ( int i = 0; name[ i ] && i < sizeof( folded ) - 1; i++ ) {
+		folded[ i ] = tolower( (unsigned char)name[ i ] );
+	}
+	return PQescapeIdentifier( conn, folded, strlen( folded ) );
 }
+#endif
 
 
 /**
- * int prepare_dsn_for_write ( dsn_t *, dsn_t *, char *, int) 
+ * int stage_dsn ( dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) 
  *
- * Prepare DSN for writing.  
+ * Create a shadow copy of the output table and point the output at it.
+ * The copy takes its columns, defaults and CHECK constraints from the 
+ * real table, while indexes and keys wait for swap_stage().  Tables 
+ * that another table's foreign key or a view depends on are refused 
+ * here, since the swap couldn't drop them at the end of the load.
+ * 
+ * Postgres gets a table created inside of a transaction, which lets 
+ * the load use COPY ... FREEZE (and skip the WAL when wal_level is 
+ * minimal).  It isn't UNLOGGED, since making it LOGGED for the swap
+ * would write the whole table a second time.
  *
  */
-int prepare_dsn_for_write ( dsn_t *oconn, dsn_t *iconn, char *err, int errlen ) {
-	WHERE();
+int stage_dsn ( dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) {
+	char stmt[ MAX_STMT_SIZE ] = { 0 }, deps[ 1024 ] = { 0 };
 
-	if ( oconn->type == DB_FILE ) {
-		file_t *file = (file_t *)oconn->conn;
-		// Reading happens from the input source, so that is another story
-		if ( oconn->stream == STREAM_PRINTF || oconn->stream == STREAM_COMMA ) 
-			;
-		if ( oconn->stream == STREAM_CSTRUCT )
-			;
-		if ( oconn->stream == STREAM_CARRAY )
-			;
-		if ( oconn->stream == STREAM_JSON )
-			FDPRINTF( file->fd, "[" );
-		if ( oconn->stream == STREAM_XML ) {
-			char *treename = strlen( oconn->dbname ) ? oconn->dbname : "tree";
-			FDPRINTF( file->fd, "<" );
-			FDPRINTF( file->fd, treename );
-			FDPRINTF( file->fd, ">" );
-			FF.newline ? FDPRINTF( file->fd, "\n" ) : 0;
-		}	
+	if ( oconn->type != DB_POSTGRESQL && oconn->type != DB_MYSQL ) {
+		snprintf( err, errlen, "--stage only works with Postgres and MySQL outputs" );
+		return 0;
 	}
 
+	// Everything from here on writes to the shadow table
+	snprintf( oconn->livename, sizeof( oconn->livename ), "%s", oconn->tablename );
+	snprintf( oconn->tablename, sizeof( oconn->tablename ), "%.56s_stage", oconn->livename );
 
-	else if ( oconn->type == DB_MYSQL ) {
-		WPRINTF( "PREPARING MySQL DSN: %d columns\n", iconn->hlen );
+#ifdef BPGSQL_H
+	if ( oconn->type == DB_POSTGRESQL ) {
+		pgsql_t *db = (pgsql_t *)oconn->conn;
+		char *live = NULL, *stage = NULL, *llive = NULL;
+		int status = 0;
+
+		// Foreign keys in other tables, and views, that point at the real table
+		const char fmt[] = 
+			"SELECT string_agg( DISTINCT n, ', ' ) FROM ( "
+			" SELECT c.conrelid::regclass::text AS n FROM pg_constraint c "
+			" WHERE c.confrelid = %s::regclass AND c.conrelid <> c.confrelid AND c.contype = 'f' "
+			" UNION ALL "
+			" SELECT r.ev_class::regclass::text FROM pg_depend d JOIN pg_rewrite r ON r.oid = d.objid "
+			" WHERE d.classid = 'pg_rewrite'::regclass AND d.refobjid = %s::regclass AND r.ev_class <> d.refobjid "
+			") x";
+
+		if ( !( live = pgsql_ident( db->conn, oconn->livename ) ) || !( stage = pgsql_ident( db->conn, oconn->tablename ) )
+			|| !( llive = PQescapeLiteral( db->conn, live, strlen( live ) ) ) ) {
+			snprintf( err, errlen, "Failed to quote table name: %s", PQerrorMessage( db->conn ) );
+			PQfreemem( live ), PQfreemem( stage );
+			return 0;
+		}
 
-		// Deref and check that this is still here...
-		mysql_t *t = (mysql_t *)oconn->conn;	
-	
-		// Make the insert statement
-		if ( !( t->query = create_sql_insert_statement( oconn, iconn, BINDTYPE_ANON, err, errlen ) ) ) {
+		snprintf( stmt, sizeof( stmt ), fmt, llive, llive );
+		PQfreemem( llive );
+		if ( !query_dsn( oconn, stmt, deps, sizeof( deps ), err, errlen ) || *deps ) {
+			if ( *deps )
+				snprintf( err, errlen, "Can't stage '%s', %s depend on it and would block the swap", oconn->livename, deps );
+			PQfreemem( live ), PQfreemem( stage );
 			return 0;
 		}
 
-		// Allocate statement and bind arguments structures
-		t->stmt = (void *)mysql_stmt_init( (MYSQL *)t->conn );
+		// The table has to be created in the same transaction as the COPY for FREEZE to work
+		if ( query_dsn( oconn, "BEGIN", NULL, 0, err, errlen ) ) {
+			snprintf( stmt, sizeof( stmt ), "CREATE TABLE %s ( LIKE %s INCLUDING ALL EXCLUDING INDEXES )", stage, live );
+			status = query_dsn( oconn, stmt, NULL, 0, err, errlen );
+		}
 
-		if ( !( t->bindargs = malloc( sizeof( MYSQL_BIND ) * iconn->hlen ) ) || !memset( t->bindargs, 0, sizeof( MYSQL_BIND ) * iconn->hlen ) ) {
-			const char fmt[] = "%s: out of memory occurred allocating MySQL bind structures: %s";
-			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
-			return 0;	
+		PQfreemem( live ), PQfreemem( stage );
+		if ( !status ) {
+			query_dsn( oconn, "ROLLBACK", NULL, 0, NULL, 0 );
+			return 0;
+		}
+
+		db->copy = 1;
+	}
+#endif
+#ifdef BMYSQL_H
+	if ( oconn->type == DB_MYSQL ) {
+		char live[ 2 * sizeof( oconn->livename ) + 1 ] = { 0 }, stage[ 2 * sizeof( oconn->tablename ) + 1 ] = { 0 };
+
+		// The primary key comes along, the other indexes are built after the load
+		const char fmt[] = 
+			"SELECT CONCAT( 'ALTER TABLE `%s` DROP INDEX `', s.INDEX_NAME, '`' ) "
+			"FROM information_schema.STATISTICS s "
+			"WHERE s.TABLE_SCHEMA = DATABASE() AND s.TABLE_NAME = '%s' AND s.INDEX_NAME <> 'PRIMARY' "
+			"GROUP BY s.INDEX_NAME "
+			"HAVING COUNT( s.COLUMN_NAME ) = COUNT( * )";
+
+		// Foreign keys in other tables would follow the real table to its old name, and block dropping it
+		const char depfmt[] = 
+			"SELECT GROUP_CONCAT( DISTINCT CONCAT( k.TABLE_SCHEMA, '.', k.TABLE_NAME ) SEPARATOR ', ' ) "
+			"FROM information_schema.KEY_COLUMN_USAGE k "
+			"WHERE k.REFERENCED_TABLE_SCHEMA = DATABASE() AND k.REFERENCED_TABLE_NAME = '%s' "
+			"AND NOT ( k.TABLE_SCHEMA = DATABASE() AND k.TABLE_NAME = '%s' )";
+
+		escape_dsn( oconn, oconn->livename, live, sizeof( live ) );
+		escape_dsn( oconn, oconn->tablename, stage, sizeof( stage ) );
+		snprintf( stmt, sizeof( stmt ), depfmt, live, live );
+		if ( !query_dsn( oconn, stmt, deps, sizeof( deps ), err, errlen ) )
+			return 0;
+		else if ( *deps ) {
+			snprintf( err, errlen, "Can't stage '%s', %s depend on it and would block the swap", oconn->livename, deps );
+			return 0;
+		}
+
+		snprintf( stmt, sizeof( stmt ), "DROP TABLE IF EXISTS `%s`", oconn->tablename );
+		if ( !query_dsn( oconn, stmt, NULL, 0, err, errlen ) ) {
+			return 0;
+		}
+
+		snprintf( stmt, sizeof( stmt ), "CREATE TABLE `%s` LIKE `%s`", oconn->tablename, oconn->livename );
+		if ( !query_dsn( oconn, stmt, NULL, 0, err, errlen ) ) {
+			return 0;
+		}
+
+		snprintf( stmt, sizeof( stmt ), fmt, stage, stage );
+		if ( !exec_rows_dsn( oconn, stmt, err, errlen ) ) {
+			return 0;
 		}
 	}
+#endif
 
-	else if ( oconn->type == DB_POSTGRESQL ) {
-		WPRINTF( "PREPARING PostgreSQL DSN: %d columns\n", iconn->hlen );
+	return 1;
+}
 
-		// Der
-		pgsql_t *t = (pgsql_t *)oconn->conn;	
 
-		// Make the insert statement
-		if ( !( t->query = create_sql_insert_statement( oconn, iconn, BINDTYPE_NUMERIC, err, errlen ) ) ) {
+/**
+ * int swap_stage ( dsn_t *oconn, char *err, int errlen ) 
+ *
+ * Finish loading a shadow table, build the keys, indexes and foreign
+ * keys that the real table has, then swap the two.  Readers see 
+ * either the old table or the new one, never anything in between.
+ *
+ */
+int swap_stage ( dsn_t *oconn, char *err, int errlen ) {
+	char stmt[ 8192 ] = { 0 };
+
+#ifdef BPGSQL_H
+	if ( oconn->type == DB_POSTGRESQL ) {
+		pgsql_t *db = (pgsql_t *)oconn->conn;
+		PGresult *res = NULL;
+		char *live = NULL, *stage = NULL, *llive = NULL, *lstage = NULL;
+		int status = 1;
+
+		// Every statement of the swap, in the order it has to run.  Keys and unique 
+		// constraints are built on the shadow table under a temporary name (they own 
+		// an index, and index names are unique per schema), then renamed once the 
+		// real table is gone.  Sequences of serial columns move over before the drop, 
+		// and identity columns carry on from the highest value loaded.
+		const char fmt[] = 
+			"WITH t AS ( SELECT %s::text AS live, %s::text AS stage ) "
+			"SELECT stmt FROM ( "
+			" SELECT 1 AS ord, 'ALTER TABLE ' || t.stage || ' ADD CONSTRAINT ' || quote_ident( c.conname || '_stage' ) "
+			"  || ' ' || pg_get_constraintdef( c.oid ) AS stmt, c.conname::text AS name "
+			" FROM t, pg_constraint c WHERE c.conrelid = t.live::regclass AND c.contype IN ( 'p', 'u', 'x' ) "
+			" UNION ALL "
+			" SELECT 2, regexp_replace( pg_get_indexdef( x.indexrelid ), "
+			"  '^(CREATE (UNIQUE )?INDEX )\\S+ ON (ONLY )?\\S+', '\\1' || quote_ident( i.relname || '_stage' ) || ' ON ' || t.stage ), i.relname "
+			" FROM t, pg_index x JOIN pg_class i ON i.oid = x.indexrelid "
+			" WHERE x.indrelid = t.live::regclass "
+			" AND NOT EXISTS ( SELECT 1 FROM pg_constraint c WHERE c.conindid = x.indexrelid AND c.conrelid = x.indrelid ) "
+			" UNION ALL "
+			" SELECT 3, 'ALTER TABLE ' || t.stage || ' ADD CONSTRAINT ' || quote_ident( c.conname ) || ' ' || pg_get_constraintdef( c.oid ), c.conname "
+			" FROM t, pg_constraint c WHERE c.conrelid = t.live::regclass AND c.contype = 'f' "
+			" UNION ALL "
+			" SELECT 4, 'SELECT setval( ' || quote_literal( pg_get_serial_sequence( t.stage, a.attname ) ) "
+			"  || ', COALESCE( max( ' || quote_ident( a.attname ) || ' ), 0 ) + 1, false ) FROM ' || t.stage, a.attname "
+			" FROM t, pg_attribute a WHERE a.attrelid = t.stage::regclass AND a.attidentity <> '' "
+			" UNION ALL "
+			" SELECT 5, 'ALTER SEQUENCE ' || d.objid::regclass || ' OWNED BY ' || t.stage || '.' || quote_ident( a.attname ), a.attname "
+			" FROM t, pg_depend d JOIN pg_class q ON q.oid = d.objid AND q.relkind = 'S' "
+			"  JOIN pg_attribute a ON a.attrelid = d.refobjid AND a.attnum = d.refobjsubid "
+			" WHERE d.classid = 'pg_class'::regclass AND d.refobjid = t.live::regclass AND d.deptype = 'a' "
+			" UNION ALL "
+			" SELECT 6, 'DROP TABLE ' || t.live, '' FROM t "
+			" UNION ALL "
+			" SELECT 7, 'ALTER TABLE ' || t.stage || ' RENAME TO ' || t.live, '' FROM t "
+			" UNION ALL "
+			" SELECT 8, 'ALTER TABLE ' || t.live || ' RENAME CONSTRAINT ' || quote_ident( c.conname || '_stage' ) "
+			"  || ' TO ' || quote_ident( c.conname ), c.conname "
+			" FROM t, pg_constraint c WHERE c.conrelid = t.live::regclass AND c.contype IN ( 'p', 'u', 'x' ) "
+			" UNION ALL "
+			" SELECT 9, 'ALTER INDEX ' || quote_ident( i.relname || '_stage' ) || ' RENAME TO ' || quote_ident( i.relname ), i.relname "
+			" FROM t, pg_index x JOIN pg_class i ON i.oid = x.indexrelid "
+			" WHERE x.indrelid = t.live::regclass "
+			" AND NOT EXISTS ( SELECT 1 FROM pg_constraint c WHERE c.conindid = x.indexrelid AND c.conrelid = x.indrelid ) "
+			") s ORDER BY ord, name";
+
+		// Finish the COPY
+		if ( db->copy ) {
+			db->copy = 0;
+			if ( !end_pgsql_copy( db, err, errlen ) ) {
+				return 0;
+			}
+		}
+
+		if ( !( live = pgsql_ident( db->conn, oconn->livename ) ) || !( stage = pgsql_ident( db->conn, oconn->tablename ) )
+			|| !( llive = PQescapeLiteral( db->conn, live, strlen( live ) ) ) || !( lstage = PQescapeLiteral( db->conn, stage, strlen( stage ) ) ) ) {
+			snprintf( err, errlen, "Failed to quote table name: %s", PQerrorMessage( db->conn ) );
+			PQfreemem( live ), PQfreemem( stage ), PQfreemem( llive );
 			return 0;
 		}
 
-		if ( !( t->bindargs = malloc( sizeof( char * ) * iconn->hlen ) ) || !memset( t->bindargs, 0, sizeof( char * ) * iconn->hlen ) ) {
-			const char fmt[] = "%s: out of memory occurred allocating Postgres bind structures: %s";
-			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+		snprintf( stmt, sizeof( stmt ), fmt, llive, lstage );
+		PQfreemem( live ), PQfreemem( stage ), PQfreemem( llive ), PQfreemem( lstage );
+		if ( !( res = PQexec( db->conn, stmt ) ) || PQresultStatus( res ) != PGRES_TUPLES_OK ) {
+			snprintf( err, errlen, "Failed to read indexes on '%s': %s", oconn->livename, PQerrorMessage( db->conn ) );
+			PQclear( res );
 			return 0;
 		}
 
-		if ( !( t->bindlens = malloc( sizeof( int ) * iconn->hlen ) ) || !memset( t->bindargs, 0, sizeof( int ) * iconn->hlen ) ) {
-			const char fmt[] = "%s: out of memory occurred allocating Postgres bind length structures: %s";
-			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
-			return 0;	
+		for ( int i = 0, rcount = PQntuples( res ); status && i < rcount; i++ ) {
+			status = query_dsn( oconn, PQgetvalue( res, i, 0 ), NULL, 0, err, errlen );
 		}
 
-		if ( !( t->bindoids = malloc( sizeof( char * ) * iconn->hlen ) ) || !memset( t->bindoids, 0, sizeof( char * ) * iconn->hlen ) ) {
-			const char fmt[] = "%s: out of memory occurred allocating Postgres bind types structures: %s";
-			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+		PQclear( res );
+		if ( !status || !query_dsn( oconn, "COMMIT", NULL, 0, err, errlen ) ) {
+			return 0;
+		}
+	}
+#endif
+#ifdef BMYSQL_H
+	if ( oconn->type == DB_MYSQL ) {
+		char old[ 64 ] = { 0 }, eold[ 2 * sizeof( old ) + 1 ] = { 0 };
+		char live[ 2 * sizeof( oconn->livename ) + 1 ] = { 0 }, stage[ 2 * sizeof( oconn->tablename ) + 1 ] = { 0 };
+		const char fmt[] = 
+			"SELECT CONCAT( 'ALTER TABLE `%s` ADD ', "
+			" CASE WHEN MAX( s.INDEX_TYPE ) = 'FULLTEXT' THEN 'FULLTEXT ' "
+			"  WHEN MAX( s.INDEX_TYPE ) = 'SPATIAL' THEN 'SPATIAL ' "
+			"  WHEN MAX( s.NON_UNIQUE ) = 0 THEN 'UNIQUE ' ELSE '' END, "
+			" 'INDEX `', s.INDEX_NAME, '` (', "
+			" GROUP_CONCAT( CONCAT( '`', s.COLUMN_NAME, '`', "
+			"  IF( s.SUB_PART IS NULL, '', CONCAT( '(', s.SUB_PART, ')' ) ) ) ORDER BY s.SEQ_IN_INDEX ), ')' ) "
+			"FROM information_schema.STATISTICS s "
+			"WHERE s.TABLE_SCHEMA = DATABASE() AND s.TABLE_NAME = '%s' AND s.INDEX_NAME <> 'PRIMARY' "
+			"GROUP BY s.INDEX_NAME "
+			"HAVING COUNT( s.COLUMN_NAME ) = COUNT( * )";
+
+		// Foreign key names are unique per schema, so each one comes off the old table before it goes on the new one
+		const char fkfmt[] = 
+			"SELECT CONCAT( 'ALTER TABLE `%s` DROP FOREIGN KEY `', k.CONSTRAINT_NAME, '`' ), "
+			" CONCAT( 'ALTER TABLE `%s` ADD CONSTRAINT `', k.CONSTRAINT_NAME, '` FOREIGN KEY (', "
+			"  GROUP_CONCAT( CONCAT( '`', k.COLUMN_NAME, '`' ) ORDER BY k.ORDINAL_POSITION ), ') REFERENCES `', "
+			"  k.REFERENCED_TABLE_SCHEMA, '`.`', k.REFERENCED_TABLE_NAME, '` (', "
+			"  GROUP_CONCAT( CONCAT( '`', k.REFERENCED_COLUMN_NAME, '`' ) ORDER BY k.ORDINAL_POSITION ), "
+			"  ') ON DELETE ', r.DELETE_RULE, ' ON UPDATE ', r.UPDATE_RULE ) "
+			"FROM information_schema.KEY_COLUMN_USAGE k JOIN information_schema.REFERENTIAL_CONSTRAINTS r "
+			" ON r.CONSTRAINT_SCHEMA = k.CONSTRAINT_SCHEMA AND r.CONSTRAINT_NAME = k.CONSTRAINT_NAME AND r.TABLE_NAME = k.TABLE_NAME "
+			"WHERE k.TABLE_SCHEMA = DATABASE() AND k.TABLE_NAME = '%s' AND k.REFERENCED_TABLE_NAME IS NOT NULL "
+			"GROUP BY k.CONSTRAINT_NAME, k.REFERENCED_TABLE_SCHEMA, k.REFERENCED_TABLE_NAME, r.DELETE_RULE, r.UPDATE_RULE";
+
+		// Every name below goes into a string literal
+		escape_dsn( oconn, oconn->livename, live, sizeof( live ) );
+		escape_dsn( oconn, oconn->tablename, stage, sizeof( stage ) );
+		snprintf( stmt, sizeof( stmt ), fmt, stage, live );
+		if ( !exec_rows_dsn( oconn, stmt, err, errlen ) ) {
 			return 0;
 		}
 
-		if ( !( t->bindfmts = malloc( sizeof( int ) * iconn->hlen ) ) || !memset( t->bindfmts, 0, sizeof( int ) * iconn->hlen ) ) {
-			const char fmt[] = "%s: out of memory occurred allocating Postgres bind types structures: %s";
-			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+		// RENAME TABLE swaps both at once
+		snprintf( old, sizeof( old ), "%.56s_old", oconn->livename );
+		snprintf( stmt, sizeof( stmt ), "RENAME TABLE `%s` TO `%s`, `%s` TO `%s`",
+			oconn->livename, old, oconn->tablename, oconn->livename );
+		if ( !query_dsn( oconn, stmt, NULL, 0, err, errlen ) ) {
+			return 0;
+		}
+
+		escape_dsn( oconn, old, eold, sizeof( eold ) );
+		snprintf( stmt, sizeof( stmt ), fkfmt, eold, live, eold );
+		if ( !exec_rows_dsn( oconn, stmt, err, errlen ) ) {
+			return 0;
+		}
+
+		snprintf( stmt, sizeof( stmt ), "DROP TABLE `%s`", old );
+		if ( !query_dsn( oconn, stmt, NULL, 0, err, errlen ) ) {
 			return 0;
 		}
 	}
+#endif
 
+	snprintf( oconn->tablename, sizeof( oconn->tablename ), "%s", oconn->livename );
 	return 1;
 }
 
 
 /**
- * void unprepare_dsn( dsn_t *conn ) 
+ * void abort_stage ( dsn_t *oconn ) 
  *
- * "Unmount" different data sources (e.g. closing a database or something)
+ * Throw away a shadow table after a failed load.  The real table is 
+ * never touched.
  *
  */
-void unprepare_dsn( dsn_t *conn ) {
-	// Rewinding the pointer to the beginning would be an ok idea. But unnecessary
-	if ( conn->type == DB_FILE ) {
-		WPRINTF( "UNPREPARING FILE DSN\n" );
-		file_t *file = (file_t *)conn->conn;
-		// Reading happens from the input source, so that is another story
-		if ( conn->stream == STREAM_PRINTF || conn->stream == STREAM_COMMA ) 
-			;
-		else if ( conn->stream == STREAM_CSTRUCT )
-			;
-		else if ( conn->stream == STREAM_CARRAY )
-			;
-		else if ( conn->stream == STREAM_JSON )
-			FDPRINTF( file->fd, "]" );
-		else if ( conn->stream == STREAM_XML ) {
-			char *treename = strlen( conn->dbname ) ? conn->dbname : "tree";
-			FDPRINTF( file->fd, "</" );
-			FDPRINTF( file->fd, treename );
-			FDPRINTF( file->fd, ">" );
-		}
-		
+void abort_stage ( dsn_t *oconn ) {
+	if ( !*oconn->livename || !oconn->conn ) {
+		return;
 	}
 
-	else if ( conn->type == DB_MYSQL ) {
-		WPRINTF( "UNPREPARING MySQL DSN\n" );
-		mysql_t *t = (mysql_t *)conn->conn;	
-		mysql_stmt_close( t->stmt );
-		free( t->bindargs );
-		free( (void *)t->query );
+#ifdef BPGSQL_H
+	if ( oconn->type == DB_POSTGRESQL ) {
+		pgsql_t *db = (pgsql_t *)oconn->conn;
+		PGresult *res = NULL;
+
+		// The table was created in this transaction, so this is all it takes
+		if ( db->copy ) {
+			db->copy = 0;
+			PQputCopyEnd( db->conn, "load aborted" );
+			while ( ( res = PQgetResult( db->conn ) ) ) {
+				PQclear( res );
+			}
+		}
+		query_dsn( oconn, "ROLLBACK", NULL, 0, NULL, 0 );
 	}
-
-	else if ( conn->type == DB_POSTGRESQL ) {
-		WPRINTF( "UNPREPARING Postgres DSN\n" );
-		pgsql_t *t = (pgsql_t *)conn->conn;	
-		free( t->bindargs );
-		free( t->bindlens );
-		free( t->bindfmts );
-		free( t->bindoids );
-		free( (void *)t->query );
+#endif
+#ifdef BMYSQL_H
+	if ( oconn->type == DB_MYSQL ) {
+		char stmt[ 256 ] = { 0 };
+		snprintf( stmt, sizeof( stmt ), "DROP TABLE IF EXISTS `%s`", oconn->tablename );
+		query_dsn( oconn, stmt, NULL, 0, NULL, 0 );
 	}
-}
+#endif
 
+	snprintf( oconn->tablename, sizeof( oconn->tablename ), "%s", oconn->livename );
+}
 
 
 /**
- * records_from_dsn( dsn_t * )
- *
- * Extract records from a data source.
+ * int pushdown_dsn ( config_t *conf, dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) 
  *
- * conn = The source we're reading records from
- * count = Number of "rows" to read at a time
- * offset = Where to start from next
+ * Copy the input into the output with one INSERT ... SELECT, run by 
+ * the output connection.  The rows never leave the server.  
+ * scaffold_dsn() decides when this can be used.
  *
  */
-int records_from_dsn( dsn_t *conn, int count, int offset, char *err, int errlen ) {
-	WHERE();
+int pushdown_dsn ( config_t *conf, dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) {
+	char source[ 2048 ] = { 0 };
+	char named[ 256 ] = { 0 };
+	char stmt[ MAX_STMT_SIZE ] = { 0 };
+	int p = snprintf( stmt, sizeof( stmt ), "INSERT INTO %s ( ", oconn->tablename );
+	config_t c;
+
+	// Name the input the way the output connection sees it, and keep --limit and --offset
+	memcpy( &c, conf, sizeof( config_t ) );
+	if ( !conf->wquery && strcmp( iconn->dbname, oconn->dbname ) ) {
+		snprintf( named, sizeof( named ), "SELECT * FROM %s.%s", iconn->dbname, iconn->tablename );
+		c.wquery = named;
+	}
+	select_for_dsn( iconn, &c, source, sizeof( source ) );
 
-	if ( conn->type == DB_FILE ) {
-		zw_t *p = malloc( sizeof( zw_t ) );
-		memset( p, 0, sizeof( zw_t ) );
-		column_t **cols = NULL;
-		row_t *row = NULL;
-		file_t *file = NULL;
+	for ( header_t **h = iconn->headers; h && *h && p < sizeof( stmt ); h++ ) {
+		p += snprintf( &stmt[ p ], sizeof( stmt ) - p, &",%s"[ *iconn->headers == *h ], (*h)->label );
+	}
 
-		const unsigned int dlen = strlen( delset );
-		unsigned int ci = 0;
-		unsigned int line = 0;
-		unsigned char *dset = (unsigned char *)delset;
-		int clen = 0;
+	if ( p < sizeof( stmt ) ) {
+		p += snprintf( &stmt[ p ], sizeof( stmt ) - p, " ) SELECT * FROM ( %s ) briggs_pushdown", source );
+	}
 
-		// Cast
-		if ( !( file = (file_t *)conn->conn ) ) {
-			const char fmt[] = "mmap() lost reference";
-			snprintf( err, errlen, fmt );
+	if ( p >= sizeof( stmt ) ) {
+		snprintf( err, errlen, "%s: Truncation occurred writing INSERT ... SELECT statement", __func__ );
+		return 0;
+	}
+
+#ifdef BPGSQL_H
+	if ( oconn->type == DB_POSTGRESQL ) {
+		pgsql_t *db = (pgsql_t *)oconn->conn;
+		PGresult *res = PQexec( db->conn, stmt );
+
+		if ( PQresultStatus( res ) != PGRES_COMMAND_OK ) {
+			snprintf( err, errlen, "INSERT ... SELECT failed: %s", PQerrorMessage( db->conn ) );
+			PQclear( res );
 			return 0;
 		}
 
-		// Cycle through the set of entries that we want
-		//for ( column_t *col = NULL; memwalk( p, file->map, dset, file->size - file->offset, dlen ) && line < count; ) {
-		for ( ; memwalk( p, file->map, dset, file->size - file->offset, dlen ) && line < count; ) {
+		// --stage expected a COPY in its transaction, but this took its place
+		iconn->rtotal = strtoul( PQcmdTuples( res ), NULL, 10 );
+		db->copy = 0;
+		PQclear( res );
+		return 1;
+	}
+#endif
+#ifdef BMYSQL_H
+	if ( oconn->type == DB_MYSQL ) {
+		mysql_t *db = (mysql_t *)oconn->conn;
 
-			// Deifne some stuff to make this easier to walk
-			column_t *col = NULL;
-			type_t etype = T_NULL;
+		if ( mysql_query( db->conn, stmt ) != 0 ) {
+			snprintf( err, errlen, "INSERT ... SELECT failed: %s", mysql_error( db->conn ) );
+			return 0;
+		}
 
-			// Increase the line count
-			if ( p->chr == '\r' ) {
-				line++;
-				continue;
-			}
+		iconn->rtotal = (unsigned long)mysql_affected_rows( db->conn );
+		return 1;
+	}
+#endif
 
-			// Exit if the column count indicates that this is not uniform data
-			if ( ci > conn->hlen ) {
-				const char fmt[] = "Column count (%d) does not match header count (%d) at line %d in file '%s'";
-				snprintf( err, errlen, fmt, ci, conn->hlen, line, conn->connstr );
-				return 0;
-			}
+	snprintf( err, errlen, "Can't copy %s datasources on the server", get_conn_type( oconn->type ) );
+	return 0;
+}
 
-			// Allocate, prepare and set column values
-			if ( !( col = malloc( sizeof( column_t ) ) ) || !memset( col, 0, sizeof( column_t ) ) ) {
-				const char fmt[] = "Out of memory when allocating space for value at line %d, column %d: %s";
-				snprintf( err, errlen, fmt, line, ci, strerror( errno ) );
+
+#ifdef BPGSQL_H
+/**
+ * static int copy_row_to_pgsql ( pgsql_t *b, row_t *row, char *err, int errlen ) 
+ *
+ * Write one row in COPY's text format.
+ *
+ */
+static int copy_row_to_pgsql ( pgsql_t *b, row_t *row, char *err, int errlen ) {
+	int len = 0;
+
+	for ( column_t **col = row->columns; col && *col; col++ ) {
+		column_t *c = *col;
+		int need = len + ( c->len * 2 ) + 8;
+
+		// Escaping at most doubles a value
+		if ( need > b->copysize ) {
+			char *buf = NULL;
+			if ( !( buf = realloc( b->copybuf, need * 2 ) ) ) {
+				snprintf( err, errlen, "Out of memory building COPY row: %s", strerror( errno ) );
 				return 0;
 			}
+			b->copybuf = buf, b->copysize = need * 2;
+		}
 
-			// Get approximate types from the datasource and all of the other info
-			etype = conn->headers[ ci ]->type;
-			col->k = conn->headers[ ci ]->label;
-			col->v = &( (unsigned char *)file->map)[ p->pos ];
-			col->len = p->size - 1;
-
-			// Check the actual type against the expected type
-			if ( ( col->type = get_type( col->v, etype, col->len ) ) != etype ) {
-			//if ( col->type != etype ) {
-				// Integers can pass as floats
-				if ( col->type == T_INTEGER && etype == T_DOUBLE ) {
-					const char fmt[] = "WARNING: Value at row %d, column '%s' (%d). Expected T_DOUBLE got T_INTEGER\n";
-					fprintf( stderr, fmt, line + 1, col->k, ci + 1 );
-				}
-				else if ( col->type == T_INTEGER && etype == T_STRING ) {
-					const char fmt[] = "WARNING: Value at row %d, column '%s' (%d). Expected T_STRING got T_INTEGER\n";
-					fprintf( stderr, fmt, line + 1, col->k, ci + 1 );
-				} 
-				// If I'm supposed to have a boolean and it comes back as an INTEGER, this isn't a problem if the value is right
-				else if ( col->type == T_INTEGER && etype == T_BOOLEAN ) {
-					// You'll have to convert the number and see if it's a 0 or 1
-					int check = usafecpynumeric( col->v, col->len ); 
-					if ( check > 1 || check < 0 ) {
-						const char fmt[] = "Type check for value at row %d, column '%s' (%d) failed. (Expected T_BOOLEAN, got T_INTEGER)";
-						snprintf( err, errlen, fmt, line + 1, col->k, ci + 1 );
-						return 0;
-					} 
-					const char fmt[] = "WARNING: Value at row %d, column '%s' (%d). Expected T_BOOLEAN got T_INTEGER\n";
-					fprintf( stderr, fmt, line + 1, col->k, ci + 1 );
-				}
-
-				// Chars can pass as strings
-				else if ( col->type == T_CHAR && etype == T_STRING ) {
-					const char fmt[] = "WARNING: Value at row %d, column '%s' (%d). Expected T_STRING got T_CHAR";
-					fprintf( stderr, fmt, line + 1, col->k, ci + 1 );
-				}
+		( col != row->columns ) ? b->copybuf[ len++ ] = '\t' : 0;
 
-				// Anything else is a failure for now
-				else {
-					const char fmt[] = "Type check for value at row %d, column '%s' (%d) failed. (Expected %s, got %s)";
-					snprintf( err, errlen, fmt, line + 1, col->k, ci + 1, itypes[ etype ], itypes[ col->type ] );
-					return 0;
-				}
+		if ( !c->len && c->type != T_STRING && c->type != T_BINARY && c->type != T_CHAR ) {
+			memcpy( &b->copybuf[ len ], "\\N", 2 ), len += 2;
+		}
+		else if ( c->type == T_BINARY ) {
+			const char hex[] = "0123456789abcdef";
+			memcpy( &b->copybuf[ len ], "\\\\x", 3 ), len += 3;
+			for ( unsigned long i = 0; i < c->len; i++ ) {
+				b->copybuf[ len++ ] = hex[ c->v[ i ] >> 4 ];
+				b->copybuf[ len++ ] = hex[ c->v[ i ] & 0x0f ];
 			}
-
-			// Add columns and increase column count
-			add_item( &cols, col, column_t *, &clen );
-			ci++;
-
-			// Increment line
-			if ( p->chr == '\n' ) {
-				// Allocate one row
-				if ( !( row = malloc( sizeof( row_t ) ) ) ) {
-					const char fmt[] = "Out of memory when allocating space for new row at line %d: %s";
-					snprintf( err, errlen, fmt, line, strerror( errno ) );
-					return 0;
+		}
+		else {
+			for ( unsigned long i = 0; i < c->len; i++ ) {
+				unsigned char ch = c->v[ i ];
+				if ( ch == '\\' )
+					b->copybuf[ len++ ] = '\\', b->copybuf[ len++ ] = '\\';
+				else if ( ch == '\n' )
+					b->copybuf[ len++ ] = '\\', b->copybuf[ len++ ] = 'n';
+				else if ( ch == '\r' )
+					b->copybuf[ len++ ] = '\\', b->copybuf[ len++ ] = 'r';
+				else if ( ch == '\t' )
+					b->copybuf[ len++ ] = '\\', b->copybuf[ len++ ] = 't';
+				else {
+					b->copybuf[ len++ ] = ch;
 				}
-
-				// Add an item to said row
-				row->columns = cols;
-				add_item( &conn->rows, row, row_t *, &conn->rlen );
-				cols = NULL, clen = 0, ci = 0, line++;
 			}
 		}
-		free( p );
 	}
-#ifdef BMYSQL_H
-	else if ( conn->type == DB_MYSQL ) {
-		// Cast
-		mysql_t *b = (mysql_t *)conn->conn;
-		unsigned int rowcount = 0;
 
-		if ( !b ) {
-			const char fmt[] = "mysql() connection lost";
-			snprintf( err, errlen, fmt );
+	if ( len + 1 > b->copysize ) {
+		char *buf = NULL;
+		if ( !( buf = realloc( b->copybuf, len + 1 ) ) ) {
+			snprintf( err, errlen, "Out of memory building COPY row: %s", strerror( errno ) );
 			return 0;
 		}
+		b->copybuf = buf, b->copysize = len + 1;
+	}
 
-		// Catch this unusual situation (should probably be an error)
-		if ( !( rowcount = mysql_num_rows( b->res ) ) ) {
-			snprintf( err, errlen, "Query returned no rows." );
-			return 0;	
-		}
-
-		// Move through all of the columns
-		for ( unsigned int i = 0; i < rowcount ; i++ ) {
-			MYSQL_ROW r = mysql_fetch_row( b->res );
-			row_t *row = NULL;
-			column_t **cols = NULL;
-			unsigned long *lens = mysql_fetch_lengths( b->res );
-
-			// Move through each column
-			for ( int ci = 0, clen = 0; ci < conn->hlen; ci++ ) {
-				// Define
-				column_t *col = malloc( sizeof( column_t ) );
+	b->copybuf[ len++ ] = '\n';
+	if ( PQputCopyData( b->conn, b->copybuf, len ) != 1 ) {
+		snprintf( err, errlen, "COPY failed: %s", PQerrorMessage( b->conn ) );
+		return 0;
+	}
 
-				// Check for alloc failure
-				if ( !col || !memset( col, 0, sizeof( column_t ) ) ) {
-					const char fmt[] = "Out of memory when allocating space for entry at row %d, column %d: %s";
-					snprintf( err, errlen, fmt, i, ci, strerror( errno ) );
-					return 0;
-				}
+	return 1;
+}
+#endif
 
-				// Set the values
-				col->k = conn->headers[ ci ]->label;
-				col->v = (unsigned char *)( *r );
-				col->len = lens[ ci ];
-				// This only gets the basetype
-				col->type = conn->headers[ ci ]->type;
-#if 0
-				// If it's a date, then let's just see what's in the engine for now
-				if ( col->type == T_DATE ) {
-					date_t *d = &col->date;
-					memset( d, 0, sizeof( date_t ) );
-					unsigned char *v = col->v;
-					typemap_t *x = conn->headers[ ci ]->ntype;
 
-					if ( x->ntype == MYSQL_TYPE_YEAR ) {
-						d->year = usafecpynumeric( v, 4 );  
-					}
-					else if ( x->ntype == MYSQL_TYPE_DATE ) {
-						d->year = usafecpynumeric( v, 4 ), v += 5;
-						d->month = usafecpynumeric( v, 2 ), v += 3;
-						d->day = usafecpynumeric( v, 2 );
-					}
-					else if ( x->ntype == MYSQL_TYPE_TIME ) {
-						// Check if the hour is 3 lengths
-						d->hour = usafecpynumeric( v, 2 ), v += 3;
-						d->minute = usafecpynumeric( v, 2 ), v += 3;
-						d->second = usafecpynumeric( v, 2 );
-					}
-					else if ( x->ntype == MYSQL_TYPE_TIMESTAMP || x->ntype == MYSQL_TYPE_DATETIME ) {
-						d->year = usafecpynumeric( v, 4 ), v += 5;
-						d->month = usafecpynumeric( v, 2 ), v += 3;
-						d->day = usafecpynumeric( v, 2 ), v += 3;
-						// Check if the hour is 3 lengths
-						d->hour = usafecpynumeric( v, 2 ), v += 3;
-						d->minute = usafecpynumeric( v, 2 ), v += 3;
-						d->second = usafecpynumeric( v, 2 );
-					}
-				}
+#ifdef BMYSQL_H
+/**
+ * static int bind_mysql_value ( mysql_t *b, int ci, column_t *col, const typemap_t *ptype ) 
+ *
+ * Bind one value using the native buffer type of its output column.
+ * Numbers and dates are converted here once, so the server doesn't
+ * have to parse them.  Anything that doesn't convert goes as a string.
+ * Values land in the column's own mysql_param_t, and `b->rebind` is 
+ * set only if the buffer type or buffer moved.  Returns 0 when out of
+ * memory.
+ *
+ */
+static int bind_mysql_value ( mysql_t *b, int ci, column_t *col, const typemap_t *ptype ) {
+	MYSQL_BIND *bind = &b->bindargs[ ci ];
+	mysql_param_t *p = &b->params[ ci ];
+	mysql_value_t *val = &p->val;
+	int ntype = ( ptype ) ? ptype->ntype : MYSQL_TYPE_STRING;
+	int found = 0, truth = 0, otype = bind->buffer_type;
+	void *obuf = bind->buffer;
+
+	bind->length = &p->len;
+	bind->buffer = NULL;
+
+	// Empty values that aren't text are NULL
+	if ( !col->len && col->type != T_STRING && col->type != T_CHAR && col->type != T_BINARY )
+		bind->buffer_type = MYSQL_TYPE_NULL;
+#ifdef BPGSQL_H
+	// Values read in binary from Postgres are already decoded
+	else if ( col->typed == PG_INT2OID || col->typed == PG_INT4OID || col->typed == PG_INT8OID ) {
+		val->i = col->num.i;
+		bind->buffer_type = MYSQL_TYPE_LONGLONG;
+		bind->buffer = &val->i;
+	}
+	else if ( col->typed == PG_FLOAT4OID || col->typed == PG_FLOAT8OID ) {
+		val->d = col->num.d;
+		bind->buffer_type = MYSQL_TYPE_DOUBLE;
+		bind->buffer = &val->d;
+	}
+	else if ( col->typed == PG_BOOLOID ) {
+		val->t = (signed char)col->num.i;
+		bind->buffer_type = MYSQL_TYPE_TINY;
+		bind->buffer = &val->t;
+	}
+	else if ( col->typed == PG_UUIDOID && col->len == sizeof( val->u ) ) {
+		memcpy( val->u, col->v, sizeof( val->u ) ), p->len = sizeof( val->u );
+		bind->buffer_type = MYSQL_TYPE_BLOB;
+		bind->buffer = val->u;
+	}
+	else if ( col->typed == PG_BYTEAOID ) {
+		bind->buffer_type = MYSQL_TYPE_BLOB;
+	}
+	else if ( col->typed && ( found = ( col->typed == PG_DATEOID ) ? DATE_HAS_DATE : ( col->typed == PG_TIMEOID ) ? DATE_HAS_TIME : DATE_HAS_DATE | DATE_HAS_TIME ) )
+		;
 #endif
-				// Add to the column set
-				add_item( &cols, col, column_t *, &clen );
-				r++;
-			}
+	else if ( col->type == T_BOOLEAN && bool_from_text( col->v, col->len, &truth ) ) {
+		val->t = (signed char)truth;
+		bind->buffer_type = MYSQL_TYPE_TINY;
+		bind->buffer = &val->t;
+	}
+	else if ( ( ntype == MYSQL_TYPE_TINY || ntype == MYSQL_TYPE_SHORT || ntype == MYSQL_TYPE_LONG
+		|| ntype == MYSQL_TYPE_INT24 || ntype == MYSQL_TYPE_LONGLONG ) && int_from_text( col->v, col->len, &val->i ) ) {
+		bind->buffer_type = MYSQL_TYPE_LONGLONG;
+		bind->buffer = &val->i;
+	}
+	else if ( ( ntype == MYSQL_TYPE_FLOAT || ntype == MYSQL_TYPE_DOUBLE ) && double_from_text( col->v, col->len, &val->d ) ) {
+		bind->buffer_type = MYSQL_TYPE_DOUBLE;
+		bind->buffer = &val->d;
+	}
+	else if ( ptype && ptype->basetype == T_UUID && uuid_from_text( col->v, col->len, val->u ) ) {
+		bind->buffer_type = MYSQL_TYPE_BLOB;
+		bind->buffer = val->u;
+		p->len = sizeof( val->u );
+	}
+	else if ( ptype && ptype->basetype == T_DECIMAL && ( col->type == T_INTEGER || col->type == T_DOUBLE || col->type == T_DECIMAL ) ) {
+		// DECIMAL is sent as its digits either way, but typed so the server doesn't cast a string
+		bind->buffer_type = MYSQL_TYPE_NEWDECIMAL;
+	}
+	else if ( ( ntype == MYSQL_TYPE_DATE || ntype == MYSQL_TYPE_DATETIME || ntype == MYSQL_TYPE_TIMESTAMP
+		|| ntype == MYSQL_TYPE_TIME ) && ( found = date_from_column( col, &col->date ) ) )
+		;
+	else {
+		bind->buffer_type = ( col->type == T_BINARY ) ? MYSQL_TYPE_BLOB : MYSQL_TYPE_STRING;
+	}
 
-			// Add a new row
-			if ( !( row = malloc( sizeof( row_t ) ) ) ) {
-				const char fmt[] = "Out of memory when allocating space for row %d at cursor: %s";
-				snprintf( err, errlen, fmt, i, strerror( errno ) );
+	if ( found ) {
+		MYSQL_TIME *ts = &val->ts;
+		memset( ts, 0, sizeof( MYSQL_TIME ) );
+		ts->year = col->date.year;
+		ts->month = col->date.month;
+		ts->day = col->date.day;
+		ts->hour = col->date.hour;
+		ts->minute = col->date.minute;
+		ts->second = col->date.second;
+		ts->second_part = col->date.micro;
+
+		if ( found == DATE_HAS_DATE )
+			bind->buffer_type = MYSQL_TYPE_DATE, ts->time_type = MYSQL_TIMESTAMP_DATE;
+		else if ( found == DATE_HAS_TIME )
+			bind->buffer_type = MYSQL_TYPE_TIME, ts->time_type = MYSQL_TIMESTAMP_TIME;
+		else {
+			bind->buffer_type = MYSQL_TYPE_DATETIME, ts->time_type = MYSQL_TIMESTAMP_DATETIME;
+		}
+		bind->buffer = ts;
+	}
+	else if ( !bind->buffer && bind->buffer_type != MYSQL_TYPE_NULL ) {
+		// Row data is gone by the next row, so the bytes go into the column's own buffer
+		if ( col->len + 1 > p->size ) {
+			unsigned char *copy = NULL;
+			if ( !( copy = realloc( p->copy, ( col->len + 1 ) * 2 ) ) ) {
 				return 0;
 			}
-
-			// Add an item to said row
-			row->columns = cols;
-			add_item( &conn->rows, row, row_t *, &conn->rlen );
-			cols = NULL;
+			p->copy = copy, p->size = ( col->len + 1 ) * 2;
 		}
+		memcpy( p->copy, col->v, col->len ), p->len = col->len;
+		bind->buffer = p->copy;
+		bind->buffer_length = p->size;
 	}
+
+	b->rebind |= bind->buffer_type != otype || bind->buffer != obuf;
+	return 1;
+}
 #endif
-#ifdef BPGSQL_H
- #if 1
-	else if ( conn->type == DB_POSTGRESQL )  {
-		pgsql_t *b = (pgsql_t *)conn->conn;
-		int rcount = PQntuples( b->res );
-		for ( int i = 0; i < rcount; i++ ) {
-			row_t *row = NULL;
-			column_t **cols = NULL;
 
-			for ( int ci = 0, clen = 0; ci < conn->hlen; ci++ ) {
-				// Define
-				column_t *col = malloc( sizeof( column_t ) );
 
-				// Check for alloc failure
-				if ( !col || !memset( col, 0, sizeof( column_t ) ) ) {
-					const char fmt[] = "Out of memory when allocating space for entry at row %d, column %d: %s";
-					snprintf( err, errlen, fmt, i, ci, strerror( errno ) );
-					return 0;
-				}
+#ifdef BPGSQL_H
+/**
+ * static row_t * row_from_pgsql_copy ( dsn_t *conn, char *buf, int len, copy_t fmt, char *err, int errlen ) 
+ *
+ * Split one row of COPY output into columns.  Escapes (text) and quotes 
+ * (CSV) are undone in place, so every value points into `buf`, which
+ * the row takes ownership of.
+ *
+ */
+static row_t * row_from_pgsql_copy ( dsn_t *conn, char *buf, int len, copy_t fmt, char *err, int errlen ) {
+	row_t *row = NULL;
+	column_t **cols = NULL;
+	char *p = buf, *end = buf + len;
+	const char delim = ( fmt == COPY_CSV ) ? ',' : '\t';
+	int clen = 0;
+
+	if ( !( row = malloc( sizeof( row_t ) ) ) || !memset( row, 0, sizeof( row_t ) ) ) {
+		snprintf( err, errlen, "Out of memory when allocating space for COPY row: %s", strerror( errno ) );
+		PQfreemem( buf );
+		return NULL;
+	}
 
-				// Set the value, column name and more for the record
-				col->k = conn->headers[ ci ]->label;
-				col->len = PQgetlength( b->res, i, ci );
-				col->type = conn->headers[ ci ]->type;
-			#if 1
-				col->v = (unsigned char *)PQgetvalue( b->res, i, ci );
-			#else
-				// If the network connection cuts out, it's very possible that this data will be gone
-				//col->v = (unsigned char *)strdup( PQgetvalue( conn->res, i, ci ) );
-			#endif
+	// The row frees the buffer no matter what happens from here
+	row->data = buf, row->freedata = PQfreemem;
+	( len && end[ -1 ] == '\n' ) ? end-- : 0;
 
-#if 0
-				// If it's a date, then let's just see what's in the engine for now
-				if ( col->type == T_DATE ) {
-					date_t *d = &col->date;
-					memset( d, 0, sizeof( date_t ) );
-					unsigned char *v = col->v;
-					typemap_t *x = conn->headers[ ci ]->ntype;
+	for ( int ci = 0; ci < conn->hlen; ci++, p++ ) {
+		column_t *col = NULL;
+		char *start = p, *w = p;
+		int null = 0;
 
-//DPRINTF( "Field %-10s is a date (type %d %s)!\n", col->k, x->ntype, x->libtypename );
-//write( 2, "'", 1 ), write( 2, col->v, col->len ), write( 2, "'\n", 2 );
-					if ( x->ntype == PG_DATEOID ) {
-						d->year = usafecpynumeric( v, 4 ), v += 5;
-						d->month = usafecpynumeric( v, 2 ), v += 3;
-						d->day = usafecpynumeric( v, 2 );
-					}
-					else if ( x->ntype == PG_TIMEOID ) {
-						// Check if the hour is 3 lengths
-						d->hour = usafecpynumeric( v, 2 ), v += 3;
-						d->minute = usafecpynumeric( v, 2 ), v += 3;
-						d->second = usafecpynumeric( v, 2 );
-					}
-					else if ( x->ntype == PG_TIMESTAMPOID ) {
-						d->year = usafecpynumeric( v, 4 ), v += 5;
-						d->month = usafecpynumeric( v, 2 ), v += 3;
-						d->day = usafecpynumeric( v, 2 ), v += 3;
-						// Check if the hour is 3 lengths
-						d->hour = usafecpynumeric( v, 2 ), v += 3;
-						d->minute = usafecpynumeric( v, 2 ), v += 3;
-						d->second = usafecpynumeric( v, 2 );
+		if ( p > end ) {
+			const char efmt[] = "Column count (%d) does not match header count (%d) in COPY row %lu";
+			snprintf( err, errlen, efmt, ci, conn->hlen, conn->rtotal + conn->rlen + 1 );
+			row->columns = cols;
+			destroy_row( row );
+			return NULL;
+		}
+
+		if ( fmt == COPY_TEXT && end - p >= 2 && p[ 0 ] == '\\' && p[ 1 ] == 'N' && ( p + 2 == end || p[ 2 ] == delim ) ) {
+			null = 1, p += 2;
+		}
+		else if ( fmt == COPY_TEXT ) {
+			for ( ; p < end && *p != delim; p++ ) {
+				const char *esc = NULL;
+				if ( *p != '\\' || p + 1 >= end ) {
+					*w++ = *p;
+					continue;
+				}
+
+				// Backslash sequences, octal and hex included
+				if ( ( esc = memchr( "b\bf\fn\nr\rt\tv\v", *++p, 12 ) ) && ( ( esc - "b\bf\fn\nr\rt\tv\v" ) % 2 ) == 0 )
+					*w++ = esc[ 1 ];
+				else if ( *p >= '0' && *p <= '7' ) {
+					int v = 0;
+					for ( int i = 0; i < 3 && p < end && *p >= '0' && *p <= '7'; i++, p++ ) v = ( v * 8 ) + ( *p - '0' );
+					*w++ = (char)v, p--;
+				}
+				else if ( *p == 'x' && p + 1 < end && isxdigit( (unsigned char)p[ 1 ] ) ) {
+					int v = 0;
+					for ( int i = 0; i < 2 && p + 1 < end && isxdigit( (unsigned char)p[ 1 ] ); i++, p++ ) {
+						v = ( v * 16 ) + ( ( p[ 1 ] <= '9' ) ? p[ 1 ] - '0' : ( p[ 1 ] | 0x20 ) - 'a' + 10 );
 					}
+					*w++ = (char)v;
+				}
+				else {
+					*w++ = *p;
 				}
-#endif
-				// Add it
-				add_item( &cols, col, column_t *, &clen );
 			}
-
-			// Add a new row
-			if ( !( row = malloc( sizeof( row_t ) ) ) ) {
-				const char fmt[] = "Out of memory when allocating space for row %d at cursor: %s";
-				snprintf( err, errlen, fmt, i, strerror( errno ) );
-				return 0;
+		}
+		else if ( p < end && *p == '"' ) {
+			// Quoted CSV values, where "" is a literal quote
+			for ( p++; p < end; p++ ) {
+				if ( *p == '"' && p + 1 < end && p[ 1 ] == '"' )
+					*w++ = '"', p++;
+				else if ( *p == '"' ) {
+					p++;
+					break;
+				}
+				else {
+					*w++ = *p;
+				}
 			}
+		}
+		else {
+			// Unquoted empty CSV values are NULL
+			for ( ; p < end && *p != delim; p++ ) *w++ = *p;
+			null = ( w == start );
+		}
 
-			// Add an item to said row
+		if ( !( col = malloc( sizeof( column_t ) ) ) || !memset( col, 0, sizeof( column_t ) ) ) {
+			snprintf( err, errlen, "Out of memory when allocating space for COPY value: %s", strerror( errno ) );
 			row->columns = cols;
+			destroy_row( row );
+			return NULL;
+		}
 
-			// And add this row to rows
-			add_item( &conn->rows, row, row_t *, &conn->rlen );
+		col->k = conn->headers[ ci ]->label;
+		col->type = conn->headers[ ci ]->type;
+		col->v = ( null ) ? NULL : (unsigned char *)start;
+		col->len = ( null ) ? 0 : w - start;
+		add_item( &cols, col, column_t *, &clen );
+	}
 
-			// Reset everything
-			cols = NULL;
+	// Anything left after the last column is one or more columns too many
+	if ( p <= end ) {
+		const char efmt[] = "Column count (%d) does not match header count (%d) in COPY row %lu";
+		int count = conn->hlen + 1;
+		for ( int quoted = 0; p < end; p++ ) {
+			quoted ^= ( fmt == COPY_CSV && *p == '"' );
+			count += ( !quoted && *p == delim );
+		}
+		snprintf( err, errlen, efmt, count, conn->hlen, conn->rtotal + conn->rlen + 1 );
+		row->columns = cols;
+		destroy_row( row );
+		return NULL;
+	}
+
+	row->columns = cols;
+	return row;
+}
+
+
+/**
+ * static int fetch_pgsql_batch ( dsn_t *conn, int count, char *err, int errlen ) 
+ *
+ * Replace the current Postgres input result with the next batch of 
+ * rows.  db->res is left NULL once there are no more.
+ *
+ */
+static int fetch_pgsql_batch ( dsn_t *conn, int count, char *err, int errlen ) {
+	pgsql_t *db = (pgsql_t *)conn->conn;
+	ExecStatusType status;
+
+	PQclear( db->res ), db->res = NULL, db->consumed = 0;
+
+	if ( db->cursor ) {
+		char query[ 64 ] = { 0 };
+		snprintf( query, sizeof( query ), "FETCH %d FROM " PG_CURSOR, count );
+		db->res = PQexecParams( db->conn, query, 0, NULL, NULL, NULL, NULL, db->binary );
+		if ( ( status = PQresultStatus( db->res ) ) != PGRES_TUPLES_OK ) {
+			snprintf( err, errlen, "Failed to fetch rows: %s", PQerrorMessage( db->conn ) );
+			return 0;
+		}
+	}
+#ifdef LIBPQ_HAS_CHUNK_MODE
+	else if ( db->chunked ) {
+		// The end of the set is a zero-row PGRES_TUPLES_OK, followed by NULL
+		if ( ( db->res = PQgetResult( db->conn ) ) ) {
+			if ( ( status = PQresultStatus( db->res ) ) == PGRES_TUPLES_OK ) {
+				PGresult *end = NULL;
+				while ( ( end = PQgetResult( db->conn ) ) ) PQclear( end );
+				db->chunked = 0;
+			}
+			else if ( status != PGRES_TUPLES_CHUNK ) {
+				snprintf( err, errlen, "Failed to fetch rows: %s", PQresultErrorMessage( db->res ) );
+				return 0;
+			}
 		}
 	}
-#endif
 #endif
 
 	return 1;
 }
 
 
+/**
+ * static void value_from_pgsql_binary ( column_t *col, int oid ) 
+ *
+ * Decode a value Postgres sent in binary into the column's typed 
+ * storage.  col->v keeps pointing at the raw bytes, so outputs that
+ * take the same type can hand them back untouched.  Text is the same
+ * in either format and is left alone.
+ *
+ */
+static void value_from_pgsql_binary ( column_t *col, int oid ) {
+	const unsigned char *v = col->v;
+	long long us = 0, days = 0;
+
+	if ( oid == PG_INT2OID && col->len == 2 )
+		col->num.i = (short)get_be( v, 2 );
+	else if ( oid == PG_INT4OID && col->len == 4 )
+		col->num.i = (int)get_be( v, 4 );
+	else if ( oid == PG_INT8OID && col->len == 8 )
+		col->num.i = (long long)get_be( v, 8 );
+	else if ( oid == PG_BOOLOID && col->len == 1 )
+		col->num.i = ( *v != 0 );
+	else if ( oid == PG_FLOAT8OID && col->len == 8 ) {
+		unsigned long long bits = get_be( v, 8 );
+		memcpy( &col->num.d, &bits, sizeof( double ) );
+	}
+	else if ( oid == PG_FLOAT4OID && col->len == 4 ) {
+		unsigned int bits = get_be( v, 4 );
+		float f = 0;
+		memcpy( &f, &bits, sizeof( float ) );
+		col->num.d = f;
+	}
+	else if ( oid == PG_DATEOID && col->len == 4 ) {
+		int d = (int)get_be( v, 4 );
+		if ( d == INT_MAX || d == INT_MIN ) {
+			col->v = (unsigned char *)( ( d == INT_MAX ) ? "infinity" : "-infinity" );
+			col->len = strlen( (char *)col->v );
+			return;
+		}
+		date_from_days( d + PG_EPOCH_DAYS, &col->date );
+	}
+	else if ( ( oid == PG_TIMEOID || oid == PG_TIMESTAMPOID ) && col->len == 8 ) {
+		us = (long long)get_be( v, 8 );
+		if ( oid == PG_TIMESTAMPOID && ( us == LLONG_MAX || us == LLONG_MIN ) ) {
+			col->v = (unsigned char *)( ( us == LLONG_MAX ) ? "infinity" : "-infinity" );
+			col->len = strlen( (char *)col->v );
+			return;
+		}
+		days = us / 86400000000LL, us %= 86400000000LL;
+		if ( us < 0 ) {
+			us += 86400000000LL, days--;
+		}
+		if ( oid == PG_TIMESTAMPOID ) {
+			date_from_days( days + PG_EPOCH_DAYS, &col->date );
+		}
+		col->date.micro = us % 1000000, us /= 1000000;
+		col->date.second = us % 60, us /= 60;
+		col->date.minute = us % 60;
+		col->date.hour = us / 60;
+	}
+	else if ( oid == PG_UUIDOID && col->len != 16 )
+		return;
+	else if ( oid != PG_NUMERICOID && oid != PG_BYTEAOID && oid != PG_UUIDOID ) {
+		return;
+	}
+
+	col->typed = oid;
+}
+
 
 /**
- * transform_from_dsn( dsn_t * )
+ * static int text_from_pgsql_binary ( column_t *col, char *out ) 
  *
- * "Transform" the records into whatever output format you're looking for.
+ * Write the text Postgres would have sent for a value decoded by
+ * value_from_pgsql_binary().  `out` needs pgsql_text_size() bytes.
+ * Returns the length written.
  *
  */
-int transform_from_dsn(
-	dsn_t *iconn,
-	dsn_t *oconn,
-	int count,
-	int offset,
-	char *err,
-	int errlen
-) {
+static int text_from_pgsql_binary ( column_t *col, char *out ) {
+	date_t *d = &col->date;
+	int n = 0;
+
+	if ( col->typed == PG_INT2OID || col->typed == PG_INT4OID || col->typed == PG_INT8OID )
+		return sprintf( out, "%lld", col->num.i );
+	else if ( col->typed == PG_BOOLOID )
+		return sprintf( out, "%c", col->num.i ? 't' : 'f' );
+	else if ( col->typed == PG_NUMERICOID )
+		return numeric_from_pg( col->v, col->len, out );
+	else if ( col->typed == PG_UUIDOID )
+		return uuid_to_text( col->v, out );
+	else if ( col->typed == PG_BYTEAOID ) {
+		n = sprintf( out, "\\x" );
+		for ( unsigned long i = 0; i < col->len; i++ ) {
+			n += sprintf( &out[ n ], "%02x", col->v[ i ] );
+		}
+		return n;
+	}
+	else if ( col->typed == PG_FLOAT4OID || col->typed == PG_FLOAT8OID ) {
+		double v = col->num.d;
+		if ( v != v ) 
+			return sprintf( out, "NaN" );
+		else if ( v - v != 0 ) {
+			return sprintf( out, "%sInfinity", ( v < 0 ) ? "-" : "" );
+		}
 
-	// Define
-	WHERE();
-	char insfmt[ 256 ];
-	memset( insfmt, 0, sizeof( insfmt ) );
+		// Use the shortest form that reads back as the same value
+		for ( int prec = ( col->typed == PG_FLOAT4OID ) ? 6 : 15, max = prec + 3; prec <= max; prec++ ) {
+			n = sprintf( out, "%.*g", prec, v );
+			if ( col->typed == PG_FLOAT4OID && (float)strtod( out, NULL ) == (float)v ) 
+				break;
+			else if ( col->typed == PG_FLOAT8OID && strtod( out, NULL ) == v ) {
+				break;
+			}
+		}
+		return n;
+	}
 
-	// Define any db specific stuff
-	int ri = 0;
+	if ( col->typed == PG_DATEOID || col->typed == PG_TIMESTAMPOID ) {
+		n = sprintf( out, "%04d-%02d-%02d%s", d->year, d->month, d->day, ( col->typed == PG_TIMESTAMPOID ) ? " " : "" );
+	}
 
-	// Loop through all rows
-	for ( row_t **row = iconn->rows; row && *row; row++, ri++ ) {
-		char ffmt[ MAX_STMT_SIZE ];
-		int first = *row == *iconn->rows;
-		int ci = 0;
+	if ( col->typed == PG_TIMEOID || col->typed == PG_TIMESTAMPOID ) {
+		n += sprintf( &out[ n ], "%02d:%02d:%02d", d->hour, d->minute, d->second );
+		if ( d->micro ) {
+			n += sprintf( &out[ n ], ".%06u", d->micro );
+			for ( ; out[ n - 1 ] == '0'; n-- );
+			out[ n ] = '\0';
+		}
+	}
 
-		// memset
-		memset( ffmt, 0, MAX_STMT_SIZE );
+	return n;
+}
 
-		//Prefix
-		if ( oconn->type == DB_FILE ) {
-			file_t *file = (file_t *)oconn->conn;
-			( FF.prefix ) ? FDPRINTF( file->fd, FF.prefix ) : 0;
 
-			if ( oconn->stream == STREAM_PRINTF || oconn->stream == STREAM_COMMA ) 
-				;
-			else if ( oconn->stream == STREAM_CSTRUCT )
-				FDPRINTF( file->fd, &",{"[!( offset || !first )] );
-			else if ( oconn->stream == STREAM_CARRAY )
-				FDPRINTF( file->fd, &",{"[!( offset || !first )] );
-			else if ( oconn->stream == STREAM_JSON ) {
-				FDPRINTF( file->fd, &",{"[!( offset || !first )] );
-				( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
-			}
-			else if ( oconn->stream == STREAM_XML ) {
-				FF.pretty ? FDPRINTF( file->fd, "\t" ) : 0;
-				FDPRINTF( file->fd, "<" );
-				// TODO: Should this be auto-inferred?
-				FDPRINTF( file->fd, oconn->tablename );
-				FDPRINTF( file->fd, ">" );
-				( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
-				//( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
-			}
-			else if ( oconn->stream == STREAM_SQL ) {
-			#if 0
-				// Way faster to use what you've already written..., but you can't use the whole thing...
-				// You can prepare it if stream_SQL is chosen...
-			#else
-				FDPRINTF( file->fd, "INSERT INTO " );
-				FDPRINTF( file->fd, oconn->tablename );
-				FDPRINTF( file->fd, " (" );
-				for ( header_t **x = iconn->headers; x && *x; x++ ) {
-					( *iconn->headers != *x ) ? FDPRINTF( file->fd, "," ) : 0;
-					FDPRINTF( file->fd, (*x)->label );
-				}
-				FDPRINTF( file->fd, ") VALUES (" );
-			}
-			#endif
+/**
+ * static int pgsql_text_size ( column_t *col ) 
+ *
+ * How much space text_from_pgsql_binary() needs for a value.
+ *
+ */
+static int pgsql_text_size ( column_t *col ) {
+	if ( col->typed == PG_NUMERICOID )
+		return numeric_text_size( col->v, col->len );
+	else if ( col->typed == PG_BYTEAOID ) {
+		return 4 + ( col->len * 2 );
+	}
+	return 48;
+}
+
+
+/**
+ * typedef keep_binary_t 
+ *
+ * Says whether column ci of an output can bind a binary value as is.
+ *
+ */
+typedef int (*keep_binary_t)( column_t *col, header_t *h, dsn_t *oconn, int ci );
+
+
+/**
+ * static int text_from_pgsql_row ( row_t *row, header_t **headers, dsn_t *oconn, keep_binary_t keep, char *err, int errlen ) 
+ *
+ * Turn the binary values of a row back into text for outputs that 
+ * can't use them.  Columns that `keep` says `oconn` can take as they
+ * are stay binary; a NULL `keep` converts everything.  The text is
+ * owned by the row.
+ *
+ */
+static int text_from_pgsql_row ( row_t *row, header_t **headers, dsn_t *oconn, keep_binary_t keep, char *err, int errlen ) {
+	char *text = NULL;
+	int need = 0, n = 0;
+
+	int ci = 0;
+	for ( column_t **c = row->columns; c && *c; c++, ci++ ) {
+		if ( (*c)->typed && !( keep && keep( *c, headers[ ci ], oconn, ci ) ) ) {
+			need += pgsql_text_size( *c );
 		}
+	}
 
-		// Loop through each column
-		for ( column_t **col = (*row)->columns; col && *col; col++, ci++ ) {
-			int first = *col == *((*row)->columns);
-			if ( oconn->stream == STREAM_PRINTF ) {
-				file_t *file = (file_t *)oconn->conn;
-				FDPRINTF( file->fd, (*col)->k );
-				FDPRINTF( file->fd, " => " );
-				if ( (*col)->type == T_BOOLEAN && memchr( "Tt1", *(*col)->v, 3 ) )
-					FDPRINTF( file->fd, "true" );
-				else if ( (*col)->type == T_BOOLEAN && memchr( "Ff0", *(*col)->v, 3 ) )
-					FDPRINTF( file->fd, "false" );
-				else if ( (*col)->type == T_BINARY ) {
-					char bin[ 64 ];
-					memset( &bin, 0, sizeof( bin ) );
-					snprintf( bin, sizeof( bin ) - 1, "%p (%ld bytes)", (void *)(*col)->v, (*col)->len );
-					FDPRINTF( file->fd, bin );
-				}
-				else if ( (*col)->type == T_STRING || (*col)->type == T_CHAR ) {
-					FDPRINTF( file->fd, FF.leftdelim );
-					FDNPRINTF( file->fd, (*col)->v, (*col)->len );
-					FDPRINTF( file->fd, FF.rightdelim );
-				}
-			#if 0
-				else if ( (*col)->type == T_DATE ) {
-					// Try a custom date format?
-				}
-			#endif
-				else {
-					FDNPRINTF( file->fd, (*col)->v, (*col)->len );
-				}
-				FDPRINTF( file->fd, "\n" );
-			}
-			else if ( oconn->stream == STREAM_RAW ) {
-				file_t *file = (file_t *)oconn->conn;
-				( first ) ? 0 : FDPRINTF( file->fd, oconn->cold );
-				FDNPRINTF( file->fd, (*col)->v, (*col)->len );
+	if ( !need ) {
+		return 1;
+	}
+
+	// A row is only ever converted once, so nothing is there yet
+	if ( row->data || !( text = malloc( need ) ) ) {
+		const char fmt[] = "Out of memory when converting binary values to text: %s";
+		snprintf( err, errlen, fmt, strerror( errno ) );
+		return 0;
+	}
+
+	row->data = text;
+	ci = 0;
+	for ( column_t **c = row->columns; c && *c; c++, ci++ ) {
+		column_t *col = *c;
+		if ( !col->typed || ( keep && keep( col, headers[ ci ], oconn, ci ) ) ) {
+			continue;
+		}
+
+		if ( ( n = text_from_pgsql_binary( col, text ) ) < 0 ) {
+			const char fmt[] = "Malformed binary value in column '%s'";
+			snprintf( err, errlen, fmt, col->k );
+			return 0;
+		}
+		col->v = (unsigned char *)text, col->len = n, col->typed = 0;
+		text += n + 1;
+	}
+
+	return 1;
+}
+
+
+/**
+ * static int pgsql_keeps_binary ( column_t *col, header_t *h, dsn_t *oconn, int ci ) 
+ *
+ * Postgres outputs can bind a binary value as is if it's the type of
+ * the column it goes into, which bind_pgsql_value() checks the same way.
+ *
+ */
+static int pgsql_keeps_binary ( column_t *col, header_t *h, dsn_t *oconn, int ci ) {
+	pgsql_t *t = (pgsql_t *)oconn->conn;
+	return t->targets && col->typed == (int)t->targets[ ci ];
+}
+
+
+#ifdef BMYSQL_H
+/**
+ * static int mysql_keeps_binary ( column_t *col, header_t *h, dsn_t *oconn, int ci ) 
+ *
+ * MySQL outputs can bind everything but NUMERIC natively, and UUIDs 
+ * only if they are going into a BINARY(16).
+ *
+ */
+static int mysql_keeps_binary ( column_t *col, header_t *h, dsn_t *oconn, int ci ) {
+	if ( col->typed == PG_UUIDOID ) {
+		return h->ptype && h->ptype->basetype == T_UUID;
+	}
+	return col->typed != PG_NUMERICOID;
+}
+#endif
+
+
+/**
+ * static int bind_pgsql_value ( pgsql_t *b, int ci, column_t *col, const typemap_t *ptype, unsigned char *buf ) 
+ *
+ * Bind one value in Postgres' binary format, converting it once here 
+ * instead of having the server parse text.  The type comes from the
+ * target column when prepare_dsn_for_write() could describe it, so a
+ * double going into a double precision column is never narrowed to
+ * the real that inference prefers.  Without one, doubles go as
+ * float8 and the server casts.  Anything that doesn't convert cleanly
+ * is sent as untyped text so the server can decide.  Scratch space 
+ * comes from `buf`, and the number of bytes used there is returned.
+ *
+ */
+static int bind_pgsql_value ( pgsql_t *b, int ci, column_t *col, const typemap_t *ptype, unsigned char *buf ) {
+	int oid = ( b->targets ) ? (int)b->targets[ ci ] : ( ptype && ptype->ntype == PG_FLOAT4OID ) ? PG_FLOAT8OID : ( ptype ) ? ptype->ntype : 0;
+	long long n = 0;
+	double dbl = 0;
+	int truth = 0;
+	date_t date;
+
+	b->bindfmts[ ci ] = 1;
+	b->bindargs[ ci ] = (char *)buf;
+
+	// Binary values read from a column of the same type go back as they came
+	if ( col->typed && col->typed == oid ) {
+		b->bindargs[ ci ] = (char *)col->v;
+		b->bindlens[ ci ] = col->len;
+		return 0;
+	}
+
+	// Text and raw bytes already are their binary representation, raw bytes going to text stay text
+	if ( ( col->type == T_BINARY && oid == PG_BYTEAOID ) || oid == PG_TEXTOID || oid == PG_VARCHAROID || oid == PG_BPCHAROID ) {
+		b->bindargs[ ci ] = ( col->v ) ? (char *)col->v : (char *)buf;
+		b->bindlens[ ci ] = col->len;
+		return 0;
+	}
+
+	if ( oid == PG_INT2OID && int_from_text( col->v, col->len, &n ) && n >= SHRT_MIN && n <= SHRT_MAX )
+		return put_be( buf, n, 2 ), ( b->bindlens[ ci ] = 2 );
+	else if ( oid == PG_INT4OID && int_from_text( col->v, col->len, &n ) && n >= INT_MIN && n <= INT_MAX )
+		return put_be( buf, n, 4 ), ( b->bindlens[ ci ] = 4 );
+	else if ( oid == PG_INT8OID && int_from_text( col->v, col->len, &n ) )
+		return put_be( buf, n, 8 ), ( b->bindlens[ ci ] = 8 );
+	else if ( oid == PG_FLOAT8OID && double_from_text( col->v, col->len, &dbl ) ) {
+		unsigned long long bits = 0;
+		memcpy( &bits, &dbl, sizeof( double ) );
+		return put_be( buf, bits, 8 ), ( b->bindlens[ ci ] = 8 );
+	}
+	else if ( oid == PG_FLOAT4OID && double_from_text( col->v, col->len, &dbl ) ) {
+		float f = (float)dbl;
+		unsigned int bits = 0;
+		memcpy( &bits, &f, sizeof( float ) );
+		return put_be( buf, bits, 4 ), ( b->bindlens[ ci ] = 4 );
+	}
+	else if ( oid == PG_BOOLOID && bool_from_text( col->v, col->len, &truth ) ) {
+		*buf = truth;
+		return ( b->bindlens[ ci ] = 1 );
+	}
+	else if ( oid == PG_NUMERICOID && ( b->bindlens[ ci ] = numeric_to_pg( col->v, col->len, buf ) ) )
+		return b->bindlens[ ci ];
+	else if ( oid == PG_UUIDOID && uuid_from_text( col->v, col->len, buf ) ) {
+		return ( b->bindlens[ ci ] = 16 );
+	}
+	else if ( oid == PG_DATEOID && date_from_column( col, &date ) == DATE_HAS_DATE ) {
+		long days = days_from_civil( date.year, date.month, date.day ) - PG_EPOCH_DAYS;
+		return put_be( buf, days, 4 ), ( b->bindlens[ ci ] = 4 );
+	}
+	else if ( oid == PG_TIMEOID && date_from_column( col, &date ) == DATE_HAS_TIME ) {
+		long long us = ( ( date.hour * 3600LL ) + ( date.minute * 60 ) + date.second ) * 1000000LL + date.micro;
+		return put_be( buf, us, 8 ), ( b->bindlens[ ci ] = 8 );
+	}
+	else if ( oid == PG_TIMESTAMPOID && ( date_from_column( col, &date ) & DATE_HAS_DATE ) ) {
+		long long days = days_from_civil( date.year, date.month, date.day ) - PG_EPOCH_DAYS;
+		long long us = ( ( days * 86400LL ) + ( date.hour * 3600LL ) + ( date.minute * 60 ) + date.second ) * 1000000LL + date.micro;
+		return put_be( buf, us, 8 ), ( b->bindlens[ ci ] = 8 );
+	}
+
+	// Everything else goes as NUL terminated text
+	memcpy( buf, col->v, col->len ), buf[ col->len ] = '\0';
+	b->bindfmts[ ci ] = 0;
+	b->bindlens[ ci ] = col->len;
+	return col->len + 1;
+}
+#endif
+
+
+#ifdef BSQLITE_H
+/**
+ * static type_t type_from_sqlite ( sqlite3_stmt *stmt, int i, int row ) 
+ *
+ * Get the base type of an SQLite3 column from its declared type, the 
+ * same way SQLite picks an affinity.  Expressions have no declared 
+ * type, so the value in the current row (if there is one) decides.
+ *
+ */
+static type_t type_from_sqlite ( sqlite3_stmt *stmt, int i, int row ) {
+	const char *decl = sqlite3_column_decltype( stmt, i );
+	char d[ 64 ] = { 0 };
+
+	if ( !decl ) {
+		int t = ( row ) ? sqlite3_column_type( stmt, i ) : SQLITE_NULL;
+		if ( t == SQLITE_INTEGER )
+			return T_INTEGER;
+		else if ( t == SQLITE_FLOAT )
+			return T_DOUBLE;
+		else if ( t == SQLITE_BLOB ) {
+			return T_BINARY;
+		}
+		return T_STRING;
+	}
+
+	for ( int n = 0; decl[ n ] && n < sizeof( d ) - 1; n++ ) {
+		d[ n ] = toupper( decl[ n ] );
+	}
+
+	// These aren't affinities, but they are common enough to keep
+	if ( strstr( d, "BOOL" ) )
+		return T_BOOLEAN;
+	else if ( strstr( d, "DATE" ) || strstr( d, "TIME" ) )
+		return T_DATE;
+	else if ( strstr( d, "INT" ) )
+		return T_INTEGER;
+	else if ( strstr( d, "CHAR" ) || strstr( d, "CLOB" ) || strstr( d, "TEXT" ) )
+		return T_STRING;
+	else if ( strstr( d, "UUID" ) )
+		return T_UUID;
+	else if ( strstr( d, "DEC" ) || strstr( d, "NUMERIC" ) )
+		return T_DECIMAL;
+	else if ( !*d || strstr( d, "BLOB" ) ) {
+		return T_BINARY;
+	}
+
+	// REAL, FLOAT and DOUBLE all land here
+	return T_DOUBLE;
+}
+
+
+/**
+ * static int bind_sqlite_value ( sqlite3_stmt *stmt, int i, column_t *col ) 
+ *
+ * Bind one value to the prepared SQLite3 INSERT.  Values are bound in 
+ * place, since the row outlives the step.  Integers and booleans are 
+ * bound as numbers so SQLite doesn't have to convert the text.
+ *
+ */
+static int bind_sqlite_value ( sqlite3_stmt *stmt, int i, column_t *col ) {
+	const unsigned char *v = col->v, *end = col->v + col->len;
+	int truth = 0;
+
+	// Same rule as Postgres, an empty value is NULL unless it's text
+	if ( !col->len && col->type != T_STRING && col->type != T_BINARY && col->type != T_CHAR ) {
+		return sqlite3_bind_null( stmt, i );
+	}
+
+	if ( col->type == T_BINARY ) {
+		return sqlite3_bind_blob( stmt, i, v, col->len, SQLITE_STATIC );
+	}
+
+	if ( col->type == T_BOOLEAN && bool_from_text( v, col->len, &truth ) ) {
+		return sqlite3_bind_int( stmt, i, truth );
+	}
+
+	// Anything that won't fit (or isn't only digits) goes as text
+	if ( col->type == T_INTEGER && col->len < 19 ) {
+		int neg = ( *v == '-' ), sign = ( *v == '-' || *v == '+' );
+		long long n = 0;
+
+		for ( v += sign; v < end && *v >= '0' && *v <= '9'; v++ ) {
+			n = n * 10 + ( *v - '0' );
+		}
+
+		if ( v == end && col->len > sign ) {
+			return sqlite3_bind_int64( stmt, i, ( neg ) ? -n : n );
+		}
+	}
+
+	return sqlite3_bind_text( stmt, i, (const char *)col->v, col->len, SQLITE_STATIC );
+}
+#endif
+
+
+/**
+ * static void select_for_dsn ( dsn_t *conn, config_t *conf, char *query, int len ) 
+ *
+ * Write the query that reads a database input into query.  --limit 
+ * and --offset go into the query, so the server never sends rows 
+ * that would be thrown away.
+ *
+ */
+static void select_for_dsn ( dsn_t *conn, config_t *conf, char *query, int len ) {
+	char limit[ 64 ] = { 0 };
+	int qlen = ( conf->wquery ) ? strlen( conf->wquery ) : 0;
+
+	if ( !conf->wlimit && !conf->woffset ) {
+		if ( conf->wquery )
+			snprintf( query, len - 1, "%s", conf->wquery );
+		else {
+			snprintf( query, len - 1, "SELECT * FROM %s", conn->tablename );
+		}
+		return;
+	}
+
+	// MySQL has no OFFSET without a LIMIT, and no LIMIT ALL either
+	if ( conn->type == DB_MYSQL )
+		snprintf( limit, sizeof( limit ), " LIMIT %lu, %lu", conf->woffset, ( conf->wlimit ) ? conf->wlimit : ULONG_MAX );
+	else if ( conf->wlimit )
+		snprintf( limit, sizeof( limit ), " LIMIT %lu OFFSET %lu", conf->wlimit, conf->woffset );
+	else {
+		snprintf( limit, sizeof( limit ), " LIMIT %s OFFSET %lu", ( conn->type == DB_SQLITE ) ? "-1" : "ALL", conf->woffset );
+	}
+
+	// A trailing ';' can't go inside the subquery
+	while ( qlen && ( conf->wquery[ qlen - 1 ] == ';' || isspace( conf->wquery[ qlen - 1 ] ) ) ) {
+		qlen--;
+	}
+
+	if ( conf->wquery )
+		snprintf( query, len - 1, "SELECT * FROM ( %.*s ) briggs_limit%s", qlen, conf->wquery, limit );
+	else {
+		snprintf( query, len - 1, "SELECT * FROM %s%s", conn->tablename, limit );
+	}
+}
+
+
+#ifdef BPGSQL_H
+/**
+ * static int start_pgsql_read ( dsn_t *conn, config_t *conf, const char *query, char *err, int errlen ) 
+ *
+ * Start reading the rows of query from an open Postgres input, with
+ * COPY, in chunks or from a cursor.  db->res is left with the column
+ * info that headers_from_dsn() and types_from_dsn() need.
+ *
+ */
+static int start_pgsql_read ( dsn_t *conn, config_t *conf, const char *query, char *err, int errlen ) {
+	pgsql_t *db = (pgsql_t *)conn->conn;
+	char cq[ 2048 + 64 ] = { 0 };
+
+	// Anything a describe left behind goes
+	PQclear( db->res ), db->res = NULL;
+
+	// COPY is cheaper on the server, but types still come from a normal describe
+	if ( conf->wcopy ) {
+		snprintf( cq, sizeof( cq ), "SELECT * FROM ( %s ) briggs_describe LIMIT 0", query );
+		if ( PQresultStatus( ( db->res = PQexec( db->conn, cq ) ) ) != PGRES_TUPLES_OK ) {
+			const char fmt[] = "Failed to describe query: '%s'";
+			snprintf( err, errlen, fmt, PQerrorMessage( db->conn ) );
+			return 0;
+		}
+
+		snprintf( cq, sizeof( cq ), "COPY ( %s ) TO STDOUT%s", query, ( conf->wcopy == COPY_CSV ) ? " WITH ( FORMAT csv )" : "" );
+		PGresult *res = PQexec( db->conn, cq );
+		if ( PQresultStatus( res ) != PGRES_COPY_OUT ) {
+			const char fmt[] = "Failed to start COPY: '%s'";
+			snprintf( err, errlen, fmt, PQerrorMessage( db->conn ) );
+			PQclear( res );
+			return 0;
+		}
+
+		PQclear( res );
+		db->copyout = conf->wcopy;
+		return 1;
+	}
+
+	db->binary = conf->wbinary;
+#ifdef LIBPQ_HAS_CHUNK_MODE
+	// Have the rows come back a batch at a time as they arrive
+	if ( !PQsendQueryParams( db->conn, query, 0, NULL, NULL, NULL, NULL, db->binary ) || !PQsetChunkedRowsMode( db->conn, BATCH_SIZE ) ) {
+		const char fmt[] = "Failed to run query against selected db and table: '%s'";
+		snprintf( err, errlen, fmt, PQerrorMessage( db->conn ) );
+		return 0;
+	}
+	db->chunked = 1;
+#else
+	// Without chunked rows, a cursor keeps the result on the server instead
+	snprintf( cq, sizeof( cq ), "DECLARE " PG_CURSOR " NO SCROLL CURSOR FOR %s", query );
+	if ( !query_dsn( conn, "BEGIN", NULL, 0, err, errlen ) || !query_dsn( conn, cq, NULL, 0, err, errlen ) ) {
+		const char fmt[] = "Failed to run query against selected db and table: '%s'";
+		snprintf( err, errlen, fmt, PQerrorMessage( db->conn ) );
+		return 0;
+	}
+	db->cursor = 1;
+#endif
+
+	// The first batch carries the column info that headers_from_dsn() needs
+	return fetch_pgsql_batch( conn, BATCH_SIZE, err, errlen );
+}
+
+
+/**
+ * int check_pipe ( config_t *conf, dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) 
+ *
+ * COPY BINARY data only loads into columns of the exact same types.
+ * If the output table doesn't match, drop the pipe and start reading 
+ * the input the normal way.
+ *
+ */
+int check_pipe ( config_t *conf, dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) {
+	pgsql_t *idb = (pgsql_t *)iconn->conn;
+	pgsql_t *odb = (pgsql_t *)oconn->conn;
+	char stmt[ MAX_STMT_SIZE ] = { 0 };
+	char query[ 2048 ] = { 0 };
+	PGresult *res = NULL;
+	int match = 0;
+	int p = snprintf( stmt, sizeof( stmt ), "SELECT " );
+
+	for ( header_t **h = iconn->headers; h && *h && p < sizeof( stmt ); h++ ) {
+		p += snprintf( &stmt[ p ], sizeof( stmt ) - p, &",%s"[ *iconn->headers == *h ], (*h)->label );
+	}
+
+	if ( p < sizeof( stmt ) ) {
+		p += snprintf( &stmt[ p ], sizeof( stmt ) - p, " FROM %s LIMIT 0", oconn->tablename );
+	}
+
+	// A column we can't even select can't be piped into either
+	if ( p < sizeof( stmt ) && PQresultStatus( ( res = PQexec( odb->conn, stmt ) ) ) == PGRES_TUPLES_OK ) {
+		match = PQnfields( res ) == PQnfields( idb->res );
+		for ( int i = 0; match && i < PQnfields( res ); i++ ) {
+			match = PQftype( res, i ) == PQftype( idb->res, i );
+		}
+	}
+	PQclear( res );
+
+	if ( match ) {
+		return 1;
+	}
+
+	WPRINTF( "Column types of '%s' differ from the input, not piping COPY data", oconn->tablename );
+	iconn->pipe = oconn->pipe = 0;
+	select_for_dsn( iconn, conf, query, sizeof( query ) );
+	return start_pgsql_read( iconn, conf, query, err, errlen );
+}
+
+
+/**
+ * static void * read_pipe ( void *arg ) 
+ *
+ * Thread reading COPY data for --pipeline.  Rows are gathered into 
+ * chunks of about PIPE_CHUNK bytes before they are handed over.
+ *
+ */
+static void * read_pipe ( void *arg ) {
+	pipe_t *p = (pipe_t *)arg;
+	PGresult *res = NULL;
+	char *data = NULL, *buf = NULL;
+	int len = 0, size = 0, status = 1, n = 0;
+
+	for ( ;; ) {
+		// Hand over a full chunk, or whatever is left at the end
+		if ( ( n = PQgetCopyData( (PGconn *)p->conn, &buf, 0 ) ) < 0 || len + n > PIPE_CHUNK ) {
+			pthread_mutex_lock( &p->lock );
+			while ( len && !p->stop && p->count == PARALLEL_DEPTH ) {
+				pthread_cond_wait( &p->changed, &p->lock );
+			}
+			if ( p->stop ) {
+				pthread_mutex_unlock( &p->lock );
+				if ( n > 0 ) {
+					PQfreemem( buf );
+				}
+				break;
+			}
+			if ( len ) {
+				int tail = ( p->head + p->count ) % PARALLEL_DEPTH;
+				p->chunks[ tail ].data = data, p->chunks[ tail ].len = len;
+				p->count++, data = NULL, len = size = 0;
+				pthread_cond_broadcast( &p->changed );
+			}
+			pthread_mutex_unlock( &p->lock );
+		}
+
+		if ( n < 0 ) {
+			break;
+		}
+
+		if ( len + n > size ) {
+			char *d = realloc( data, ( size = ( n > PIPE_CHUNK ) ? n : PIPE_CHUNK ) );
+			if ( !d ) {
+				snprintf( p->err, sizeof( p->err ), "Out of memory reading COPY data: %s", strerror( errno ) );
+				status = 0;
+				PQfreemem( buf );
+				break;
+			}
+			data = d;
+		}
+
+		memcpy( &data[ len ], buf, n ), len += n;
+		PQfreemem( buf );
+	}
+
+	// -1 is the end of the COPY, and the result that follows says how it went
+	if ( status && n == -1 ) {
+		while ( ( res = PQgetResult( (PGconn *)p->conn ) ) ) {
+			if ( PQresultStatus( res ) != PGRES_COMMAND_OK ) {
+				snprintf( p->err, sizeof( p->err ), "COPY failed: %s", PQresultErrorMessage( res ) );
+				status = 0;
+			}
+			else {
+				p->rows = strtoul( PQcmdTuples( res ), NULL, 10 );
+			}
+			PQclear( res );
+		}
+	}
+	else if ( status && n == -2 ) {
+		snprintf( p->err, sizeof( p->err ), "Failed to read COPY data: %s", PQerrorMessage( (PGconn *)p->conn ) );
+		status = 0;
+	}
+
+	free( data );
+	pthread_mutex_lock( &p->lock );
+	p->done = ( status && n == -1 ) ? 1 : -1;
+	pthread_cond_broadcast( &p->changed );
+	pthread_mutex_unlock( &p->lock );
+	return NULL;
+}
+
+
+/**
+ * int pipe_dsn ( config_t *conf, dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) 
+ *
+ * Copy Postgres to Postgres by passing the raw COPY BINARY data from 
+ * the input straight into a COPY on the output.  Nothing is decoded.  
+ * With --pipeline the input is read on its own thread, so both 
+ * servers can be busy at once.
+ *
+ */
+int pipe_dsn ( config_t *conf, dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) {
+	pgsql_t *idb = (pgsql_t *)iconn->conn;
+	pgsql_t *odb = (pgsql_t *)oconn->conn;
+	char query[ 2048 ] = { 0 };
+	char cq[ sizeof( query ) + 64 ] = { 0 };
+	PGresult *res = NULL;
+	pipe_t p;
+	int status = 1;
+
+	memset( &p, 0, sizeof( pipe_t ) );
+	p.conn = idb->conn;
+
+	select_for_dsn( iconn, conf, query, sizeof( query ) );
+	snprintf( cq, sizeof( cq ), "COPY ( %s ) TO STDOUT WITH ( FORMAT binary )", query );
+	if ( PQresultStatus( ( res = PQexec( idb->conn, cq ) ) ) != PGRES_COPY_OUT ) {
+		snprintf( err, errlen, "Failed to start COPY: %s", PQerrorMessage( idb->conn ) );
+		PQclear( res );
+		return 0;
+	}
+	PQclear( res );
+
+	// A --stage table was created in this transaction, so it can be frozen too
+	if ( !start_pgsql_copy( oconn, iconn, ( odb->copy ) ? " WITH ( FORMAT binary, FREEZE )" : " WITH ( FORMAT binary )", err, errlen ) ) {
+		return 0;
+	}
+	odb->copy = 0;
+
+	if ( !conf->wpipeline ) {
+		char *buf = NULL;
+		int n = 0;
+
+		while ( status && ( n = PQgetCopyData( idb->conn, &buf, 0 ) ) > 0 ) {
+			if ( PQputCopyData( odb->conn, buf, n ) != 1 ) {
+				snprintf( err, errlen, "Failed to write COPY data: %s", PQerrorMessage( odb->conn ) );
+				status = 0;
+			}
+			PQfreemem( buf );
+		}
+
+		if ( status && n == -2 ) {
+			snprintf( err, errlen, "Failed to read COPY data: %s", PQerrorMessage( idb->conn ) );
+			status = 0;
+		}
+
+		while ( status && ( res = PQgetResult( idb->conn ) ) ) {
+			if ( PQresultStatus( res ) != PGRES_COMMAND_OK ) {
+				snprintf( err, errlen, "COPY failed: %s", PQresultErrorMessage( res ) );
+				status = 0;
+			}
+			else {
+				p.rows = strtoul( PQcmdTuples( res ), NULL, 10 );
+			}
+			PQclear( res );
+		}
+	}
+	else {
+		pthread_t thread;
+		pthread_mutex_init( &p.lock, NULL );
+		pthread_cond_init( &p.changed, NULL );
+
+		if ( pthread_create( &thread, NULL, read_pipe, &p ) ) {
+			snprintf( err, errlen, "Failed to start --pipeline thread: %s", strerror( errno ) );
+			status = 0;
+		}
+		else {
+			for ( ;; ) {
+				char *data = NULL;
+				int len = 0;
+
+				pthread_mutex_lock( &p.lock );
+				while ( !p.count && !p.done ) {
+					pthread_cond_wait( &p.changed, &p.lock );
+				}
+				if ( p.count ) {
+					data = p.chunks[ p.head ].data, len = p.chunks[ p.head ].len;
+					p.head = ( p.head + 1 ) % PARALLEL_DEPTH, p.count--;
+					pthread_cond_broadcast( &p.changed );
+				}
+				pthread_mutex_unlock( &p.lock );
+
+				if ( !data ) {
+					break;
+				}
+
+				status = PQputCopyData( odb->conn, data, len ) == 1;
+				free( data );
+				if ( !status ) {
+					snprintf( err, errlen, "Failed to write COPY data: %s", PQerrorMessage( odb->conn ) );
+					break;
+				}
+			}
+
+			// Let the reader go if we gave up early, and throw away what it already read
+			pthread_mutex_lock( &p.lock );
+			p.stop = 1;
+			pthread_cond_broadcast( &p.changed );
+			pthread_mutex_unlock( &p.lock );
+			pthread_join( thread, NULL );
+
+			for ( ; p.count; p.head = ( p.head + 1 ) % PARALLEL_DEPTH, p.count-- ) {
+				free( p.chunks[ p.head ].data );
+			}
+
+			if ( status && p.done == -1 ) {
+				snprintf( err, errlen, "%s", p.err );
+				status = 0;
+			}
+		}
+
+		pthread_mutex_destroy( &p.lock );
+		pthread_cond_destroy( &p.changed );
+	}
+
+	// Don't let a partial load commit
+	if ( !status ) {
+		PQputCopyEnd( odb->conn, "input failed" );
+		while ( ( res = PQgetResult( odb->conn ) ) ) {
+			PQclear( res );
+		}
+		return 0;
+	}
+
+	if ( !end_pgsql_copy( odb, err, errlen ) ) {
+		return 0;
+	}
+
+	iconn->rtotal = p.rows;
+	return 1;
+}
+#endif
+
+
+/**
+ * int open_dsn ( dsn_t *conn, config_t *conf, const char *qopt, char *err, int errlen ) 
+ *
+ * Open a manage a data source.
+ *
+ */
+int open_dsn ( dsn_t *conn, config_t *conf, char *err, int errlen ) {
+	WPRINTF( "Attempting to open connection indicated by '%s'", conn->connstr );
+	char query[ 2048 ];
+	memset( query, 0, sizeof( query ) );
+
+	// Handle opening the database first
+	if ( conn->type == DB_FILE ) {
+		// An mmap() implementation for speedy reading and less refactoring
+		struct stat sb;
+		file_t *file = NULL;
+
+		// Create a file structure
+		if ( !( file = malloc( sizeof( file_t ) ) ) || !memset( file, 0, sizeof( file_t ) ) ) {
+			snprintf( err, errlen, "malloc() %s", strerror( errno ) );
+			return 0;
+		}
+
+		// Handle stdout (since there will be no size, and it doesn't make tons of sense to mmap() it)
+		if ( STRLCMP( conn->connstr, "/dev/stdout" ) ) {
+			file->fd = 1;
+			file->start = file->map = NULL;
+			conn->conn = file;
+			return 1;
+		}
+
+		// Initialize the stat buffer and check for the file
+		if ( memset( &sb, 0, sizeof( struct stat ) ) && stat( conn->connstr, &sb ) == -1 ) {
+			snprintf( err, errlen, "stat() %s", strerror( errno ) );
+			free( file );
+			return 0;
+		}
+
+		// Open the file
+		//fprintf( stderr, "Attempt to open %s\n", conn->connstr );
+		if ( conn->input ) {
+			if ( ( file->fd = open( conn->connstr, O_RDONLY ) ) == -1 ) {
+				snprintf( err, errlen, "open() %s", strerror( errno ) );
+				free( file );
+				return 0;
+			}
+		}
+		else {
+			if ( ( file->fd = open( conn->connstr, O_RDWR, 0644 ) ) == -1 ) {
+				snprintf( err, errlen, "open() %s", strerror( errno ) );
+				free( file );
+				return 0;
+			}
+		}
+
+		// If this is an output source, no reason to mmap()
+		if ( conn->input ) {
+			if ( ( file->size = sb.st_size ) == 0 ) {
+				snprintf( err, errlen, "You've specified a zero-length input source.  Aborting...\n" );
+				free( file );
+				return 0;
+			}
+
+			file->map = mmap( 0, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0 );
+			if ( file->map == MAP_FAILED ) {
+				snprintf( err, errlen, "mmap() mount failure %s", strerror( errno ) );
+				free( file );
+				return 0;
+			}
+		}
+
+		file->start = file->map;
+		file->offset = 0;
+		conn->conn = file;
+		return 1;
+	}
+
+	// Stop if no table name was specified
+	if ( !conf->wtable && ( !( *conn->tablename ) || strlen( conn->tablename ) < 1 ) ) {
+		snprintf( err, errlen, "No table name specified for source data." );
+		return 0;
+	}
+
+	// Headers and schemas (and --parallel-read, pushdowns and pipes, which get the rows elsewhere) only need the columns
+	int describe = conn->input && ( conf->wheaders || conf->wcount || conf->wschema || conf->wparallel > 1 || conn->pushdown || conn->pipe );
+
+	// Create the final query from here too
+	select_for_dsn( conn, conf, query, sizeof( query ) );
+
+#ifdef BMYSQL_H
+	if ( conn->type == DB_MYSQL ) {
+		// Switch everything to use this format now
+		mysql_t *db = NULL;
+
+		if ( !( db = malloc( sizeof( mysql_t ) ) ) || !memset( db, 0, sizeof( mysql_t ) ) ) {
+			const char fmt[] = "Memory constraint encountered initializing MySQL connection.";
+			snprintf( err, errlen, fmt );
+			return 0;
+		}
+
+		// Initialize the connection
+		if ( !( db->conn = mysql_init( 0 ) ) ) {
+			const char fmt[] = "Couldn't initialize MySQL connection: %s";
+			snprintf( err, errlen, fmt, mysql_error( db->conn ) );
+			mysql_close( db->conn );
+			return 0;
+		}
+
+		// Open the connection
+		MYSQL *t = mysql_real_connect(
+			db->conn,
+			conn->hostname,
+			conn->username,
+			conn->password,
+			conn->dbname,
+			conn->port,
+			NULL,
+			0
+		);
+
+		// Check the connection
+		if ( !t ) {
+			const char fmt[] = "Couldn't connect to server: %s";
+			snprintf( err, errlen, fmt, mysql_error( t ) );
+			return 0;
+		}
+
+		// Output sources only need the connection
+		if ( !conn->input ) {
+			db->conn = t;
+			conn->conn = (void *)db;
+			if ( conf->wbulk && !apply_bulk_profile( conn, err, errlen ) ) {
+				return 0;
+			}
+			return 1;
+		}
+
+		// Prepare the query without running it, the statement knows the columns already
+		if ( describe ) {
+			MYSQL_STMT *stmt = mysql_stmt_init( t );
+			if ( !stmt || mysql_stmt_prepare( stmt, query, strlen( query ) ) != 0 || !( db->res = mysql_stmt_result_metadata( stmt ) ) ) {
+				const char fmt[] = "Failed to describe query: %s";
+				snprintf( err, errlen, fmt, ( stmt ) ? mysql_stmt_error( stmt ) : mysql_error( t ) );
+				if ( stmt ) {
+					mysql_stmt_close( stmt );
+				}
+				mysql_close( t );
+				return 0;
+			}
+
+			db->stmt = stmt, db->conn = t;
+			conn->conn = (void *)db;
+			return 1;
+		}
+
+		// Execute whatever query
+		if ( mysql_query( t, query ) > 0 ) {
+			const char fmt[] = "Failed to run query against selected db and table: %s";
+			snprintf( err, errlen, fmt, mysql_error( t ) );
+			mysql_close( t );
+			return 0;
+		}
+
+		// Stream the result, records_from_dsn() pulls rows as it needs them
+		if ( !( db->res = mysql_use_result( t ) ) ) {
+			const char fmt[] = "Failed to start reading results from last query: %s";
+			snprintf( err, errlen, fmt, mysql_error( t ) );
+			mysql_close( t );
+			return 0;
+		}
+
+		// Set both of these
+		db->conn = t;
+		conn->conn = (void *)db;
+	}
+#endif
+
+#ifdef BPGSQL_H
+	if ( conn->type == DB_POSTGRESQL ) {
+		// Switch everything to use this format now
+		pgsql_t *db = NULL;
+
+		if ( !( db = malloc( sizeof( pgsql_t ) ) ) || !memset( db, 0, sizeof( pgsql_t ) ) ) {
+			const char fmt[] = "Memory constraint encountered initializing Postgres connection.";
+			snprintf( err, errlen, fmt );
+			return 0;
+		}
+
+		// Attempt to open the connection and handle errors
+		if ( PQstatus( ( db->conn = PQconnectdb( conn->connstr ) ) ) != CONNECTION_OK ) {
+			const char fmt[] = "Couldn't initialize PostsreSQL connection: %s";
+			snprintf( err, errlen, fmt, PQerrorMessage( db->conn ) );
+			PQfinish( db->conn );
+			return 0;
+		}
+
+		// Output sources only need the connection
+		if ( !conn->input ) {
+			conn->conn = (void *)db;
+			if ( conf->wbulk && !apply_bulk_profile( conn, err, errlen ) ) {
+				return 0;
+			}
+			return 1;
+		}
+
+		// Describing a prepared statement gives the columns without running anything
+		if ( describe ) {
+			PGresult *res = PQprepare( db->conn, "", query, 0, NULL );
+			conn->conn = (void *)db;
+
+			if ( PQresultStatus( res ) != PGRES_COMMAND_OK 
+				|| PQresultStatus( ( db->res = PQdescribePrepared( db->conn, "" ) ) ) != PGRES_COMMAND_OK ) {
+				const char fmt[] = "Failed to describe query: '%s'";
+				snprintf( err, errlen, fmt, PQerrorMessage( db->conn ) );
+				PQclear( res );
+				return 0;
+			}
+
+			PQclear( res );
+			return 1;
+		}
+
+		// Start the rows coming
+		conn->conn = (void *)db;
+		if ( !start_pgsql_read( conn, conf, query, err, errlen ) ) {
+			return 0;
+		}
+	}
+#endif
+#ifdef BSQLITE_H
+	if ( conn->type == DB_SQLITE ) {
+		sqlite3_t *db = NULL;
+		const int flags = ( conn->input ) ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+		if ( !( db = malloc( sizeof( sqlite3_t ) ) ) || !memset( db, 0, sizeof( sqlite3_t ) ) ) {
+			const char fmt[] = "Memory constraint encountered initializing SQLite3 connection.";
+			snprintf( err, errlen, fmt );
+			return 0;
+		}
+
+		// close_dsn() cleans up after a failed open too
+		conn->conn = (void *)db;
+		if ( sqlite3_open_v2( &conn->connstr[ sizeof( SQLITE_PREFIX ) - 1 ], &db->conn, flags, NULL ) != SQLITE_OK ) {
+			const char fmt[] = "Couldn't open SQLite3 database: %s";
+			snprintf( err, errlen, fmt, sqlite3_errmsg( db->conn ) );
+			return 0;
+		}
+
+		// Output sources only need the connection
+		if ( !conn->input ) {
+			if ( conf->wbulk && !apply_bulk_profile( conn, err, errlen ) ) {
+				return 0;
+			}
+			return 1;
+		}
+
+		// A prepared statement already knows its columns and declared types
+		if ( sqlite3_prepare_v2( db->conn, query, -1, &db->stmt, NULL ) != SQLITE_OK ) {
+			const char fmt[] = "Failed to prepare query against selected db and table: %s";
+			snprintf( err, errlen, fmt, sqlite3_errmsg( db->conn ) );
+			return 0;
+		}
+
+		// The first row also settles the type of columns that weren't declared
+		if ( !describe && ( db->status = sqlite3_step( db->stmt ) ) != SQLITE_ROW && db->status != SQLITE_DONE ) {
+			const char fmt[] = "Failed to run query against selected db and table: %s";
+			snprintf( err, errlen, fmt, sqlite3_errmsg( db->conn ) );
+			return 0;
+		}
+	}
+#endif
+
+	return 1;
+}
+
+
+/**
+ * static int index_ctypes ( nameidx_t *idx, coerce_t **list ) 
+ *
+ * Index a list from create_ctypes() by column or type name.
+ *
+ */
+static int index_ctypes ( nameidx_t *idx, coerce_t **list ) {
+	idx->nocase = 1;
+	for ( coerce_t **x = list; x && *x; x++ ) {
+		if ( !nameidx_add( idx, (*x)->misc, (void *)(*x)->typename ) ) return 0;
+	}
+	return 1;
+}
+
+
+/**
+ * static const char * find_ctype ( nameidx_t *idx, const char *name ) 
+ *
+ * Locate a specific coerced type.
+ *
+ */
+static const char * find_ctype ( nameidx_t *idx, const char *name ) {
+	return nameidx_get( idx, name );
+}
+
+
+/**
+ * static const char * find_atype ( nameidx_t *idx, const char *name ) 
+ *
+ * Locate a specific coerced type.
+ *
+ */
+static const char * find_atype ( nameidx_t *idx, const char *typename ) {
+	return nameidx_get( idx, typename );
+}
+
+
+
+/**
+ * coerce_t * create_ctypes( const char *src, char *err, int errlen ) 
+ *
+ * Create a key-value list of column names and their "coerced" type matches.
+ *
+ */
+coerce_t ** create_ctypes( const char *src, dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) {
+
+	// Define stuff
+	coerce_t **ctypes = NULL;
+	int ctypeslen = 0;
+	zw_t pp = { 0 };
+	const char *fmt = ( !iconn ) ? "--coerce" : "--auto";
+
+	// No matter who is calling, `oconn` is always needed
+	if ( !oconn ) {
+		fprintf( stderr, "NO OUPTUT CONNECTION GIVEN TO %s", __func__ );
+		return NULL;
+	}
+
+	// Loop through however many may exist
+	for ( coerce_t *t = NULL; strwalk( &pp, src, "," ); t = NULL ) {
+		if ( pp.size - 1 ) {
+			zw_t px = { 0 };
+			unsigned char *n = NULL; 
+			char p[ 256 ] = { 0 };
+			int len = pp.size - 1;
+
+			// Copy to new buffer or fail
+			if ( ( pp.size - 1 ) < sizeof( p ) ) {
+				n = trim( (unsigned char *)&src[ pp.pos ], " ", pp.size - 1, &len );
+				memcpy( p, n, len );
+			}
+			else {
+				memcpy( p, &src[ pp.pos ], 32 );
+				memcpy( &p[ 32 ], "...", 3 );
+				snprintf( err, errlen, "Argument given to %s will truncate: '%s'", fmt, p );
+				return NULL;
+			}
+		
+			// Stop if there are too many
+			if ( memchrocc( p, '=', strlen( p ) ) != 1 ) {
+				snprintf( err, errlen, "Argument given to %s is misformatted: '%s'", fmt, p );
+				return NULL;
+			}
+
+			// Catch allocation failures
+			if ( !( t = malloc( sizeof( coerce_t ) ) ) || !memset( t, 0, sizeof( coerce_t ) ) ) {
+				snprintf( err, errlen, "Allocation failed(): %s\n", strerror( errno ) );
+				return NULL;
+			}
+
+			// Then break the type and thing 
+			for ( int i = 0; strwalk( &px, p, "=" ); i++ ) {
+				// Define more
+				int len = 0;
+				char b[ 128 ] = { 0 };
+				unsigned char *n = NULL;
+				typemap_t *tmap = NULL;
+
+				// Check for zero-length or overflow and copy to buffer
+				if ( ( px.size - 1 ) < 1 ) {
+					// This is a format error
+					snprintf( err, errlen, "Got zero-length argument at %s", fmt );
+					return NULL;
+				}
+				else if ( ( px.size - 1 ) > sizeof( b ) ) {
+					snprintf( err, errlen, "Argument given to %s will truncate: '%s'", fmt, p );
+					return NULL;
+				}
+				else {
+					n = trim( (unsigned char *)&p[ px.pos ], " ", px.size - 1, &len );
+					memcpy( b, n, len );
+				}	
+
+				// Get the key
+				if ( i )
+					snprintf( (char *)t->typename, sizeof( t->typename ), "%s", b );
+				else {
+					// No input means that this first key is a column label
+					if ( !iconn )
+						snprintf( (char *)t->misc, sizeof( t->misc ), "%s", b );
+					else {
+						// Check that the input type is even supported
+						if ( !( tmap = get_typemap_by_nname( iconn->typemap, b ) ) ) {
+							free( t );
+							snprintf( err, errlen, "Type '%s' not found in argument at %s", b, fmt );
+							return NULL;	
+						}
+
+						snprintf( (char *)t->misc, sizeof( t->misc ), "%s", tmap->name );
+					}
+				}
+			}
+
+			// Add this to the list...
+			add_item( &ctypes, t, coerce_t *, &ctypeslen );
+		}
+	}
+
+	return ctypes;
+}
+
+
+/**
+ * headers_from_dsn( dsn_t * )
+ *
+ * Print the headers from a data source.
+ *
+ */
+int headers_from_dsn ( dsn_t *conn, config_t *conf, char *err, int errlen ) {
+
+	// Empty condition to assist with compiling out code
+	if ( conn->type == DB_FILE ) {
+		// TODO: Reimplement this to read line-by-line
+		zw_t p;
+		file_t *file = NULL;
+
+		// Prepare this structure
+		memset( &p, 0, sizeof( zw_t ) );
+
+		// Copy the delimiter to whatever this is
+		memcpy( &delset[ strlen( delset ) ], DELIM, strlen( DELIM ) );
+
+		// Check anyway in case something wonky happened
+		if ( !( file = (file_t *)conn->conn ) ) {
+			const char fmt[] = "mmap() src was lost.";
+			snprintf( err, errlen, fmt );
+			return 0;
+		}
+
+		// Walk through and find each column first
+		for ( int len = 0; strwalk( &p, (char *)file->map, delset ); ) {
+			char *t = ( !p.size ) ? no_header : copy( &((char *)file->map)[ p.pos ], p.size - 1, &len, case_type );
+			header_t *st = NULL;
+
+			// ...
+			if ( !( st = malloc( sizeof( header_t ) ) ) || !memset( st, 0, sizeof( header_t ) ) ) {
+				const char fmt[] = "Memory constraints encountered while fetching headers from file '%s'";
+				snprintf( err, errlen, fmt, conn->connstr );
+				return 0;
+			}
+
+			if ( !( st->label = intern( &conn->labels, t, strlen( t ) ) ) ) {
+				const char fmt[] = "Memory constraints encountered while fetching headers from file '%s'";
+				snprintf( err, errlen, fmt, conn->connstr );
+				free( st ), free( t );
+				return 0;
+			}
+
+			add_item( &conn->headers, st, header_t *, &conn->hlen );
+			free( t );
+			if ( p.chr == '\n' || p.chr == '\r' ) break;
+		}
+
+		// TODO: You CAN still make a schema with an empty query...
+		// But this is kind of tricky to allow.
+		if ( !conn->hlen ) {
+			const char fmt[] = "No header data found, please double check the file or input query.";  
+			snprintf( err, errlen, fmt );
+			return 0;
+		}
+		else if ( conn->hlen < 2 ) {
+			const char fmt[] = "Array size is less than 2.  Does this look correct?: %s";  
+			header_t **header = conn->headers;
+			snprintf( err, errlen, fmt, (*header)->label );
+			return 0;
+		}
+	}
+#ifdef BMYSQL_H
+	else if ( conn->type == DB_MYSQL ) {
+		mysql_t *db = (mysql_t *)conn->conn;
+
+		for ( int i = 0, fcount = mysql_num_fields( db->res ); i < fcount; i++ ) {
+			MYSQL_FIELD *f = mysql_fetch_field_direct( db->res, i );
+			header_t *st = NULL;
+
+			if ( !( st = malloc( sizeof( header_t ) )) || !memset( st, 0, sizeof( header_t ) ) ) {
+			//if ( CALLOC_NEW_FAILS( st, header_t ) ) {
+				const char fmt[] = "Memory constraints encountered while fetching headers from DSN %s";
+				snprintf( err, errlen, fmt, conn->connstr );
+				return 0;
+			}
+
+			// Get the actual type from the database engine
+			//st->ntype = f->type;
+			if ( !( st->label = intern( &conn->labels, f->name, strlen( f->name ) ) ) ) {
+				const char fmt[] = "Memory constraints encountered while fetching headers from DSN %s";
+				snprintf( err, errlen, fmt, conn->connstr );
+				free( st );
+				return 0;
+			}
+
+			add_item( &conn->headers, st, header_t *, &conn->hlen );
+		}
+
+		// TODO: You CAN still make a schema with an empty query...
+		// But this is kind of tricky to allow.
+		if ( conn->hlen < 1 ) {
+			const char fmt[] = "No data was returned in the query.  Not attempting to generate headers.";
+			snprintf( err, errlen, fmt );
+			return 0;
+		}
+	}
+#endif
+
+#ifdef BPGSQL_H
+	else if ( conn->type == DB_POSTGRESQL ) {
+		pgsql_t *db = (pgsql_t *)conn->conn;
+
+		for ( int i = 0, fcount = PQnfields( db->res ); i < fcount; i++ ) {
+			const char *name = PQfname( db->res, i );
+			header_t *st = NULL;
+
+			if ( !( st = malloc( sizeof( header_t ) ) ) || !memset( st, 0, sizeof( header_t ) ) ) {
+			//if ( CALLOC_NEW_FAILS( st, header_t ) ) {
+				fprintf( stderr, "Memory constraints encountered while building schema" );
+				return 0;
+			}
+
+			// Get the actual type from the database engine
+			if ( !( st->label = intern( &conn->labels, name, strlen( name ) ) ) ) {
+				fprintf( stderr, "Memory constraints encountered while building schema" );
+				free( st );
+				return 0;
+			}
+
+			add_item( &conn->headers, st, header_t *, &conn->hlen );
+		}
+
+	}
+#endif
+#ifdef BSQLITE_H
+	else if ( conn->type == DB_SQLITE ) {
+		sqlite3_t *db = (sqlite3_t *)conn->conn;
+
+		for ( int i = 0, fcount = sqlite3_column_count( db->stmt ); i < fcount; i++ ) {
+			const char *name = sqlite3_column_name( db->stmt, i );
+			header_t *st = NULL;
+
+			if ( !( st = malloc( sizeof( header_t ) ) ) || !memset( st, 0, sizeof( header_t ) ) ) {
+				fprintf( stderr, "Memory constraints encountered while building schema" );
+				return 0;
+			}
+
+			if ( !( st->label = intern( &conn->labels, name, strlen( name ) ) ) ) {
+				fprintf( stderr, "Memory constraints encountered while building schema" );
+				free( st );
+				return 0;
+			}
+
+			add_item( &conn->headers, st, header_t *, &conn->hlen );
+		}
+
+		if ( conn->hlen < 1 ) {
+			const char fmt[] = "No data was returned in the query.  Not attempting to generate headers.";
+			snprintf( err, errlen, fmt );
+			return 0;
+		}
+	}
+#endif
+
+
+	return 1;
+}
+
+
+
+#if 0
+// TODO: This is coming back, just not right now...
+/**
+ * struct_from_dsn( dsn_t * )
+ *
+ * Create a struct from data source.
+ *
+ */
+int struct_from_dsn( dsn_t * conn ) {
+
+	char **defs = NULL;
+	if ( classdata ) {
+		fprintf( stdout, "class %s {\n", root );
+	}
+	else {
+		fprintf( stdout, "struct %s {\n", root );
+	}
+
+	// Add the rest of the rows
+for ( header_t **s = conn->headers; s && *s; s++ ) {
+	fprintf( stdout, "\t%s %s;\n", defs[ (*s)->type ], (*s)->label );
+}
+
+return 1;
+}
+#endif
+
+
+/**
+ * char * create_sql_insert_statement ( dsn_t *oconn, dsn_t *iconn, bindtype_t bindtype, char *err, int errlen ) 
+ *
+ * Create an SQL insert statement suitable for a specific type of database engine.
+ *
+ */
+char * create_sql_insert_statement ( dsn_t *oconn, dsn_t *iconn, bindtype_t bindtype, char *err, int errlen ) {
+	int p = 0;
+	char *bindstmt = NULL;
+	char  buffer[ 512 ] = { 0 };
+	const char *fmt = NULL;
+
+	// TODO: Complians about not const string, fix this...
+	if ( bindtype == BINDTYPE_ANON )
+		fmt = bindtypes[ BINDTYPE_ANON ];
+	else if ( bindtype == BINDTYPE_NUMERIC )
+		fmt = bindtypes[ BINDTYPE_NUMERIC ];
+	else if ( bindtype == BINDTYPE_ALPHA )
+		fmt = bindtypes[ BINDTYPE_ALPHA ];
+	else if ( bindtype == BINDTYPE_AT ) {
+		fmt = bindtypes[ BINDTYPE_AT ];
+	}
+
+	// Also go ahead and create the reusable bind statement
+	if ( !( bindstmt = malloc( 1 ) ) || !memset( bindstmt, 0, 1 ) ) {
+		const char fmt[] = "%s: out of memory occurred allocating MySQL bind statement: %s";
+		snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+		return 0;	
+	}
+
+	// Write the "preamble"
+	p = snprintf( buffer, sizeof( buffer ), "INSERT INTO %s ( ", oconn->tablename ); 
+	if ( p >= sizeof( buffer ) - 1 || buffer[p] != '\0' ) {
+		const char fmt[] = "%s: Truncation occurred writing MySQL bind statement";
+		snprintf( err, errlen, fmt, __func__ );
+		return 0;
+	}
+
+	// Copy it and then loop through the rest
+	bindstmt = realloc( bindstmt, p );
+	memcpy( bindstmt, buffer, p );
+
+	// All column headers 
+	for ( header_t **h = iconn->headers; h && *h; h++ ) {
+		int i = p;
+		int size = 0;
+		memset( buffer, 0, sizeof( buffer ) );
+		size = snprintf( buffer, sizeof( buffer ) - 1 , &",%s"[ ( *iconn->headers == *h ) ], (*h)->label );
+		p += size;
+		bindstmt = realloc( bindstmt, p );
+		memcpy( &bindstmt[ i ], buffer, size );	
+	}
+
+	// Then VALUES string
+	if ( 1 ) {
+		int i = p;
+		int size = 0;
+		memset( buffer, 0, sizeof( buffer ) );
+		size = snprintf( buffer, sizeof( buffer ), " ) VALUES ( " );
+		p += size;
+		bindstmt = realloc( bindstmt, p );
+		memcpy( &bindstmt[ i ], buffer, size );
+	}
+
+	// Then each parameter 
+	// All column headers 
+	int column = 1;
+	for ( header_t **h = iconn->headers; h && *h; h++, column++ ) {
+		int i = p;
+		int size = 0;
+		int f = ( *iconn->headers == *h ) ? 0 : 1;
+		memset( buffer, 0, sizeof( buffer ) );
+
+		if ( f ) {
+			size = snprintf( buffer, sizeof( buffer ), "," );
+		} 
+
+		if ( bindtype == BINDTYPE_ANON )
+			size += snprintf( &buffer[f], sizeof( buffer ) - 1, "%s", fmt );
+		else if ( bindtype == BINDTYPE_NUMERIC )
+			size += snprintf( &buffer[f], sizeof( buffer ) - 1 , fmt, column ); 
+		else if ( bindtype == BINDTYPE_ALPHA )
+			size += snprintf( &buffer[f], sizeof( buffer ) - 1 , fmt, (*h)->label );
+		else if ( bindtype == BINDTYPE_AT ) {
+			size += snprintf( &buffer[f], sizeof( buffer ) - 1 , fmt, (*h)->label ); 
+		}
+
+		p += size;
+		bindstmt = realloc( bindstmt, p );
+		memcpy( &bindstmt[ i ], buffer, size );	
+	}
+	
+	// Then the end	
+	if ( 1 ) {
+		int i = p;
+		int size = 0;
+		memset( buffer, 0, sizeof( buffer ) );
+		size = snprintf( buffer, sizeof( buffer ), " )" );
+		p += size;
+		bindstmt = realloc( bindstmt, p );
+		memcpy( &bindstmt[ i ], buffer, size );
+	}
+
+	// Terminate 
+	bindstmt = realloc( bindstmt, p + 1 );
+	memcpy( &bindstmt[ p ], "\0", 1 );
+	return bindstmt;
+}
+
+
+/**
+ * static unsigned char *skip_lines ( unsigned char *s, unsigned long len, unsigned long n ) 
+ *
+ * Move past n lines of s.  memchr() finds each newline far quicker 
+ * than memwalk() could split rows that are only going to be skipped.
+ *
+ */
+static unsigned char *skip_lines ( unsigned char *s, unsigned long len, unsigned long n ) {
+	unsigned char *end = s + len;
+
+	for ( unsigned char *nl = NULL; n && s < end && ( nl = memchr( s, '\n', end - s ) ); n-- ) {
+		s = nl + 1;
+	}
+
+	return ( n ) ? end : s;
+}
+
+
+/**
+ * static int newlines_in_word ( unsigned long long w ) 
+ *
+ * Count the '\n' bytes in eight bytes at once.  Each byte of x is 
+ * zero where w had a newline, and the high bit of every zero byte is
+ * set without any carries between bytes, then summed by a multiply.
+ *
+ */
+static int newlines_in_word ( unsigned long long w ) {
+	const unsigned long long lo = 0x0101010101010101ULL;
+	unsigned long long x = w ^ ( lo * '\n' );
+
+	x = ~( ( ( x & ( lo * 0x7f ) ) + ( lo * 0x7f ) ) | x ) & ( lo * 0x80 );
+	return (int)( ( ( x >> 7 ) * lo ) >> 56 );
+}
+
+
+/**
+ * static unsigned long count_lines ( const unsigned char *s, unsigned long len ) 
+ *
+ * Count the records in s.  A last line without a newline still counts.
+ *
+ */
+static unsigned long count_lines ( const unsigned char *s, unsigned long len ) {
+	unsigned long n = 0, i = 0;
+
+	for ( unsigned long long w = 0; i + sizeof( w ) <= len; i += sizeof( w ) ) {
+		memcpy( &w, &s[ i ], sizeof( w ) );
+		n += newlines_in_word( w );
+	}
+
+	for ( ; i < len; i++ ) {
+		n += s[ i ] == '\n';
+	}
+
+	return n + ( len && s[ len - 1 ] != '\n' );
+}
+
+
+/**
+ * static unsigned long long hash_file ( file_t *file ) 
+ *
+ * Hash both ends of a file.  Together with the size and mtime, this 
+ * is enough to tell a stale index apart without reading everything.
+ *
+ */
+static unsigned long long hash_file ( file_t *file ) {
+	const unsigned char *s = file->start;
+	unsigned long long h = 14695981039346656037ULL;
+	unsigned long len = ( file->size < INDEX_SAMPLE ) ? file->size : INDEX_SAMPLE;
+
+	for ( unsigned long i = 0; i < len; i++ ) {
+		h = ( h ^ s[ i ] ) * 1099511628211ULL;
+	}
+
+	for ( unsigned long i = file->size - len; i < file->size; i++ ) {
+		h = ( h ^ s[ i ] ) * 1099511628211ULL;
+	}
+
+	return h;
+}
+
+
+/**
+ * static index_t *build_index ( file_t *file, unsigned long first ) 
+ *
+ * Count the records of a file that start at byte first, and keep 
+ * where every INDEX_STRIDE-th one starts.  Words are counted eight 
+ * bytes at a time, and only a word holding the end of a stride gets
+ * walked a byte at a time.
+ *
+ */
+static index_t *build_index ( file_t *file, unsigned long first ) {
+	const unsigned char *s = file->start;
+	unsigned long long cap = file->size / INDEX_STRIDE + 2;
+	unsigned long long *offsets = NULL, rows = 0, next = INDEX_STRIDE;
+	unsigned long i = first;
+	index_t *ix = NULL;
+
+	// Every stride has at least one byte per record, so cap is never exceeded
+	if ( !( ix = malloc( sizeof( index_t ) + cap * sizeof( unsigned long long ) ) ) ) {
+		return NULL;
+	}
+
+	memset( ix, 0, sizeof( index_t ) );
+	memcpy( ix->magic, INDEX_MAGIC, sizeof( ix->magic ) );
+	offsets = (unsigned long long *)( ix + 1 );
+	offsets[ ix->olen++ ] = first;
+
+	for ( unsigned long long w = 0; i + sizeof( w ) <= file->size; i += sizeof( w ) ) {
+		int n = 0;
+		memcpy( &w, &s[ i ], sizeof( w ) );
+
+		if ( !( n = newlines_in_word( w ) ) )
+			continue;
+		else if ( rows + n < next ) {
+			rows += n;
+			continue;
+		}
+
+		for ( unsigned long b = i; b < i + sizeof( w ); b++ ) {
+			if ( s[ b ] == '\n' && ++rows == next && b + 1 < file->size ) {
+				offsets[ ix->olen++ ] = b + 1, next += INDEX_STRIDE;
+			}
+		}
+	}
+
+	for ( ; i < file->size; i++ ) {
+		if ( s[ i ] == '\n' && ++rows == next && i + 1 < file->size ) {
+			offsets[ ix->olen++ ] = i + 1, next += INDEX_STRIDE;
+		}
+	}
+
+	ix->rows = rows + ( file->size > first && s[ file->size - 1 ] != '\n' );
+	ix->stride = INDEX_STRIDE;
+	return ix;
+}
+
+
+/**
+ * static index_t *load_index ( const char *path, index_t *key ) 
+ *
+ * Read the index at path, as long as it was built for the file 
+ * described by key.  Anything else is treated as no index at all.
+ *
+ */
+static index_t *load_index ( const char *path, index_t *key ) {
+	index_t h, *ix = NULL;
+	unsigned long long size = 0;
+	int fd = open( path, O_RDONLY );
+
+	if ( fd == -1 ) {
+		return NULL;
+	}
+
+	if ( read( fd, &h, sizeof( h ) ) != sizeof( h ) 
+		|| memcmp( h.magic, INDEX_MAGIC, sizeof( h.magic ) ) 
+		|| h.size != key->size || h.mtime != key->mtime || h.hash != key->hash
+		|| !h.stride || !h.olen || h.olen > h.size / h.stride + 2 ) {
+		close( fd );
+		return NULL;
+	}
+
+	size = h.olen * sizeof( unsigned long long );
+	if ( !( ix = malloc( sizeof( index_t ) + size ) ) 
+		|| read( fd, (index_t *)memcpy( ix, &h, sizeof( h ) ) + 1, size ) != size ) {
+		free( ix ), close( fd );
+		return NULL;
+	}
+
+	close( fd );
+	return ix;
+}
+
+
+/**
+ * int index_dsn ( dsn_t *conn, config_t *conf, char *err, int errlen ) 
+ *
+ * Find the sidecar index of a file input, or build one and write it 
+ * next to the file for the next run.  file->map has to be at the 
+ * first record already.
+ *
+ */
+int index_dsn ( dsn_t *conn, config_t *conf, char *err, int errlen ) {
+	file_t *file = (file_t *)conn->conn;
+	char path[ PATH_MAX ] = { 0 };
+	struct stat sb;
+	index_t key;
+	int fd = -1;
+
+	if ( fstat( file->fd, &sb ) == -1 ) {
+		snprintf( err, errlen, "fstat() %s", strerror( errno ) );
+		return 0;
+	}
+
+	memset( &key, 0, sizeof( key ) );
+	key.size = file->size, key.mtime = sb.st_mtime, key.hash = hash_file( file );
+	snprintf( path, sizeof( path ), "%s" INDEX_SUFFIX, conn->connstr );
+
+	if ( ( file->index = load_index( path, &key ) ) ) {
+		return 1;
+	}
+
+	if ( !( file->index = build_index( file, file->offset ) ) ) {
+		const char fmt[] = "Out of memory when indexing '%s': %s";
+		snprintf( err, errlen, fmt, conn->connstr, strerror( errno ) );
+		return 0;
+	}
+
+	file->index->size = key.size, file->index->mtime = key.mtime, file->index->hash = key.hash;
+
+	// Not being able to save it only costs the next run a scan
+	size_t size = sizeof( index_t ) + file->index->olen * sizeof( unsigned long long );
+	if ( ( fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 || write( fd, file->index, size ) != size ) {
+		fprintf( stderr, "WARNING: Could not write index '%s': %s\n", path, strerror( errno ) );
+	}
+
+	if ( fd > -1 ) {
+		close( fd );
+	}
+
+	return 1;
+}
+
+
+/**
+ * int prepare_dsn_for_read ( dsn_t *conn, config_t *conf, char *err, int errlen ) 
+ *
+ * Prepare DSN for reading.  Files skip the header and any --offset
+ * rows here; databases were given their offset in the query.
+ *
+ */
+int prepare_dsn_for_read ( dsn_t *conn, config_t *conf, char *err, int errlen ) {
+	// Move up the buffer so that we start from the right offset
+	//while ( *(buffer++) != '\n' );
+	WHERE();
+
+	if ( conn->type == DB_FILE ) {
+		file_t *file = (file_t *)conn->conn;
+		int len = file->size;
+
+		// Move to the end of the first row
+		while ( len-- && *(file->map)++ != '\n' ) {
+			//file->map++, len--;
+		}
+
+		file->offset = file->size - len;
+
+		if ( conf->windex && !index_dsn( conn, conf, err, errlen ) ) {
+			return 0;
+		}
+
+		// Skipped rows are never tokenized, and an index skips most of them without reading
+		if ( conf->woffset ) {
+			unsigned long skip = conf->woffset;
+			unsigned char *s = file->map;
+
+			if ( file->index ) {
+				unsigned long long *offsets = (unsigned long long *)( file->index + 1 );
+				unsigned long long k = skip / file->index->stride;
+
+				k = ( k < file->index->olen ) ? k : file->index->olen - 1;
+				s = (unsigned char *)file->start + offsets[ k ], skip -= k * file->index->stride;
+			}
+
+			s = skip_lines( s, file->size - ( s - (unsigned char *)file->start ), skip );
+			file->offset = s - (unsigned char *)file->start, file->map = s;
+		}
+
+		DPRINTF( "file->offset: %d\n", file->offset );
+		DPRINTF( "file->size: %ld\n", file->size );
+		DPRINTF( "file->map: %p\n", (void *)file->map );
+	}
+
+	else if ( conn->type == DB_MYSQL ) {
+	}
+
+	else if ( conn->type == DB_POSTGRESQL ) {
+	}
+
+	return 1;
+}
+
+
+/**
+ * int count_dsn ( dsn_t *conn, config_t *conf, unsigned long *count, char *err, int errlen ) 
+ *
+ * Count the records an input would give, after --offset and --limit,
+ * without reading any of them.  Files use their index or a quick 
+ * scan of newlines, and databases are asked with COUNT(*).
+ *
+ */
+int count_dsn ( dsn_t *conn, config_t *conf, unsigned long *count, char *err, int errlen ) {
+	char query[ 2048 ] = { 0 }, stmt[ 2048 + 64 ] = { 0 }, val[ 64 ] = { 0 };
+
+	if ( conn->type == DB_FILE ) {
+		file_t *file = (file_t *)conn->conn;
+
+		// prepare_dsn_for_read() already moved past the --offset rows
+		if ( !file->index )
+			*count = count_lines( file->map, file->size - file->offset );
+		else {
+			*count = ( file->index->rows > conf->woffset ) ? file->index->rows - conf->woffset : 0;
+		}
+	}
+	else {
+		select_for_dsn( conn, conf, query, sizeof( query ) );
+		snprintf( stmt, sizeof( stmt ), "SELECT COUNT(*) FROM ( %s ) briggs_count", query );
+		if ( !query_dsn( conn, stmt, val, sizeof( val ), err, errlen ) ) {
+			return 0;
+		}
+		*count = strtoul( val, NULL, 10 );
+	}
+
+	if ( conf->wlimit && *count > conf->wlimit ) {
+		*count = conf->wlimit;
+	}
+
+	return 1;
+}
+
+
+/**
+ * static void print_progress ( unsigned long rows, unsigned long total, struct timespec *start, int done ) 
+ *
+ * Show how far along a conversion is on stderr, at most once a 
+ * second.  An ETA needs a total, which only an index gives for free.
+ *
+ */
+static void print_progress ( unsigned long rows, unsigned long total, struct timespec *start, int done ) {
+	static time_t last = 0;
+	struct timespec now;
+	double secs = 0;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	if ( !done && now.tv_sec == last ) {
+		return;
+	}
+
+	last = now.tv_sec;
+	secs = ( now.tv_sec - start->tv_sec ) + ( now.tv_nsec - start->tv_nsec ) / 1e9;
+	secs = ( secs > 0 ) ? secs : 1e-9;
+
+	if ( total && rows <= total ) {
+		const char fmt[] = "\r%lu of %lu rows (%.1f%%), %.0f rows/s, ETA %.0fs ";
+		fprintf( stderr, fmt, rows, total, 100.0 * rows / total, rows / secs, ( total - rows ) / ( rows / secs + 1e-9 ) );
+	}
+	else {
+		fprintf( stderr, "\r%lu rows, %.0f rows/s ", rows, rows / secs );
+	}
+
+	if ( done ) {
+		fprintf( stderr, "\n" );
+	}
+}
+
+
+/**
+ * int prepare_dsn_for_write ( dsn_t *, dsn_t *, char *, int) 
+ *
+ * Prepare DSN for writing.  
+ *
+ */
+int prepare_dsn_for_write ( dsn_t *oconn, dsn_t *iconn, char *err, int errlen ) {
+	WHERE();
+
+	if ( oconn->type == DB_FILE ) {
+		file_t *file = (file_t *)oconn->conn;
+		// Reading happens from the input source, so that is another story
+		if ( oconn->stream == STREAM_PRINTF || oconn->stream == STREAM_COMMA ) 
+			;
+		if ( oconn->stream == STREAM_CSTRUCT )
+			;
+		if ( oconn->stream == STREAM_CARRAY )
+			;
+		if ( oconn->stream == STREAM_JSON )
+			FDPRINTF( file->fd, "[" );
+		if ( oconn->stream == STREAM_XML ) {
+			char *treename = strlen( oconn->dbname ) ? oconn->dbname : "tree";
+			FDPRINTF( file->fd, "<" );
+			FDPRINTF( file->fd, treename );
+			FDPRINTF( file->fd, ">" );
+			FF.newline ? FDPRINTF( file->fd, "\n" ) : 0;
+		}	
+	}
+
+
+	else if ( oconn->type == DB_MYSQL ) {
+		WPRINTF( "PREPARING MySQL DSN: %d columns\n", iconn->hlen );
+
+		// Deref and check that this is still here...
+		mysql_t *t = (mysql_t *)oconn->conn;	
+	
+		// Make the insert statement
+		if ( !( t->query = create_sql_insert_statement( oconn, iconn, BINDTYPE_ANON, err, errlen ) ) ) {
+			return 0;
+		}
+
+		// Allocate statement and bind arguments structures
+		if ( !( t->stmt = (void *)mysql_stmt_init( (MYSQL *)t->conn ) ) ) {
+			const char fmt[] = "%s: couldn't allocate MySQL statement: %s";
+			snprintf( err, errlen, fmt, __func__, mysql_error( t->conn ) );
+			return 0;	
+		}
+
+		if ( !( t->bindargs = malloc( sizeof( MYSQL_BIND ) * iconn->hlen ) ) || !memset( t->bindargs, 0, sizeof( MYSQL_BIND ) * iconn->hlen ) ) {
+			const char fmt[] = "%s: out of memory occurred allocating MySQL bind structures: %s";
+			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+			return 0;	
+		}
+
+		if ( !( t->params = malloc( sizeof( mysql_param_t ) * iconn->hlen ) ) || !memset( t->params, 0, sizeof( mysql_param_t ) * iconn->hlen ) ) {
+			const char fmt[] = "%s: out of memory occurred allocating MySQL bind values: %s";
+			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+			return 0;	
+		}
+
+		// Nothing is bound until the first row says what the buffers are
+		t->plen = iconn->hlen, t->rebind = 1;
+
+		// The statement is prepared once, and only the bindings change per row
+		if ( mysql_stmt_prepare( t->stmt, t->query, strlen( t->query ) ) != 0 ) {
+			const char fmt[] = "MySQL statement prepare failure: '%s'";
+			snprintf( err, errlen, fmt, mysql_stmt_error( t->stmt ) );
+			return 0;
+		}
+
+		// Use the parameter count to check that everything worked (probably useless)
+		if ( mysql_stmt_param_count( t->stmt ) != iconn->hlen ) {
+			snprintf( err, errlen, "MySQL column header count mismatch." );
+			return 0;
+		}
+	}
+
+	else if ( oconn->type == DB_POSTGRESQL ) {
+		WPRINTF( "PREPARING PostgreSQL DSN: %d columns\n", iconn->hlen );
+
+		// Der
+		pgsql_t *t = (pgsql_t *)oconn->conn;	
+
+		// Make the insert statement
+		if ( !( t->query = create_sql_insert_statement( oconn, iconn, BINDTYPE_NUMERIC, err, errlen ) ) ) {
+			return 0;
+		}
+
+		if ( !( t->bindargs = malloc( sizeof( char * ) * iconn->hlen ) ) || !memset( t->bindargs, 0, sizeof( char * ) * iconn->hlen ) ) {
+			const char fmt[] = "%s: out of memory occurred allocating Postgres bind structures: %s";
+			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+			return 0;
+		}
+
+		if ( !( t->bindlens = malloc( sizeof( int ) * iconn->hlen ) ) || !memset( t->bindlens, 0, sizeof( int ) * iconn->hlen ) ) {
+			const char fmt[] = "%s: out of memory occurred allocating Postgres bind length structures: %s";
+			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+			return 0;	
+		}
+
+		if ( !( t->bindfmts = malloc( sizeof( int ) * iconn->hlen ) ) || !memset( t->bindfmts, 0, sizeof( int ) * iconn->hlen ) ) {
+			const char fmt[] = "%s: out of memory occurred allocating Postgres bind types structures: %s";
+			snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+			return 0;
+		}
+
+		// A staged table can be loaded with COPY, and frozen as it goes
+		if ( t->copy && !start_pgsql_copy( oconn, iconn, " WITH ( FREEZE )", err, errlen ) ) {
+			return 0;
+		}
+
+		// Values are bound as whatever the table's columns are, not what the input looked like
+		if ( !t->copy ) {
+			PGresult *res = PQprepare( t->conn, PG_INSERT_STMT, t->query, 0, NULL ), *desc = NULL;
+
+			if ( PQresultStatus( res ) != PGRES_COMMAND_OK 
+				|| PQresultStatus( ( desc = PQdescribePrepared( t->conn, PG_INSERT_STMT ) ) ) != PGRES_COMMAND_OK 
+				|| PQnparams( desc ) != iconn->hlen ) {
+				const char fmt[] = "Failed to describe Postgres insert: '%s'";
+				snprintf( err, errlen, fmt, PQerrorMessage( t->conn ) );
+				PQclear( res ), PQclear( desc );
+				return 0;
+			}
+
+			if ( !( t->targets = malloc( sizeof( Oid ) * iconn->hlen ) ) ) {
+				const char fmt[] = "%s: out of memory occurred allocating Postgres bind types structures: %s";
+				snprintf( err, errlen, fmt, __func__, strerror( errno ) );
+				PQclear( res ), PQclear( desc );
+				return 0;
+			}
+
+			for ( int i = 0; i < iconn->hlen; i++ ) {
+				t->targets[ i ] = PQparamtype( desc, i );
+			}
+
+			PQclear( res ), PQclear( desc );
+		}
+	}
+
+#ifdef BSQLITE_H
+	else if ( oconn->type == DB_SQLITE ) {
+		WPRINTF( "PREPARING SQLite3 DSN: %d columns\n", iconn->hlen );
+		sqlite3_t *t = (sqlite3_t *)oconn->conn;
+		char *query = NULL;
+
+		// One statement is reset and bound again for every row
+		if ( !( query = create_sql_insert_statement( oconn, iconn, BINDTYPE_ANON, err, errlen ) ) ) {
+			return 0;
+		}
+
+		if ( sqlite3_prepare_v2( t->conn, query, -1, &t->stmt, NULL ) != SQLITE_OK ) {
+			const char fmt[] = "SQLite3 statement prepare failure: '%s'";
+			snprintf( err, errlen, fmt, sqlite3_errmsg( t->conn ) );
+			free( query );
+			return 0;
+		}
+		free( query );
+
+		// Rows go in as few transactions as possible (see SQLITE_TXN_ROWS)
+		if ( !query_dsn( oconn, "BEGIN", NULL, 0, err, errlen ) ) {
+			return 0;
+		}
+		t->pending = 0;
+	}
+#endif
+
+	return 1;
+}
+
+
+/**
+ * int finish_dsn_for_write ( dsn_t *oconn, char *err, int errlen ) 
+ *
+ * Make everything written since prepare_dsn_for_write() stick.  Only 
+ * SQLite3 holds anything back right now.
+ *
+ */
+int finish_dsn_for_write ( dsn_t *oconn, char *err, int errlen ) {
+#ifdef BSQLITE_H
+	if ( oconn->type == DB_SQLITE && ( (sqlite3_t *)oconn->conn )->stmt ) {
+		return query_dsn( oconn, "COMMIT", NULL, 0, err, errlen );
+	}
+#endif
+	return 1;
+}
+
+
+/**
+ * void unprepare_dsn( dsn_t *conn ) 
+ *
+ * "Unmount" different data sources (e.g. closing a database or something)
+ *
+ */
+void unprepare_dsn( dsn_t *conn ) {
+	// Rewinding the pointer to the beginning would be an ok idea. But unnecessary
+	if ( conn->type == DB_FILE ) {
+		WPRINTF( "UNPREPARING FILE DSN\n" );
+		file_t *file = (file_t *)conn->conn;
+		// Reading happens from the input source, so that is another story
+		if ( conn->stream == STREAM_PRINTF || conn->stream == STREAM_COMMA ) 
+			;
+		else if ( conn->stream == STREAM_CSTRUCT )
+			;
+		else if ( conn->stream == STREAM_CARRAY )
+			;
+		else if ( conn->stream == STREAM_JSON )
+			FDPRINTF( file->fd, "]" );
+		else if ( conn->stream == STREAM_XML ) {
+			char *treename = strlen( conn->dbname ) ? conn->dbname : "tree";
+			FDPRINTF( file->fd, "</" );
+			FDPRINTF( file->fd, treename );
+			FDPRINTF( file->fd, ">" );
+		}
+		
+	}
+
+	else if ( conn->type == DB_MYSQL ) {
+		WPRINTF( "UNPREPARING MySQL DSN\n" );
+		mysql_t *t = (mysql_t *)conn->conn;	
+		if ( t->stmt ) {
+			mysql_stmt_close( t->stmt ), t->stmt = NULL;
+		}
+		for ( int i = 0; t->params && i < t->plen; i++ ) {
+			free( t->params[ i ].copy );
+		}
+		free( t->bindargs );
+		free( t->params );
+		t->bindargs = NULL, t->params = NULL;
+		free( (void *)t->query );
+	}
+
+	else if ( conn->type == DB_POSTGRESQL ) {
+		WPRINTF( "UNPREPARING Postgres DSN\n" );
+		pgsql_t *t = (pgsql_t *)conn->conn;	
+		free( t->bindargs );
+		free( t->bindlens );
+		free( t->bindfmts );
+		free( t->targets );
+		free( t->copybuf );
+		free( t->argbuf );
+		free( (void *)t->query );
+		t->copybuf = NULL, t->copysize = 0;
+		t->argbuf = NULL, t->argsize = 0, t->targets = NULL;
+	}
+
+#ifdef BSQLITE_H
+	else if ( conn->type == DB_SQLITE ) {
+		WPRINTF( "UNPREPARING SQLite3 DSN\n" );
+		sqlite3_t *t = (sqlite3_t *)conn->conn;	
+		sqlite3_finalize( t->stmt ), t->stmt = NULL;
+	}
+#endif
+}
+
+
+
+/**
+ * records_from_dsn( dsn_t * )
+ *
+ * Extract records from a data source.
+ *
+ * conn = The source we're reading records from
+ * count = Number of "rows" to read at a time
+ * offset = Where to start from next
+ *
+ */
+int records_from_dsn( dsn_t *conn, int count, int offset, char *err, int errlen ) {
+	WHERE();
+
+	// --parallel-read connections do the reading
+	if ( conn->parallel ) {
+		return records_from_readers( conn, err, errlen );
+	}
+
+	if ( conn->type == DB_FILE ) {
+		zw_t *p = NULL;
+		column_t **cols = NULL;
+		row_t *row = NULL;
+		file_t *file = NULL;
+
+		const unsigned int dlen = strlen( delset );
+		unsigned int ci = 0;
+		unsigned int line = 0;
+		unsigned char *dset = (unsigned char *)delset;
+		int clen = 0;
+
+		// Cast
+		if ( !( file = (file_t *)conn->conn ) ) {
+			const char fmt[] = "mmap() lost reference";
+			snprintf( err, errlen, fmt );
+			return 0;
+		}
+
+		// Pick up wherever the last batch stopped
+		p = &file->walker;
+
+		// Cycle through the set of entries that we want
+		for ( ; line < count && memwalk( p, file->map, dset, file->size - file->offset, dlen ); ) {
+
+			// Deifne some stuff to make this easier to walk
+			column_t *col = NULL;
+			type_t etype = T_NULL;
+
+			// Increase the line count
+			if ( p->chr == '\r' ) {
+				line++;
+				continue;
+			}
+
+			// Exit if the column count indicates that this is not uniform data
+			if ( ci > conn->hlen ) {
+				const char fmt[] = "Column count (%d) does not match header count (%d) at line %d in file '%s'";
+				snprintf( err, errlen, fmt, ci, conn->hlen, line, conn->connstr );
+				return 0;
+			}
+
+			// Allocate, prepare and set column values
+			if ( !( col = malloc( sizeof( column_t ) ) ) || !memset( col, 0, sizeof( column_t ) ) ) {
+				const char fmt[] = "Out of memory when allocating space for value at line %d, column %d: %s";
+				snprintf( err, errlen, fmt, line, ci, strerror( errno ) );
+				return 0;
+			}
+
+			// Get approximate types from the datasource and all of the other info
+			etype = conn->headers[ ci ]->type;
+			col->k = conn->headers[ ci ]->label;
+			col->v = &( (unsigned char *)file->map)[ p->pos ];
+			col->len = p->size - 1;
+
+			// Check the actual type against the expected type
+			// (anything the expected type widens over, like integers in a double column, is fine)
+			// Dates are parsed once here, so writers can use col->date
+			if ( etype == T_DATE && col->len && ( col->dated = date_from_text( col->v, col->len, &col->date ) ) )
+				col->type = T_DATE;
+			else if ( ( col->type = get_type( col->v, etype, col->len ) ) != etype && widen_type( etype, col->type ) != etype ) {
+				// If I'm supposed to have a boolean and it comes back as an INTEGER, this isn't a problem if the value is right
+				if ( col->type == T_INTEGER && etype == T_BOOLEAN ) {
+					// You'll have to convert the number and see if it's a 0 or 1
+					int check = usafecpynumeric( col->v, col->len ); 
+					if ( check > 1 || check < 0 ) {
+						const char fmt[] = "Type check for value at row %d, column '%s' (%d) failed. (Expected T_BOOLEAN, got T_INTEGER)";
+						snprintf( err, errlen, fmt, line + 1, col->k, ci + 1 );
+						return 0;
+					} 
+					const char fmt[] = "WARNING: Value at row %d, column '%s' (%d). Expected T_BOOLEAN got T_INTEGER\n";
+					fprintf( stderr, fmt, line + 1, col->k, ci + 1 );
+				}
+
+				// Anything else is a failure for now
+				else {
+					const char fmt[] = "Type check for value at row %d, column '%s' (%d) failed. (Expected %s, got %s)";
+					snprintf( err, errlen, fmt, line + 1, col->k, ci + 1, itypes[ etype ], itypes[ col->type ] );
+					return 0;
+				}
+			}
+
+			// A decimal inferred from a sample can't round a value with more digits than the sample had
+			if ( etype == T_DECIMAL && conn->headers[ ci ]->precision && ( col->type == T_INTEGER || col->type == T_DOUBLE || col->type == T_DECIMAL ) ) {
+				header_t *h = conn->headers[ ci ];
+				int len = 0;
+				const unsigned char *v = trim( (unsigned char *)col->v, " ", col->len, &len );
+				const unsigned char *dot = memchr( v, '.', len );
+				int whole = ( ( dot ) ? dot - v : len ) - ( *v == '-' || *v == '+' ), scale = ( dot ) ? len - ( dot - v ) - 1 : 0;
+				if ( scale > h->scale || whole > h->precision - h->scale ) {
+					const char fmt[] = "Type check for value at row %d, column '%s' (%d) failed. (%.*s doesn't fit in DECIMAL(%d,%d), try --sample all)";
+					snprintf( err, errlen, fmt, line + 1, col->k, ci + 1, len, v, h->precision, h->scale );
+					return 0;
+				}
+			}
+
+			// Add columns and increase column count
+			add_item( &cols, col, column_t *, &clen );
+			ci++;
+
+			// Increment line
+			if ( p->chr == '\n' ) {
+				// Allocate one row
+				if ( !( row = malloc( sizeof( row_t ) ) ) || !memset( row, 0, sizeof( row_t ) ) ) {
+					const char fmt[] = "Out of memory when allocating space for new row at line %d: %s";
+					snprintf( err, errlen, fmt, line, strerror( errno ) );
+					return 0;
+				}
+
+				// Add an item to said row
+				row->columns = cols;
+				add_item( &conn->rows, row, row_t *, &conn->rlen );
+				cols = NULL, clen = 0, ci = 0, line++;
+			}
+		}
+	}
+#ifdef BMYSQL_H
+	else if ( conn->type == DB_MYSQL ) {
+		// Cast
+		mysql_t *b = (mysql_t *)conn->conn;
+
+		if ( !b ) {
+			const char fmt[] = "mysql() connection lost";
+			snprintf( err, errlen, fmt );
+			return 0;
+		}
+
+		// Rows arrive one at a time, so stop when this batch is full or the results run out
+		for ( unsigned int i = 0; i < count; i++ ) {
+			MYSQL_ROW r = mysql_fetch_row( b->res );
+			row_t *row = NULL;
+			column_t **cols = NULL;
+			unsigned long *lens = NULL, size = 0;
+			unsigned char *data = NULL, *block = NULL;
+
+			if ( !r && mysql_errno( b->conn ) ) {
+				const char fmt[] = "Failed to fetch row %lu: %s";
+				snprintf( err, errlen, fmt, conn->rtotal + i, mysql_error( b->conn ) );
+				return 0;
+			}
+			else if ( !r ) {
+				break;
+			}
+
+			// The row buffer is reused by the next fetch, so keep a copy of each value
+			lens = mysql_fetch_lengths( b->res );
+			for ( int ci = 0; ci < conn->hlen; ci++ ) {
+				size += lens[ ci ] + 1;
+			}
+
+			if ( !( block = data = malloc( size ) ) ) {
+				const char fmt[] = "Out of memory when copying row %d: %s";
+				snprintf( err, errlen, fmt, i, strerror( errno ) );
+				return 0;
+			}
+
+			// Move through each column
+			for ( int ci = 0, clen = 0; ci < conn->hlen; ci++ ) {
+				// Define
+				column_t *col = malloc( sizeof( column_t ) );
+
+				// Check for alloc failure
+				if ( !col || !memset( col, 0, sizeof( column_t ) ) ) {
+					const char fmt[] = "Out of memory when allocating space for entry at row %d, column %d: %s";
+					snprintf( err, errlen, fmt, i, ci, strerror( errno ) );
+					return 0;
+				}
+
+				// Set the values (NULL stays NULL)
+				col->k = conn->headers[ ci ]->label;
+				col->v = NULL;
+				if ( *r ) {
+					col->v = memcpy( data, *r, lens[ ci ] ), data[ lens[ ci ] ] = '\0';
+					data += lens[ ci ] + 1;
+				}
+				col->len = lens[ ci ];
+				// This only gets the basetype
+				col->type = conn->headers[ ci ]->type;
+#if 0
+				// If it's a date, then let's just see what's in the engine for now
+				if ( col->type == T_DATE ) {
+					date_t *d = &col->date;
+					memset( d, 0, sizeof( date_t ) );
+					unsigned char *v = col->v;
+					typemap_t *x = conn->headers[ ci ]->ntype;
+
+					if ( x->ntype == MYSQL_TYPE_YEAR ) {
+						d->year = usafecpynumeric( v, 4 );  
+					}
+					else if ( x->ntype == MYSQL_TYPE_DATE ) {
+						d->year = usafecpynumeric( v, 4 ), v += 5;
+						d->month = usafecpynumeric( v, 2 ), v += 3;
+						d->day = usafecpynumeric( v, 2 );
+					}
+					else if ( x->ntype == MYSQL_TYPE_TIME ) {
+						// Check if the hour is 3 lengths
+						d->hour = usafecpynumeric( v, 2 ), v += 3;
+						d->minute = usafecpynumeric( v, 2 ), v += 3;
+						d->second = usafecpynumeric( v, 2 );
+					}
+					else if ( x->ntype == MYSQL_TYPE_TIMESTAMP || x->ntype == MYSQL_TYPE_DATETIME ) {
+						d->year = usafecpynumeric( v, 4 ), v += 5;
+						d->month = usafecpynumeric( v, 2 ), v += 3;
+						d->day = usafecpynumeric( v, 2 ), v += 3;
+						// Check if the hour is 3 lengths
+						d->hour = usafecpynumeric( v, 2 ), v += 3;
+						d->minute = usafecpynumeric( v, 2 ), v += 3;
+						d->second = usafecpynumeric( v, 2 );
+					}
+				}
+#endif
+				// Add to the column set
+				add_item( &cols, col, column_t *, &clen );
+				r++;
+			}
+
+			// Add a new row
+			if ( !( row = malloc( sizeof( row_t ) ) ) || !memset( row, 0, sizeof( row_t ) ) ) {
+				const char fmt[] = "Out of memory when allocating space for row %d at cursor: %s";
+				snprintf( err, errlen, fmt, i, strerror( errno ) );
+				return 0;
+			}
+
+			// Add an item to said row
+			row->columns = cols;
+			row->data = block;
+			add_item( &conn->rows, row, row_t *, &conn->rlen );
+			cols = NULL;
+		}
+	}
+#endif
+#ifdef BSQLITE_H
+	else if ( conn->type == DB_SQLITE ) {
+		sqlite3_t *b = (sqlite3_t *)conn->conn;
+
+		// open_dsn() stepped to the first row, and each row here steps to the next
+		for ( int i = 0; i < count && b->status == SQLITE_ROW; i++ ) {
+			row_t *row = NULL;
+			column_t **cols = NULL;
+			unsigned long size = 0;
+			unsigned char *data = NULL, *block = NULL;
+
+			// Values are only good until the next step, so each row keeps one copy of them
+			for ( int ci = 0; ci < conn->hlen; ci++ ) {
+				if ( sqlite3_column_type( b->stmt, ci ) != SQLITE_BLOB ) {
+					sqlite3_column_text( b->stmt, ci );
+				}
+				size += sqlite3_column_bytes( b->stmt, ci ) + 1;
+			}
+
+			if ( !( block = data = malloc( size ) ) ) {
+				const char fmt[] = "Out of memory when copying row %d: %s";
+				snprintf( err, errlen, fmt, i, strerror( errno ) );
+				return 0;
+			}
+
+			for ( int ci = 0, clen = 0; ci < conn->hlen; ci++ ) {
+				column_t *col = malloc( sizeof( column_t ) );
+				int ctype = sqlite3_column_type( b->stmt, ci );
+
+				if ( !col || !memset( col, 0, sizeof( column_t ) ) ) {
+					const char fmt[] = "Out of memory when allocating space for entry at row %d, column %d: %s";
+					snprintf( err, errlen, fmt, i, ci, strerror( errno ) );
+					return 0;
+				}
+
+				// Set the values (NULL stays NULL)
+				col->k = conn->headers[ ci ]->label;
+				col->type = conn->headers[ ci ]->type;
+				if ( ctype != SQLITE_NULL ) {
+					const void *v = ( ctype == SQLITE_BLOB ) ? sqlite3_column_blob( b->stmt, ci ) : sqlite3_column_text( b->stmt, ci );
+					col->len = sqlite3_column_bytes( b->stmt, ci );
+					col->v = memcpy( data, v, col->len ), data[ col->len ] = '\0';
+					data += col->len + 1;
+				}
+
+				add_item( &cols, col, column_t *, &clen );
+			}
+
+			if ( !( row = malloc( sizeof( row_t ) ) ) || !memset( row, 0, sizeof( row_t ) ) ) {
+				const char fmt[] = "Out of memory when allocating space for row %d at cursor: %s";
+				snprintf( err, errlen, fmt, i, strerror( errno ) );
+				return 0;
+			}
+
+			row->columns = cols;
+			row->data = block;
+			add_item( &conn->rows, row, row_t *, &conn->rlen );
+
+			b->status = sqlite3_step( b->stmt );
+		}
+
+		if ( b->status != SQLITE_ROW && b->status != SQLITE_DONE ) {
+			const char fmt[] = "Failed to fetch row %lu: %s";
+			snprintf( err, errlen, fmt, conn->rtotal + conn->rlen, sqlite3_errmsg( b->conn ) );
+			return 0;
+		}
+	}
+#endif
+#ifdef BPGSQL_H
+ #if 1
+	else if ( conn->type == DB_POSTGRESQL )  {
+		pgsql_t *b = (pgsql_t *)conn->conn;
+		int rcount = 0;
+
+		// COPY sends one row per message
+		if ( b->copyout ) {
+			for ( int i = 0; !b->copydone && i < count; i++ ) {
+				char *buf = NULL;
+				row_t *row = NULL;
+				int len = PQgetCopyData( b->conn, &buf, 0 );
+
+				// -1 is the end of the COPY, and the result says whether it all worked
+				if ( len == -1 ) {
+					PGresult *res = NULL;
+					b->copydone = 1;
+					while ( ( res = PQgetResult( b->conn ) ) ) {
+						if ( PQresultStatus( res ) != PGRES_COMMAND_OK ) {
+							snprintf( err, errlen, "COPY failed: %s", PQresultErrorMessage( res ) );
+							PQclear( res );
+							return 0;
+						}
+						PQclear( res );
+					}
+					break;
+				}
+				else if ( len < 0 ) {
+					snprintf( err, errlen, "COPY failed: %s", PQerrorMessage( b->conn ) );
+					return 0;
+				}
+
+				if ( !( row = row_from_pgsql_copy( conn, buf, len, b->copyout, err, errlen ) ) ) {
+					return 0;
+				}
+				add_item( &conn->rows, row, row_t *, &conn->rlen );
+			}
+			return 1;
+		}
+
+		// open_dsn() fetched the first batch, every other one is fetched here.
+		// Values point into the result, so the last batch's rows must be gone by now.
+		if ( b->consumed && !fetch_pgsql_batch( conn, count, err, errlen ) ) {
+			return 0;
+		}
+
+		b->consumed = 1;
+		rcount = ( b->res ) ? PQntuples( b->res ) : 0;
+		for ( int i = 0; i < rcount; i++ ) {
+			row_t *row = NULL;
+			column_t **cols = NULL;
+
+			for ( int ci = 0, clen = 0; ci < conn->hlen; ci++ ) {
+				// Define
+				column_t *col = malloc( sizeof( column_t ) );
+
+				// Check for alloc failure
+				if ( !col || !memset( col, 0, sizeof( column_t ) ) ) {
+					const char fmt[] = "Out of memory when allocating space for entry at row %d, column %d: %s";
+					snprintf( err, errlen, fmt, i, ci, strerror( errno ) );
+					return 0;
+				}
+
+				// Set the value, column name and more for the record
+				col->k = conn->headers[ ci ]->label;
+				col->len = PQgetlength( b->res, i, ci );
+				col->type = conn->headers[ ci ]->type;
+			#if 1
+				col->v = (unsigned char *)PQgetvalue( b->res, i, ci );
+				if ( b->binary && !PQgetisnull( b->res, i, ci ) ) {
+					value_from_pgsql_binary( col, PQftype( b->res, ci ) );
+				}
+			#else
+				// If the network connection cuts out, it's very possible that this data will be gone
+				//col->v = (unsigned char *)strdup( PQgetvalue( conn->res, i, ci ) );
+			#endif
+
+#if 0
+				// If it's a date, then let's just see what's in the engine for now
+				if ( col->type == T_DATE ) {
+					date_t *d = &col->date;
+					memset( d, 0, sizeof( date_t ) );
+					unsigned char *v = col->v;
+					typemap_t *x = conn->headers[ ci ]->ntype;
+
+//DPRINTF( "Field %-10s is a date (type %d %s)!\n", col->k, x->ntype, x->libtypename );
+//write( 2, "'", 1 ), write( 2, col->v, col->len ), write( 2, "'\n", 2 );
+					if ( x->ntype == PG_DATEOID ) {
+						d->year = usafecpynumeric( v, 4 ), v += 5;
+						d->month = usafecpynumeric( v, 2 ), v += 3;
+						d->day = usafecpynumeric( v, 2 );
+					}
+					else if ( x->ntype == PG_TIMEOID ) {
+						// Check if the hour is 3 lengths
+						d->hour = usafecpynumeric( v, 2 ), v += 3;
+						d->minute = usafecpynumeric( v, 2 ), v += 3;
+						d->second = usafecpynumeric( v, 2 );
+					}
+					else if ( x->ntype == PG_TIMESTAMPOID ) {
+						d->year = usafecpynumeric( v, 4 ), v += 5;
+						d->month = usafecpynumeric( v, 2 ), v += 3;
+						d->day = usafecpynumeric( v, 2 ), v += 3;
+						// Check if the hour is 3 lengths
+						d->hour = usafecpynumeric( v, 2 ), v += 3;
+						d->minute = usafecpynumeric( v, 2 ), v += 3;
+						d->second = usafecpynumeric( v, 2 );
+					}
+				}
+#endif
+				// Add it
+				add_item( &cols, col, column_t *, &clen );
+			}
+
+			// Add a new row
+			if ( !( row = malloc( sizeof( row_t ) ) ) || !memset( row, 0, sizeof( row_t ) ) ) {
+				const char fmt[] = "Out of memory when allocating space for row %d at cursor: %s";
+				snprintf( err, errlen, fmt, i, strerror( errno ) );
+				return 0;
+			}
+
+			// Add an item to said row
+			row->columns = cols;
+
+			// And add this row to rows
+			add_item( &conn->rows, row, row_t *, &conn->rlen );
+
+			// Reset everything
+			cols = NULL;
+		}
+	}
+#endif
+#endif
+
+	return 1;
+}
+
+
+
+/**
+ * static void free_batch ( batch_t *b ) 
+ *
+ * Free a batch of rows that was never written.
+ *
+ */
+static void free_batch ( batch_t *b ) {
+	for ( row_t **r = b->rows; r && *r; r++ ) {
+		destroy_row( *r );
+	}
+	free( b->rows );
+#ifdef BPGSQL_H
+	PQclear( b->res );
+#endif
+	memset( b, 0, sizeof( batch_t ) );
+}
+
+
+/**
+ * static void take_rows ( dsn_t *conn, batch_t *b ) 
+ *
+ * Move the rows just read from conn into a batch, along with the 
+ * Postgres result they point into, so the next read leaves them be.
+ *
+ */
+static void take_rows ( dsn_t *conn, batch_t *b ) {
+	b->rows = conn->rows, b->rlen = conn->rlen, b->first = conn->rtotal, b->res = NULL;
+	if ( conn->parallel ) {
+		b->res = conn->parallel->held, conn->parallel->held = NULL;
+	}
+#ifdef BPGSQL_H
+	else if ( conn->type == DB_POSTGRESQL && !( (pgsql_t *)conn->conn )->copyout ) {
+		pgsql_t *db = (pgsql_t *)conn->conn;
+		b->res = db->res, db->res = NULL;
+	}
+#endif
+	conn->rows = NULL, conn->rlen = 0;
+}
+
+
+/**
+ * static void * read_range ( void *arg ) 
+ *
+ * Thread reading one --parallel-read range into its reader's queue, 
+ * waiting whenever the writer is PARALLEL_DEPTH batches behind.
+ *
+ */
+static void * read_range ( void *arg ) {
+	reader_t *r = (reader_t *)arg;
+	parallel_t *p = r->p;
+	int ok = 1;
+
+#ifdef BMYSQL_H
+	if ( r->dsn.type == DB_MYSQL ) {
+		mysql_thread_init();
+	}
+#endif
+
+	for ( ;; ) {
+		batch_t b = { 0 };
+		if ( !( ok = records_from_dsn( &r->dsn, BATCH_SIZE, r->dsn.rtotal, r->err, sizeof( r->err ) ) ) || !r->dsn.rlen ) {
+			break;
+		}
+
+		take_rows( &r->dsn, &b );
+		r->dsn.rtotal += b.rlen;
+
+		pthread_mutex_lock( &p->lock );
+		while ( r->count == PARALLEL_DEPTH && !p->stop ) {
+			pthread_cond_wait( &p->changed, &p->lock );
+		}
+
+		if ( p->stop ) {
+			pthread_mutex_unlock( &p->lock );
+			free_batch( &b );
+			break;
+		}
+
+		r->queue[ ( r->head + r->count++ ) % PARALLEL_DEPTH ] = b;
+		pthread_cond_broadcast( &p->changed );
+		pthread_mutex_unlock( &p->lock );
+	}
+
+	pthread_mutex_lock( &p->lock );
+	r->done = ( ok ) ? 1 : -1;
+	pthread_cond_broadcast( &p->changed );
+	pthread_mutex_unlock( &p->lock );
+
+#ifdef BMYSQL_H
+	if ( r->dsn.type == DB_MYSQL ) {
+		mysql_thread_end();
+	}
+#endif
+	return NULL;
+}
+
+
+/**
+ * static int find_split_column ( dsn_t *conn, char *col, int collen, char *err, int errlen ) 
+ *
+ * Find a single column integer primary key to split --parallel-read
+ * ranges on.  `col` is left empty if the table doesn't have one.
+ *
+ */
+static int find_split_column ( dsn_t *conn, char *col, int collen, char *err, int errlen ) {
+	char query[ 1024 ] = { 0 }, name[ 2 * sizeof( conn->tablename ) + 1 ] = { 0 };
+
+	escape_dsn( conn, conn->tablename, name, sizeof( name ) );
+
+	if ( 0 ) ;
+#ifdef BPGSQL_H
+	else if ( conn->type == DB_POSTGRESQL ) {
+		const char fmt[] = 
+			"SELECT a.attname FROM pg_index i "
+			"JOIN pg_attribute a ON a.attrelid = i.indrelid AND a.attnum = i.indkey[ 0 ] "
+			"WHERE i.indrelid = '%s'::regclass AND i.indisprimary AND i.indnatts = 1 "
+			"AND a.atttypid IN ( 'int2'::regtype, 'int4'::regtype, 'int8'::regtype )";
+		snprintf( query, sizeof( query ), fmt, name );
+	}
+#endif
+#ifdef BMYSQL_H
+	else if ( conn->type == DB_MYSQL ) {
+		const char fmt[] = 
+			"SELECT MIN( k.COLUMN_NAME ) FROM information_schema.KEY_COLUMN_USAGE k "
+			"JOIN information_schema.COLUMNS c USING ( TABLE_SCHEMA, TABLE_NAME, COLUMN_NAME ) "
+			"WHERE k.TABLE_SCHEMA = DATABASE() AND k.TABLE_NAME = '%s' AND k.CONSTRAINT_NAME = 'PRIMARY' "
+			"AND c.DATA_TYPE IN ( 'tinyint', 'smallint', 'mediumint', 'int', 'bigint' ) "
+			"HAVING COUNT(*) = ( SELECT COUNT(*) FROM information_schema.KEY_COLUMN_USAGE "
+			"WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '%s' AND CONSTRAINT_NAME = 'PRIMARY' ) "
+			"AND COUNT(*) = 1";
+		snprintf( query, sizeof( query ), fmt, name, name );
+	}
+#endif
+
+	*col = '\0';
+	return query_dsn( conn, query, col, collen, err, errlen );
+}
+
+
+/**
+ * int start_readers ( dsn_t *conn, config_t *conf, char *err, int errlen ) 
+ *
+ * Split the input table into conf->wparallel ranges and start a 
+ * connection reading each one.  Ranges come from an integer primary 
+ * key (or --split-column), or on Postgres from ctid when there is no 
+ * such key.  With --ordered each range is sorted and handed over in 
+ * turn, otherwise batches go out in whatever order they arrive.
+ *
+ */
+int start_readers ( dsn_t *conn, config_t *conf, char *err, int errlen ) {
+	parallel_t *p = NULL;
+	char col[ 128 ] = { 0 }, lo[ 64 ] = { 0 }, hi[ 64 ] = { 0 }, query[ 512 ] = { 0 };
+	long long min = 0, max = 0, step = 0;
+	int ctid = 0;
+
+	if ( conn->type != DB_POSTGRESQL && conn->type != DB_MYSQL ) {
+		snprintf( err, errlen, "--parallel-read only works with MySQL and Postgres input" );
+		return 0;
+	}
+	else if ( conf->wquery ) {
+		snprintf( err, errlen, "--parallel-read needs a table to split, not --query" );
+		return 0;
+	}
+	else if ( conf->wlimit || conf->woffset ) {
+		snprintf( err, errlen, "--parallel-read can't be combined with --limit or --offset" );
+		return 0;
+	}
+
+	if ( conf->wsplitcol )
+		snprintf( col, sizeof( col ), "%s", conf->wsplitcol );
+	else if ( !find_split_column( conn, col, sizeof( col ), err, errlen ) ) {
+		return 0;
+	}
+
+	if ( *col ) {
+		snprintf( query, sizeof( query ), "SELECT MIN( %s ) FROM %s", col, conn->tablename );
+		if ( !query_dsn( conn, query, lo, sizeof( lo ), err, errlen ) ) {
+			return 0;
+		}
+
+		snprintf( query, sizeof( query ), "SELECT MAX( %s ) FROM %s", col, conn->tablename );
+		if ( !query_dsn( conn, query, hi, sizeof( hi ), err, errlen ) ) {
+			return 0;
+		}
+
+		// An empty table gives NULL for both, and any single range will do
+		if ( ( *lo || *hi ) && ( !int_from_text( (unsigned char *)lo, strlen( lo ), &min ) 
+			|| !int_from_text( (unsigned char *)hi, strlen( hi ), &max ) ) ) {
+			snprintf( err, errlen, "Column '%s' can't split --parallel-read ranges, it must be an integer", col );
+			return 0;
+		}
+	}
+#ifdef BPGSQL_H
+	else if ( conn->type == DB_POSTGRESQL ) {
+		// No key, so split on the pages of the table itself
+		char name[ 2 * sizeof( conn->tablename ) + 1 ] = { 0 };
+		escape_dsn( conn, conn->tablename, name, sizeof( name ) );
+		snprintf( query, sizeof( query ), "SELECT pg_relation_size( '%s' ) / current_setting( 'block_size' )::int", name );
+		if ( !query_dsn( conn, query, hi, sizeof( hi ), err, errlen ) ) {
+			return 0;
+		}
+		max = atoll( hi ), ctid = 1;
+		snprintf( col, sizeof( col ), "ctid" );
+	}
+#endif
+	else {
+		const char fmt[] = "Table '%s' has no single column integer primary key, use --split-column";
+		snprintf( err, errlen, fmt, conn->tablename );
+		return 0;
+	}
+
+	if ( !( p = malloc( sizeof( parallel_t ) ) ) || !memset( p, 0, sizeof( parallel_t ) )
+		|| !( p->readers = malloc( sizeof( reader_t ) * conf->wparallel ) ) ) {
+		snprintf( err, errlen, "Out of memory when starting --parallel-read: %s", strerror( errno ) );
+		free( p );
+		return 0;
+	}
+
+	memset( p->readers, 0, sizeof( reader_t ) * conf->wparallel );
+	pthread_mutex_init( &p->lock, NULL );
+	pthread_cond_init( &p->changed, NULL );
+	p->ordered = conf->wordered;
+	conn->parallel = p;
+
+	// Ranges are [ a, b ), with the first and last left open so nothing falls outside (NULLs go first)
+	step = (long long)( ( (unsigned long long)max - (unsigned long long)min ) / conf->wparallel ) + 1;
+	for ( int i = 0; i < conf->wparallel; i++, p->rlen++ ) {
+		reader_t *r = &p->readers[ i ];
+		char where[ 256 ] = { 0 };
+		long long a = min + ( step * i ), b = a + step;
+
+		if ( ctid && i == conf->wparallel - 1 ) 
+			snprintf( where, sizeof( where ), "ctid >= '(%lld,0)'", a );
+		else if ( ctid ) 
+			snprintf( where, sizeof( where ), "ctid >= '(%lld,0)' AND ctid < '(%lld,0)'", a, b );
+		else if ( !i ) 
+			snprintf( where, sizeof( where ), "( %s < %lld OR %s IS NULL )", col, b, col );
+		else if ( i == conf->wparallel - 1 ) 
+			snprintf( where, sizeof( where ), "%s >= %lld", col, a );
+		else {
+			snprintf( where, sizeof( where ), "%s >= %lld AND %s < %lld", col, a, col, b );
+		}
+
+		snprintf( r->query, sizeof( r->query ), "SELECT * FROM %s WHERE %s%s%s", 
+			conn->tablename, where, ( p->ordered ) ? " ORDER BY " : "", ( p->ordered ) ? col : "" );
+
+		// Each reader is a copy of the input with its own connection
+		memcpy( &r->dsn, conn, sizeof( dsn_t ) );
+		r->dsn.conn = NULL, r->dsn.rows = NULL, r->dsn.rlen = 0, r->dsn.rtotal = 0;
+		r->dsn.parallel = NULL, r->dsn.ddl = NULL, r->dsn.ddllen = 0, r->dsn.range = 1;
+		memcpy( &r->conf, conf, sizeof( config_t ) );
+		r->conf.wquery = r->query, r->conf.wparallel = 0;
+		r->p = p;
+
+		if ( !( r->dsn.connstr = strdup( conn->connstr ) ) || !open_dsn( &r->dsn, &r->conf, err, errlen ) ) {
+			return 0;
+		}
+	}
+
+	for ( int i = 0; i < p->rlen; i++ ) {
+		reader_t *r = &p->readers[ i ];
+		if ( pthread_create( &r->thread, NULL, read_range, r ) ) {
+			snprintf( err, errlen, "Failed to start --parallel-read thread: %s", strerror( errno ) );
+			return 0;
+		}
+		r->started = 1;
+	}
+
+	return 1;
+}
+
+
+/**
+ * int records_from_readers ( dsn_t *conn, char *err, int errlen ) 
+ *
+ * Take the next batch from the --parallel-read connections, leaving
+ * conn->rlen at 0 once every range has been read.
+ *
+ */
+int records_from_readers ( dsn_t *conn, char *err, int errlen ) {
+	parallel_t *p = conn->parallel;
+	reader_t *r = NULL;
+	batch_t b = { 0 };
+
+	// The last batch is written, so its result can go
+#ifdef BPGSQL_H
+	PQclear( p->held );
+#endif
+	p->held = NULL;
+
+	pthread_mutex_lock( &p->lock );
+	for ( ;; ) {
+		int finished = 1;
+
+		// One failed range fails the whole read
+		for ( int i = 0; i < p->rlen; i++ ) {
+			if ( p->readers[ i ].done < 0 ) {
+				snprintf( err, errlen, "%s", p->readers[ i ].err );
+				pthread_mutex_unlock( &p->lock );
+				return 0;
+			}
+		}
+
+		if ( p->ordered ) {
+			// Ranges are handed over in order, moving on once one is drained
+			for ( ; p->next < p->rlen && p->readers[ p->next ].done && !p->readers[ p->next ].count; p->next++ );
+			if ( ( finished = ( p->next == p->rlen ) ) == 0 && p->readers[ p->next ].count ) {
+				r = &p->readers[ p->next ];
+			}
+		}
+		else {
+			// Otherwise take from whoever has something, round robin
+			for ( int i = 0; i < p->rlen && !r; i++ ) {
+				reader_t *c = &p->readers[ ( p->next + i ) % p->rlen ];
+				finished &= ( c->done && !c->count );
+				if ( c->count ) {
+					r = c, p->next = ( p->next + i + 1 ) % p->rlen;
+				}
+			}
+		}
+
+		if ( r || finished ) {
+			break;
+		}
+		pthread_cond_wait( &p->changed, &p->lock );
+	}
+
+	if ( r ) {
+		b = r->queue[ r->head ];
+		r->head = ( r->head + 1 ) % PARALLEL_DEPTH, r->count--;
+		pthread_cond_broadcast( &p->changed );
+	}
+	pthread_mutex_unlock( &p->lock );
+
+	conn->rows = b.rows, conn->rlen = b.rlen, p->held = b.res;
+	return 1;
+}
+
+
+/**
+ * void stop_readers ( dsn_t *conn ) 
+ *
+ * Stop the --parallel-read connections and free whatever they still
+ * have queued.
+ *
+ */
+void stop_readers ( dsn_t *conn ) {
+	parallel_t *p = conn->parallel;
+
+	pthread_mutex_lock( &p->lock );
+	p->stop = 1;
+	pthread_cond_broadcast( &p->changed );
+	pthread_mutex_unlock( &p->lock );
+
+	for ( int i = 0; i < p->rlen; i++ ) {
+		reader_t *r = &p->readers[ i ];
+		if ( r->started ) {
+			pthread_join( r->thread, NULL );
+		}
+
+		for ( ; r->count; r->head = ( r->head + 1 ) % PARALLEL_DEPTH, r->count-- ) {
+			free_batch( &r->queue[ r->head ] );
+		}
+
+		destroy_dsn_rows( &r->dsn );
+		close_dsn( &r->dsn );
+	}
+
+#ifdef BPGSQL_H
+	PQclear( p->held );
+#endif
+	pthread_cond_destroy( &p->changed );
+	pthread_mutex_destroy( &p->lock );
+	free( p->readers );
+	free( p );
+	conn->parallel = NULL;
+}
+
+
+
+/**
+ * static void report_unwritten ( batch_t *b ) 
+ *
+ * Say which rows of a batch never made it to a --parallel-write output.
+ *
+ */
+static void report_unwritten ( batch_t *b ) {
+	fprintf( stderr, "Rows %lu to %lu were not written.\n", b->first + 1, b->first + b->rlen );
+}
+
+
+/**
+ * static int write_batch ( writer_t *wr, batch_t *b, char *err, int errlen ) 
+ *
+ * Write one batch in its own transaction.  Postgres gets a COPY per 
+ * batch and MySQL uses the writer's prepared statement.
+ *
+ */
+static int write_batch ( writer_t *wr, batch_t *b, char *err, int errlen ) {
+	int ok = 1;
+
+	wr->source.rows = b->rows, wr->source.rlen = b->rlen;
+	if ( !query_dsn( &wr->dsn, "BEGIN", NULL, 0, err, errlen ) ) {
+		return 0;
+	}
+
+#ifdef BPGSQL_H
+	if ( wr->dsn.type == DB_POSTGRESQL ) {
+		pgsql_t *db = (pgsql_t *)wr->dsn.conn;
+		if ( ( ok = db->copy = start_pgsql_copy( &wr->dsn, &wr->source, "", err, errlen ) ) ) {
+			ok = transform_from_dsn( &wr->source, &wr->dsn, 0, b->first, err, errlen );
+			db->copy = 0;
+			if ( ok ) 
+				ok = end_pgsql_copy( db, err, errlen );
+			else {
+				PGresult *res = NULL;
+				PQputCopyEnd( db->conn, "batch failed" );
+				while ( ( res = PQgetResult( db->conn ) ) ) PQclear( res );
+			}
+		}
+	}
+	else
+#endif
+	{
+		ok = transform_from_dsn( &wr->source, &wr->dsn, 0, b->first, err, errlen );
+	}
+
+	wr->source.rows = NULL, wr->source.rlen = 0;
+	if ( !ok || !query_dsn( &wr->dsn, "COMMIT", NULL, 0, err, errlen ) ) {
+		query_dsn( &wr->dsn, "ROLLBACK", NULL, 0, NULL, 0 );
+		return 0;
+	}
+	return 1;
+}
+
+
+/**
+ * static void * write_batches ( void *arg ) 
+ *
+ * Thread writing batches from the --parallel-write queue until it is
+ * closed and empty, or until any writer fails.
+ *
+ */
+static void * write_batches ( void *arg ) {
+	writer_t *wr = (writer_t *)arg;
+	writers_t *w = wr->w;
+
+#ifdef BMYSQL_H
+	if ( wr->dsn.type == DB_MYSQL ) {
+		mysql_thread_init();
+	}
+#endif
+
+	for ( ;; ) {
+		batch_t b = { 0 };
+		int ok = 0;
+
+		pthread_mutex_lock( &w->lock );
+		while ( !w->count && !w->closed && !w->stop && !w->failed ) {
+			pthread_cond_wait( &w->changed, &w->lock );
+		}
+
+		if ( !w->count || w->stop || w->failed ) {
+			pthread_mutex_unlock( &w->lock );
+			break;
+		}
+
+		b = w->queue[ w->head ];
+		w->head = ( w->head + 1 ) % w->size, w->count--;
+		pthread_cond_broadcast( &w->changed );
+		pthread_mutex_unlock( &w->lock );
+
+		ok = write_batch( wr, &b, wr->err, sizeof( wr->err ) );
+
+		pthread_mutex_lock( &w->lock );
+		if ( ok ) 
+			w->acked += b.rlen;
+		else {
+			report_unwritten( &b );
+			if ( !w->failed ) {
+				w->failed = 1, w->failfirst = b.first + 1, w->faillast = b.first + b.rlen;
+				snprintf( w->err, sizeof( w->err ), "%s", wr->err );
+			}
+		}
+		pthread_cond_broadcast( &w->changed );
+		pthread_mutex_unlock( &w->lock );
+		free_batch( &b );
+	}
+
+#ifdef BMYSQL_H
+	if ( wr->dsn.type == DB_MYSQL ) {
+		mysql_thread_end();
+	}
+#endif
+	return NULL;
+}
+
+
+/**
+ * int start_writers ( dsn_t *oconn, dsn_t *iconn, config_t *conf, char *err, int errlen ) 
+ *
+ * Open conf->wwriters more connections to the output, each with its 
+ * own prepared statement, and start a thread writing for each one.
+ *
+ */
+int start_writers ( dsn_t *oconn, dsn_t *iconn, config_t *conf, char *err, int errlen ) {
+	writers_t *w = NULL;
+
+	if ( oconn->type != DB_POSTGRESQL && oconn->type != DB_MYSQL ) {
+		snprintf( err, errlen, "--parallel-write only works with MySQL and Postgres output" );
+		return 0;
+	}
+	else if ( conf->wstage ) {
+		snprintf( err, errlen, "--parallel-write can't load a --stage table, it lives in one transaction" );
+		return 0;
+	}
+
+	if ( !( w = malloc( sizeof( writers_t ) ) ) || !memset( w, 0, sizeof( writers_t ) )
+		|| !( w->writers = malloc( sizeof( writer_t ) * conf->wwriters ) )
+		|| !( w->queue = malloc( sizeof( batch_t ) * PARALLEL_DEPTH * conf->wwriters ) ) ) {
+		snprintf( err, errlen, "Out of memory when starting --parallel-write: %s", strerror( errno ) );
+		if ( w ) {
+			free( w->writers );
+		}
+		free( w );
+		return 0;
+	}
+
+	memset( w->writers, 0, sizeof( writer_t ) * conf->wwriters );
+	pthread_mutex_init( &w->lock, NULL );
+	pthread_cond_init( &w->changed, NULL );
+	w->size = PARALLEL_DEPTH * conf->wwriters;
+	oconn->writers = w;
+
+	for ( int i = 0; i < conf->wwriters; i++, w->wlen++ ) {
+		writer_t *wr = &w->writers[ i ];
+
+		// Each writer is a copy of the output with its own connection
+		memcpy( &wr->dsn, oconn, sizeof( dsn_t ) );
+		wr->dsn.conn = NULL, wr->dsn.writers = NULL, wr->dsn.ddl = NULL, wr->dsn.ddllen = 0;
+		memset( wr->dsn.bulkstate, 0, sizeof( wr->dsn.bulkstate ) );
+
+		// ...and reads its batches through a copy of the input
+		memcpy( &wr->source, iconn, sizeof( dsn_t ) );
+		wr->source.rows = NULL, wr->source.rlen = 0, wr->source.parallel = NULL;
+		wr->w = w;
+
+		// stop_writers() only sees the first w->wlen, so a writer that fails here cleans up itself
+		if ( !( wr->dsn.connstr = strdup( oconn->connstr ) ) || !open_dsn( &wr->dsn, conf, err, errlen ) 
+			|| !prepare_dsn_for_write( &wr->dsn, iconn, err, errlen ) ) {
+			close_dsn( &wr->dsn );
+			return 0;
+		}
+	}
+
+	for ( int i = 0; i < w->wlen; i++ ) {
+		writer_t *wr = &w->writers[ i ];
+		if ( pthread_create( &wr->thread, NULL, write_batches, wr ) ) {
+			snprintf( err, errlen, "Failed to start --parallel-write thread: %s", strerror( errno ) );
+			return 0;
+		}
+		wr->started = 1;
+	}
+
+	return 1;
+}
+
+
+/**
+ * int queue_rows ( dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) 
+ *
+ * Hand the rows just read to the --parallel-write connections, waiting 
+ * for room in the queue.  The rows are counted in iconn->rtotal here, 
+ * since they are gone from iconn afterwards.
+ *
+ */
+int queue_rows ( dsn_t *iconn, dsn_t *oconn, char *err, int errlen ) {
+	writers_t *w = oconn->writers;
+	batch_t b = { 0 };
+
+	take_rows( iconn, &b );
+	iconn->rtotal += b.rlen;
+
+	pthread_mutex_lock( &w->lock );
+	while ( w->count == w->size && !w->failed ) {
+		pthread_cond_wait( &w->changed, &w->lock );
+	}
+
+	if ( w->failed ) {
+		const char fmt[] = "Rows %lu to %lu failed: %s";
+		snprintf( err, errlen, fmt, w->failfirst, w->faillast, w->err );
+		pthread_mutex_unlock( &w->lock );
+		report_unwritten( &b );
+		free_batch( &b );
+		return 0;
+	}
+
+	w->queue[ ( w->head + w->count++ ) % w->size ] = b;
+	pthread_cond_broadcast( &w->changed );
+	pthread_mutex_unlock( &w->lock );
+	return 1;
+}
+
+
+/**
+ * void stop_writers ( dsn_t *conn ) 
+ *
+ * Stop the --parallel-write connections, reporting any batches that
+ * were still queued.
+ *
+ */
+void stop_writers ( dsn_t *conn ) {
+	writers_t *w = conn->writers;
+
+	pthread_mutex_lock( &w->lock );
+	w->stop = 1;
+	pthread_cond_broadcast( &w->changed );
+	pthread_mutex_unlock( &w->lock );
+
+	for ( int i = 0; i < w->wlen; i++ ) {
+		writer_t *wr = &w->writers[ i ];
+		if ( wr->started ) {
+			pthread_join( wr->thread, NULL ), wr->started = 0;
+		}
+		unprepare_dsn( &wr->dsn );
+		close_dsn( &wr->dsn );
+	}
+
+	for ( ; w->count; w->head = ( w->head + 1 ) % w->size, w->count-- ) {
+		report_unwritten( &w->queue[ w->head ] );
+		free_batch( &w->queue[ w->head ] );
+	}
+
+	pthread_cond_destroy( &w->changed );
+	pthread_mutex_destroy( &w->lock );
+	free( w->queue );
+	free( w->writers );
+	free( w );
+	conn->writers = NULL;
+}
+
+
+/**
+ * int finish_writers ( dsn_t *conn, char *err, int errlen ) 
+ *
+ * Let the --parallel-write connections get through everything queued, 
+ * then close them.  Fails with the first failed batch's rows.
+ *
+ */
+int finish_writers ( dsn_t *conn, char *err, int errlen ) {
+	writers_t *w = conn->writers;
+	int ok = 1;
+
+	pthread_mutex_lock( &w->lock );
+	w->closed = 1;
+	pthread_cond_broadcast( &w->changed );
+	pthread_mutex_unlock( &w->lock );
+
+	for ( int i = 0; i < w->wlen; i++ ) {
+		if ( w->writers[ i ].started ) {
+			pthread_join( w->writers[ i ].thread, NULL ), w->writers[ i ].started = 0;
+		}
+	}
+
+	if ( w->failed ) {
+		const char fmt[] = "Rows %lu to %lu failed: %s (%lu rows were written)";
+		snprintf( err, errlen, fmt, w->failfirst, w->faillast, w->err, w->acked );
+		ok = 0;
+	}
+
+	stop_writers( conn );
+	return ok;
+}
+
+
+
+/**
+ * transform_from_dsn( dsn_t * )
+ *
+ * "Transform" the records into whatever output format you're looking for.
+ *
+ */
+int transform_from_dsn(
+	dsn_t *iconn,
+	dsn_t *oconn,
+	int count,
+	int offset,
+	char *err,
+	int errlen
+) {
+
+	// Define
+	WHERE();
+	char insfmt[ 256 ];
+	memset( insfmt, 0, sizeof( insfmt ) );
+
+	// Define any db specific stuff
+	int ri = 0;
+
+	// Loop through all rows
+	for ( row_t **row = iconn->rows; row && *row; row++, ri++ ) {
+		char ffmt[ MAX_STMT_SIZE ];
+		int first = *row == *iconn->rows;
+		int ci = 0, truth = 0;
+
+		// memset
+		memset( ffmt, 0, MAX_STMT_SIZE );
+
+	#ifdef BPGSQL_H
+		// Binary values from Postgres go back to text unless the output can bind them
+		if ( iconn->type == DB_POSTGRESQL && ( (pgsql_t *)iconn->conn )->binary ) {
+			keep_binary_t keep = NULL;
+			if ( oconn->stream == STREAM_PGSQL && !( (pgsql_t *)oconn->conn )->copy )
+				keep = pgsql_keeps_binary;
+		#ifdef BMYSQL_H
+			else if ( oconn->stream == STREAM_MYSQL )
+				keep = mysql_keeps_binary;
+		#endif
+
+			if ( !text_from_pgsql_row( *row, iconn->headers, oconn, keep, err, errlen ) ) {
+				return 0;
+			}
+		}
+	#endif
+
+		//Prefix
+		if ( oconn->type == DB_FILE ) {
+			file_t *file = (file_t *)oconn->conn;
+			( FF.prefix ) ? FDPRINTF( file->fd, FF.prefix ) : 0;
+
+			if ( oconn->stream == STREAM_PRINTF || oconn->stream == STREAM_COMMA ) 
+				;
+			else if ( oconn->stream == STREAM_CSTRUCT )
+				FDPRINTF( file->fd, &",{"[!( offset || !first )] );
+			else if ( oconn->stream == STREAM_CARRAY )
+				FDPRINTF( file->fd, &",{"[!( offset || !first )] );
+			else if ( oconn->stream == STREAM_JSON ) {
+				FDPRINTF( file->fd, &",{"[!( offset || !first )] );
+				( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
+			}
+			else if ( oconn->stream == STREAM_XML ) {
+				FF.pretty ? FDPRINTF( file->fd, "\t" ) : 0;
+				FDPRINTF( file->fd, "<" );
+				// TODO: Should this be auto-inferred?
+				FDPRINTF( file->fd, oconn->tablename );
+				FDPRINTF( file->fd, ">" );
+				( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
+				//( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
+			}
+			else if ( oconn->stream == STREAM_SQL ) {
+			#if 0
+				// Way faster to use what you've already written..., but you can't use the whole thing...
+				// You can prepare it if stream_SQL is chosen...
+			#else
+				FDPRINTF( file->fd, "INSERT INTO " );
+				FDPRINTF( file->fd, oconn->tablename );
+				FDPRINTF( file->fd, " (" );
+				for ( header_t **x = iconn->headers; x && *x; x++ ) {
+					( *iconn->headers != *x ) ? FDPRINTF( file->fd, "," ) : 0;
+					FDPRINTF( file->fd, (*x)->label );
+				}
+				FDPRINTF( file->fd, ") VALUES (" );
+			}
+			#endif
+		}
+
+		// Loop through each column
+		for ( column_t **col = (*row)->columns; col && *col; col++, ci++ ) {
+			int first = *col == *((*row)->columns);
+			if ( oconn->stream == STREAM_PRINTF ) {
+				file_t *file = (file_t *)oconn->conn;
+				FDPRINTF( file->fd, (*col)->k );
+				FDPRINTF( file->fd, " => " );
+				if ( (*col)->type == T_BOOLEAN && memchr( "Tt1", *(*col)->v, 3 ) )
+					FDPRINTF( file->fd, "true" );
+				else if ( (*col)->type == T_BOOLEAN && memchr( "Ff0", *(*col)->v, 3 ) )
+					FDPRINTF( file->fd, "false" );
+				else if ( (*col)->type == T_BINARY ) {
+					char bin[ 64 ];
+					memset( &bin, 0, sizeof( bin ) );
+					snprintf( bin, sizeof( bin ) - 1, "%p (%ld bytes)", (void *)(*col)->v, (*col)->len );
+					FDPRINTF( file->fd, bin );
+				}
+				else if ( (*col)->type == T_STRING || (*col)->type == T_CHAR ) {
+					FDPRINTF( file->fd, FF.leftdelim );
+					FDNPRINTF( file->fd, (*col)->v, (*col)->len );
+					FDPRINTF( file->fd, FF.rightdelim );
+				}
+			#if 0
+				else if ( (*col)->type == T_DATE ) {
+					// Try a custom date format?
+				}
+			#endif
+				else {
+					FDNPRINTF( file->fd, (*col)->v, (*col)->len );
+				}
+				FDPRINTF( file->fd, "\n" );
+			}
+			else if ( oconn->stream == STREAM_RAW ) {
+				file_t *file = (file_t *)oconn->conn;
+				( first ) ? 0 : FDPRINTF( file->fd, oconn->cold );
+				FDNPRINTF( file->fd, (*col)->v, (*col)->len );
 			}
 			else if ( oconn->stream == STREAM_XML ) {
 				file_t *file = (file_t *)oconn->conn;
@@ -3237,7 +8181,7 @@ int transform_from_dsn(
 					FDPRINTF( file->fd, "true" );
 				else if ( (*col)->type == T_BOOLEAN && (*col)->len && memchr( "Ff0", *(*col)->v, 3 ) )
 					FDPRINTF( file->fd, "false" );
-				else if ( (*col)->type == T_INTEGER || (*col)->type == T_DOUBLE ) 
+				else if ( (*col)->type == T_INTEGER || (*col)->type == T_DOUBLE || (*col)->type == T_DECIMAL ) 
 					FDNPRINTF( file->fd, (*col)->v, (*col)->len );
 				#if 0
 				else if ( (*col)->type == T_BINARY ) /* TODO: Write unicode sequences out */
@@ -3272,11 +8216,11 @@ int transform_from_dsn(
 					FDPRINTF( file->fd, (*col)->k );
 					FDPRINTF( file->fd, " = " );
 
-					if ( (*col)->type == T_INTEGER || (*col)->type == T_DOUBLE )
+					if ( (*col)->type == T_INTEGER || (*col)->type == T_DOUBLE || (*col)->type == T_DECIMAL )
 						FDNPRINTF( file->fd, (*col)->v, (*col)->len );
 					else if ( (*col)->type == T_NULL )
 						FDPRINTF( file->fd, "NULL" );
-					else if ( (*col)->type == T_STRING ) {
+					else if ( (*col)->type == T_STRING || (*col)->type == T_UUID ) {
 						FDPRINTF( file->fd, "\"" ),
 						FDNPRINTF( file->fd, (*col)->v, (*col)->len );
 						FDPRINTF( file->fd, "\"" );
@@ -3305,7 +8249,12 @@ int transform_from_dsn(
 				file_t *file = (file_t *)oconn->conn;
 				( first ) ? 0 : FDPRINTF( file->fd, "," );
 
-				if ( (*col)->type != T_STRING && (*col)->type != T_CHAR )
+				// Dates and UUIDs are quoted like strings, and blank non-strings are NULL like in JSON
+				if ( !(*col)->len && (*col)->type != T_STRING && (*col)->type != T_CHAR )
+					FDPRINTF( file->fd, "NULL" );
+				else if ( (*col)->type == T_BOOLEAN && bool_from_text( (*col)->v, (*col)->len, &truth ) )
+					FDPRINTF( file->fd, ( truth ) ? "TRUE" : "FALSE" );
+				else if ( (*col)->type != T_STRING && (*col)->type != T_CHAR && (*col)->type != T_DATE && (*col)->type != T_UUID )
 					FDNPRINTF( file->fd, (*col)->v, (*col)->len );
 			#if 0
 				else if ( (*col)->type == T_DATE ) {
@@ -3340,347 +8289,1037 @@ int transform_from_dsn(
 #if 0
 FDPRINTF ( 2, (*col)->k ), FDPRINTF ( 2, " = " ), FDNPRINTF( 2, (*col)->v, (*col)->len ), FDPRINTF ( 2, "\n" );
 #endif
-				// Deref and define
 				mysql_t *b = (mysql_t *)oconn->conn;
-				MYSQL_BIND *bind = &b->bindargs[ ci ];
-				bind->buffer = (*col)->v;
-				bind->is_null = NULL;
-				bind->length = &(*col)->len;
-				//bind->buffer_type = iconn->headers[ ci ]->ptype->ntype; 
-				bind->buffer_type = MYSQL_TYPE_STRING;
-
 DPRINTF( "Length of value for %s is: %ld\n", (*col)->k, (*col)->len );
-				if ( !(*col)->len && ( (*col)->type == T_INTEGER || (*col)->type == T_DOUBLE || (*col)->type == T_BOOLEAN ) ) {
-					//bind->buffer = (char *)null_keyword;
-					bind->buffer_type = MYSQL_TYPE_NULL;
-					//bind->length = (unsigned long *)&null_keyword_length;
-					//bind->buffer_length = 4;
+				if ( !bind_mysql_value( b, ci, *col, iconn->headers[ ci ]->ptype ) ) {
+					const char fmt[] = "Out of memory when binding values for MySQL: %s";
+					snprintf( err, errlen, fmt, strerror( errno ) );
+					return 0;
+				}
+			}
+		#endif
+		#ifdef BPGSQL_H
+			else if ( oconn->stream == STREAM_PGSQL ) {
+			#ifdef DEBUG_H
+				DPRINTF( "Binding value %p of length %ld at %d\n", (*col)->v, (*col)->len, ci );
+			#endif
+				pgsql_t *b = (pgsql_t *)oconn->conn;
+#if 0
+FDPRINTF ( 2, (*col)->k ), FDPRINTF ( 2, " = " ), FDNPRINTF( 2, (*col)->v, (*col)->len ), FDPRINTF ( 2, "\n" );
+#endif
+
+				// COPY writes the whole row at once below
+				if ( b->copy ) {
+					continue;
+				}
+
+DPRINTF( "Length of value for %s (%s) is: %ld\n", (*col)->k, itypes[ (*col)->type ], (*col)->len  );
+				// Size the scratch space for the whole row up front, since values point into it
+				if ( !ci ) {
+					int need = 0;
+					for ( column_t **c = (*row)->columns; c && *c; c++ ) {
+						need += (*c)->len + 16;
+					}
+
+					if ( need > b->argsize ) {
+						unsigned char *buf = NULL;
+						if ( !( buf = realloc( b->argbuf, need * 2 ) ) ) {
+							const char fmt[] = "Out of memory when binding values for Postgres: %s";
+							snprintf( err, errlen, fmt, strerror( errno ) );
+							return 0;
+						}
+						b->argbuf = buf, b->argsize = need * 2;
+					}
+					b->arglen = 0;
+				}
+
+				if ( !(*col)->len && (*col)->type != T_STRING && (*col)->type != T_BINARY && (*col)->type != T_CHAR ) {
+					b->bindlens[ ci ] = 0;
+					b->bindargs[ ci ] = NULL;
+					b->bindfmts[ ci ] = 0;
+				}
+				else {
+					b->arglen += bind_pgsql_value( b, ci, *col, iconn->headers[ ci ]->ptype, &b->argbuf[ b->arglen ] );
+				}
+			}
+		#endif
+		#ifdef BSQLITE_H
+			else if ( oconn->stream == STREAM_SQLITE ) {
+				sqlite3_t *b = (sqlite3_t *)oconn->conn;
+				if ( bind_sqlite_value( b->stmt, ci + 1, *col ) != SQLITE_OK ) {
+					const char fmt[] = "SQLite3 bind failure: '%s'";
+					snprintf( err, errlen, fmt, sqlite3_errmsg( b->conn ) );
+					return 0;
+				}
+			}
+		#endif
+		} // end for
+
+
+		/* End the string */
+		if ( oconn->type == DB_FILE ) {
+			file_t *file = (file_t *)oconn->conn;
+			// End the string
+			if ( oconn->stream == STREAM_PRINTF )
+				;//p_default( 0, ib->k, ib->v );
+			else if ( oconn->stream == STREAM_COMMA )
+				;//fprintf( oconn->output, " },\n" );
+			else if ( oconn->stream == STREAM_CSTRUCT )
+				FDPRINTF( file->fd, "}" );
+			else if ( oconn->stream == STREAM_CARRAY )
+				FDPRINTF( file->fd, " }" );
+			else if ( oconn->stream == STREAM_SQL )
+				FDPRINTF( file->fd, " );" );
+			else if ( oconn->stream == STREAM_JSON ) {
+				FDPRINTF( file->fd, "}" ); // count will depend on where in the stream
+				( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
+			}
+			else if ( oconn->stream == STREAM_XML ) {
+				FF.pretty ? FDPRINTF( file->fd, "\t" ) : 0;
+				FDPRINTF( file->fd, "</" );
+				FDPRINTF( file->fd, oconn->tablename );
+				FDPRINTF( file->fd, ">" );
+				( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
+			}
+			else if ( oconn->stream == STREAM_RAW ) {
+				FDPRINTF( file->fd, oconn->rowd );
+			}	
+		}
+
+	#ifdef BMYSQL_H
+		else if ( oconn->stream == STREAM_MYSQL ) {
+			mysql_t *b = (mysql_t *)oconn->conn;
+		#if 0
+			int status = 0;
+			status = mysql_bind_param( oconn->conn, iconn->hlen, b->bindargs, NULL );
+			if ( status != 0 ) {
+				const char fmt[] = "MySQL bind failed: '%s'";
+				snprintf( err, errlen, fmt, mysql_error( oconn->conn )  );
+				return 0;
+			}
+
+			status = mysql_real_query( oconn->conn, ffmt, strlen( ffmt ) );
+			if ( status != 0 ) {
+				const char fmt[] = "MySQL real query failed: '%s'";
+				snprintf( err, errlen, fmt, mysql_error( oconn->conn )  );
+				return 0;
+			}
+		#else
+			// The statement was prepared in prepare_dsn_for_write(), and stays bound until a buffer moves
+			if ( b->rebind && mysql_stmt_bind_param( b->stmt, b->bindargs ) != 0 ) {
+				const char fmt[] = "MySQL bind failure: '%s'";
+				snprintf( err, errlen, fmt, mysql_stmt_error( b->stmt )  );
+				return 0;
+			}
+			b->rebind = 0;
+
+			//printf( "%p ?= %p %d\n", (void *)oconn->typemap, (void *)mysql_map, oconn->typemap == mysql_map );
+			if ( mysql_stmt_execute( b->stmt ) != 0 ) {
+				const char fmt[] = "MySQL statement exec failure: '%s'";
+				snprintf( err, errlen, fmt, mysql_stmt_error( b->stmt ) );
+				return 0;
+			}
+
+			WPRINTF( "MySQL commit successful.\n" );
+		#endif
+		}
+	#endif
+
+	#ifdef BPGSQL_H
+		else if ( oconn->stream == STREAM_PGSQL ) {
+			pgsql_t *b = (pgsql_t *)oconn->conn;
+
+			if ( b->copy ) {
+				if ( !copy_row_to_pgsql( b, *row, err, errlen ) ) {
+					return 0;
+				}
+				continue;
+			}
+
+			// The INSERT was prepared in prepare_dsn_for_write(), and typed by the table
+			PGresult *r = PQexecPrepared(
+				b->conn,
+				PG_INSERT_STMT,
+				iconn->hlen,
+				(const char * const *)b->bindargs,
+				b->bindlens,
+				(int *)b->bindfmts,
+				0
+			);
+
+			if ( PQresultStatus( r ) != PGRES_COMMAND_OK ) {
+				const char fmt[] = "PostgreSQL commit failed: %s";
+				snprintf( err, errlen, fmt, PQresultErrorMessage( r ) );
+				PQclear( r );
+				return 0;
+			}
+
+			WPRINTF( "Commit successful\n" );
+			PQclear( r );
+		}
+	#endif
+
+	#ifdef BSQLITE_H
+		else if ( oconn->stream == STREAM_SQLITE ) {
+			sqlite3_t *b = (sqlite3_t *)oconn->conn;
+
+			if ( sqlite3_step( b->stmt ) != SQLITE_DONE ) {
+				const char fmt[] = "SQLite3 insert failed: '%s'";
+				snprintf( err, errlen, fmt, sqlite3_errmsg( b->conn ) );
+				sqlite3_reset( b->stmt );
+				return 0;
+			}
+			sqlite3_reset( b->stmt );
+
+			// Keep transactions large, but don't let the journal grow forever
+			if ( ++b->pending >= SQLITE_TXN_ROWS ) {
+				if ( !query_dsn( oconn, "COMMIT", NULL, 0, err, errlen ) || !query_dsn( oconn, "BEGIN", NULL, 0, err, errlen ) ) {
+					return 0;
 				}
+				b->pending = 0;
+			}
+		}
+	#endif
+
+	#if 0
+		//Suffix
+		if ( oconn->type == DB_FILE ) {
+			file_t *file = (file_t *)oconn->conn;
+			( FF.suffix ) ? FDPRINTF( file->fd, FF.suffix ) : 0;
+			//( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
+		}
+	#endif
+	}
+
+	return 1;
+}
+
+
+
+/**
+ * close_dsn( dsn_t *conn )
+ *
+ * Closes a data source: `conn`.
+ *
+ */
+void close_dsn( dsn_t *conn ) {
+	WPRINTF( "Attempting to close %s at %p", conn->connstr, (void *)conn->conn );
 
-#if 0
-				//bind->buffer_length = (*col)->len;
-				// Use the approximate type as a base for the format
-				if ( (*col)->type == T_NULL )
-					bind->buffer_type = MYSQL_TYPE_STRING;
-				else if ( (*col)->type == T_BOOLEAN )
-					bind->buffer_type = MYSQL_TYPE_TINY;
-				else if ( (*col)->type == T_INTEGER )
-					bind->buffer_type = MYSQL_TYPE_DECIMAL;
-				else if ( (*col)->type == T_DOUBLE )
-					bind->buffer_type = MYSQL_TYPE_FLOAT; /* Doubles overflow? */
-				else if ( (*col)->type == T_STRING || (*col)->type == T_CHAR )
-					bind->buffer_type = MYSQL_TYPE_STRING, bind->buffer_length = (*col)->len;
-				else if ( (*col)->type == T_BINARY )
-					bind->buffer_type = MYSQL_TYPE_BLOB, bind->buffer_length = (*col)->len;
-#endif
-#if 0
-				if ( (*col)->type == T_STRING || (*col)->type == T_CHAR || (*col)->type == T_BINARY )
-					;//bind->buffer_length = (*col)->len;
-				else if ( (*col)->type == T_DATE ) {
-					MYSQL_TIME *ts = NULL;
-					// Allocate a new time structure and write stuff to i
-					if ( !( ts = malloc( sizeof( MYSQL_TIME ) ) ) || !memset( ts, 0, sizeof( MYSQL_TIME ) ) ) {
-						const char fmt[] = "Allocation error with MYSQL_TIME";
-						snprintf( err, errlen, fmt );
-						return 0;
-					}
+	if ( conn->parallel ) {
+		stop_readers( conn );
+	}
 
-					bind->buffer_type = iconn->headers[ ci ]->ptype->ntype;
-					bind->buffer = (char *)ts;
-					bind->buffer_length = 0;
-					bind->length = NULL;
-					ts->year = (*col)->date.year;
-					ts->month = (*col)->date.month;
-					ts->day = (*col)->date.day;
-					ts->hour = (*col)->date.hour;
-					ts->minute = (*col)->date.minute;
-					ts->second = (*col)->date.second;
-				}
-				// If it's null?  I'm not sure, should be a string anyway
-				else {
-					// any numeric type will have to be turned into a real value
+	if ( conn->writers ) {
+		stop_writers( conn );
+	}
 
-					// float
-					// double
-					// any integer type can be cast to a long (hopefully)
-				}
+	if ( conn->conn ) {
+		if ( conn->type == DB_FILE ) {
+			// Cast
+			file_t *file = (file_t *)conn->conn;
 
-				// May have to read and set a double or an integer, etc
-				else {
-					// Any numeric types?
-					//bind->buffer_length = 1;
-					bind->length = &iconn->headers[ ci ]->ptype->size;
-					bind->buffer = &somenum;
-				}
-				else {
-					// We ought to not get here...
-					const char fmt[] = "Invalid bind type";
-					snprintf( err, errlen, fmt );
-					return 0;
-				}
-#endif
+			// Free this
+			if ( file->start && munmap( (void *)file->start, file->size ) == -1 ) {
+				fprintf( stderr, "munmap() %s", strerror( errno ) );
 			}
-		#endif
-		#ifdef BPGSQL_H
-			else if ( oconn->stream == STREAM_PGSQL ) {
-			#ifdef DEBUG_H
-				DPRINTF( "Binding value %p of length %ld at %d\n", (*col)->v, (*col)->len, ci );
-			#endif
-				pgsql_t *b = (pgsql_t *)oconn->conn;
-#if 0
-FDPRINTF ( 2, (*col)->k ), FDPRINTF ( 2, " = " ), FDNPRINTF( 2, (*col)->v, (*col)->len ), FDPRINTF ( 2, "\n" );
-#endif
 
-DPRINTF( "Length of value for %s (%s) is: %ld\n", (*col)->k, itypes[ (*col)->type ], (*col)->len  );
-				// Bind and prepare an insert?
-				if ( !(*col)->len && (*col)->type != T_STRING && (*col)->type != T_BINARY && (*col)->type != T_CHAR ) {
-					b->bindlens[ ci ] = 0;
-					b->bindargs[ ci ] = NULL; //(char *)null_keyword; 
-					b->bindfmts[ ci ] = 0;
-				}
-				else if ( (*col)->type != T_BINARY ) {
-					char *v = NULL;
-					if ( !( v = malloc( (*col)->len + 1 ) ) || !memset( v, 0, (*col)->len + 1 ) ) {
-						const char fmt[] = "Out of memory when binding value at column %s for Postgres";
-						snprintf( err, errlen, fmt, iconn->headers[ ci ]->label );
-						return 0;
-					}
-					memcpy( v, (*col)->v, (*col)->len );
-					b->bindlens[ ci ] = (*col)->len;
-					b->bindargs[ ci ] = v; 
-					b->bindfmts[ ci ] = 0;
-				}
-				else {
-					// How do I fetch this differently?
-					b->bindargs[ ci ] = (char *)(*col)->v; 
-					b->bindlens[ ci ] = (*col)->len;
-					b->bindfmts[ ci ] = 1;
-				}
-#if 0
-				else if ( (*col)->type == T_DATE ) {
-					//date_t *d = &(*col)->date;	
-				} 
-#endif
-				
-			#if 1
-				//b->bindoids[ ci ] = 
-			#else
-				// Use the approximate type as a base for the format
-				if ( (*col)->type == T_NULL )
-					b->bindoids[ ci ] = PG_TEXTOID; 
-				else if ( (*col)->type == T_BOOLEAN )
-					b->bindoids[ ci ] = PG_BOOLOID; 
-				else if ( (*col)->type == T_STRING || (*col)->type == T_CHAR )
-					b->bindoids[ ci ] = PG_TEXTOID; 
-				else if ( (*col)->type == T_INTEGER )
-					b->bindoids[ ci ] = PG_INT4OID; 
-				else if ( (*col)->type == T_DOUBLE )
-					b->bindoids[ ci ] = PG_FLOAT4OID; 
-				else if ( (*col)->type == T_BINARY )
-					b->bindoids[ ci ] = PG_FLOAT4OID;
-				else if ( (*col)->type == T_DATE ) {
-					b->bindoids[ ci ] = PG_TIMESTAMPOID;
-					date_t d = (*col)->date;
-					if ( !d.year && !d.month && !d.year ) {
-						b->bindoids[ ci ] = PG_TIMEOID;
-					}
-				}
-				else {
-					// We ought to not get here...
-					const char fmt[] = "Invalid bind type";
-					snprintf( err, errlen, fmt );
-					return 0;
-				}
-			#endif
+			free( file->index );
+
+			// Close if the file is not stdout or in
+			if ( file->fd > 2 && close( file->fd ) == -1 ) {
+				fprintf( stderr, "close() %s", strerror( errno ) );
 			}
-		#endif
-		#if 0
-			else if ( oconn->stream == STREAM_SQLITE ) {
+
+			free( file );
+		}
+	#ifdef BSQLITE_H
+		else if ( conn->type == DB_SQLITE ) {
+			// Anything not committed by finish_dsn_for_write() is rolled back here
+			sqlite3_t *db = ( sqlite3_t *)conn->conn;
+			sqlite3_finalize( db->stmt );
+			restore_bulk_profile( conn );
+			sqlite3_close( db->conn );
+			free( db );
+		}
+	#endif
+	#ifdef BMYSQL_H
+		else if ( conn->type == DB_MYSQL ) {
+			mysql_t *db = ( mysql_t *)conn->conn;
+			restore_bulk_profile( conn );
+			mysql_free_result( db->res );
+			if ( db->stmt ) {
+				mysql_stmt_close( db->stmt );
 			}
-		#endif
-		} // end for
+			mysql_close( (MYSQL *)db->conn );
+			free( db );
+		}
+	#endif
+	#ifdef BPGSQL_H
+		else if ( conn->type == DB_POSTGRESQL ) {
+			pgsql_t *db = ( pgsql_t *)conn->conn;
+			restore_bulk_profile( conn );
+			PQclear( db->res );
+			PQfinish( (PGconn *)db->conn );
+			free( db );
+		}
+	#endif
+	}
 
+	// Anything left here failed to rebuild and was reported already
+	if ( conn->ddl ) {
+		destroy_dsn_ddl( conn );
+	}
 
-		/* End the string */
-		if ( oconn->type == DB_FILE ) {
-			file_t *file = (file_t *)oconn->conn;
-			// End the string
-			if ( oconn->stream == STREAM_PRINTF )
-				;//p_default( 0, ib->k, ib->v );
-			else if ( oconn->stream == STREAM_COMMA )
-				;//fprintf( oconn->output, " },\n" );
-			else if ( oconn->stream == STREAM_CSTRUCT )
-				FDPRINTF( file->fd, "}" );
-			else if ( oconn->stream == STREAM_CARRAY )
-				FDPRINTF( file->fd, " }" );
-			else if ( oconn->stream == STREAM_SQL )
-				FDPRINTF( file->fd, " );" );
-			else if ( oconn->stream == STREAM_JSON ) {
-				FDPRINTF( file->fd, "}" ); // count will depend on where in the stream
-				( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
-			}
-			else if ( oconn->stream == STREAM_XML ) {
-				FF.pretty ? FDPRINTF( file->fd, "\t" ) : 0;
-				FDPRINTF( file->fd, "</" );
-				FDPRINTF( file->fd, oconn->tablename );
-				FDPRINTF( file->fd, ">" );
-				( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
-			}
-			else if ( oconn->stream == STREAM_RAW ) {
-				FDPRINTF( file->fd, oconn->rowd );
-			}	
+	if ( conn->connstr ) {
+		free( conn->connstr );
+	}
+
+	conn->conn = NULL;
+}
+
+
+/**
+ * typedef struct digits_t 
+ *
+ * The digits seen in the numbers of one column, to tell decimals from
+ * doubles.
+ *
+ */
+typedef struct digits_t {
+	int whole; // most digits seen before the point
+	int scale; // and after it
+	int fixed; // the one scale every value with a point had, or -1 if they differed
+} digits_t;
+
+
+/**
+ * typedef struct topk_t 
+ *
+ * A value counted by a profile_t.  Values point into the input file.
+ * The count is never less than the real one, and at most err more.
+ *
+ */
+typedef struct topk_t {
+	const unsigned char *v;
+	unsigned int len;
+	unsigned long long h; // hash of the value, checked before the bytes
+	unsigned long count;
+	unsigned long err; // what the counter had when this value took it over
+} topk_t;
+
+
+/**
+ * typedef struct profile_t 
+ *
+ * Statistics for one column of a file, gathered by --profile.
+ *
+ */
+typedef struct profile_t {
+	unsigned long rows; // lines the column was read from
+	unsigned long values; // and how many of those weren't blank
+	unsigned long maxlen; // longest value in bytes
+	unsigned long ints, reals; // integers and other numbers seen
+	long long imin, imax; // range of the integers
+	double nmin, nmax; // range of all of the numbers
+	const unsigned char *smin, *smax; // first and last value in byte order
+	unsigned int sminlen, smaxlen;
+	unsigned char hll[ 1 << PROFILE_HLL_BITS ]; // HyperLogLog registers for distinct values
+	topk_t top[ PROFILE_SKETCH ]; // most common values, SpaceSaving style
+} profile_t;
+
+
+/**
+ * static int compare_text ( const unsigned char *a, unsigned int alen, const unsigned char *b, unsigned int blen ) 
+ *
+ * Compare two values that aren't NUL terminated, in byte order.
+ *
+ */
+static int compare_text ( const unsigned char *a, unsigned int alen, const unsigned char *b, unsigned int blen ) {
+	int cmp = memcmp( a, b, ( alen < blen ) ? alen : blen );
+	return ( cmp ) ? cmp : ( alen > blen ) - ( alen < blen );
+}
+
+
+/**
+ * static void profile_value ( profile_t *p, const unsigned char *v, unsigned int len, type_t t ) 
+ *
+ * Add one value of type t to a column's profile.
+ *
+ */
+static void profile_value ( profile_t *p, const unsigned char *v, unsigned int len, type_t t ) {
+	unsigned long long h = 14695981039346656037ULL;
+	unsigned int reg = 0;
+	unsigned char rho = 1;
+	long long n = 0;
+	double d = 0;
+	int number = 0;
+	topk_t *least = NULL;
+
+	if ( !len ) {
+		return;
+	}
+
+	p->values++;
+	p->maxlen = ( len > p->maxlen ) ? len : p->maxlen;
+
+	if ( t == T_INTEGER && ( number = int_from_text( v, len, &n ) ) ) {
+		p->imin = ( !p->ints || n < p->imin ) ? n : p->imin;
+		p->imax = ( !p->ints || n > p->imax ) ? n : p->imax;
+		d = (double)n;
+	}
+	else if ( t == T_DOUBLE ) {
+		number = double_from_text( v, len, &d );
+	}
+
+	if ( number ) {
+		p->nmin = ( !( p->ints + p->reals ) || d < p->nmin ) ? d : p->nmin;
+		p->nmax = ( !( p->ints + p->reals ) || d > p->nmax ) ? d : p->nmax;
+		p->ints += ( t == T_INTEGER ), p->reals += ( t != T_INTEGER );
+	}
+
+	if ( !p->smin || compare_text( v, len, p->smin, p->sminlen ) < 0 ) 
+		p->smin = v, p->sminlen = len;
+	if ( !p->smax || compare_text( v, len, p->smax, p->smaxlen ) > 0 ) {
+		p->smax = v, p->smaxlen = len;
+	}
+
+	// FNV-1a, then a finalizer so the register index bits are mixed too
+	for ( unsigned int i = 0; i < len; i++ ) {
+		h = ( h ^ v[ i ] ) * 1099511628211ULL;
+	}
+	h ^= h >> 33, h *= 0xff51afd7ed558ccdULL, h ^= h >> 33, h *= 0xc4ceb9fe1a85ec53ULL, h ^= h >> 33;
+
+	// Count the value if it's kept, or else it takes over the smallest counter (a free one is smallest)
+	for ( topk_t *k = p->top; k < p->top + PROFILE_SKETCH; k++ ) {
+		if ( k->count && k->h == h && k->len == len && !memcmp( k->v, v, len ) ) {
+			k->count++;
+			break;
+		}
+		least = ( !least || k->count < least->count ) ? k : least;
+		if ( !k->count ) {
+			k->v = v, k->len = len, k->h = h, k->count = 1, k->err = 0;
+			break;
+		}
+		else if ( k == p->top + PROFILE_SKETCH - 1 ) {
+			least->v = v, least->len = len, least->h = h, least->err = least->count++;
+		}
+	}
+
+	// The register is picked by the top bits, and keeps the longest run of zeroes after them
+	reg = h >> ( 64 - PROFILE_HLL_BITS ), h <<= PROFILE_HLL_BITS;
+	for ( ; rho <= 64 - PROFILE_HLL_BITS && !( h & ( 1ULL << 63 ) ); rho++, h <<= 1 );
+	p->hll[ reg ] = ( rho > p->hll[ reg ] ) ? rho : p->hll[ reg ];
+}
+
+
+/**
+ * static void sort_topk ( topk_t *top, int n ) 
+ *
+ * Sort counted values, most common first.
+ *
+ */
+static void sort_topk ( topk_t *top, int n ) {
+	for ( int i = 1; i < n; i++ ) {
+		topk_t t = top[ i ];
+		int j = i;
+		for ( ; j && top[ j - 1 ].count < t.count; j-- ) {
+			top[ j ] = top[ j - 1 ];
+		}
+		top[ j ] = t;
+	}
+}
+
+
+/**
+ * static void profile_merge ( profile_t *a, profile_t *b ) 
+ *
+ * Add the profile of a column in one chunk of a file to another.
+ *
+ */
+static void profile_merge ( profile_t *a, profile_t *b ) {
+	topk_t top[ PROFILE_SKETCH * 2 ];
+	int n = 0, an = 0;
+	unsigned long amin = 0, bmin = 0;
+
+	if ( b->ints + b->reals ) {
+		a->nmin = ( !( a->ints + a->reals ) || b->nmin < a->nmin ) ? b->nmin : a->nmin;
+		a->nmax = ( !( a->ints + a->reals ) || b->nmax > a->nmax ) ? b->nmax : a->nmax;
+	}
+
+	if ( b->ints ) {
+		a->imin = ( !a->ints || b->imin < a->imin ) ? b->imin : a->imin;
+		a->imax = ( !a->ints || b->imax > a->imax ) ? b->imax : a->imax;
+	}
+
+	if ( b->smin && ( !a->smin || compare_text( b->smin, b->sminlen, a->smin, a->sminlen ) < 0 ) ) 
+		a->smin = b->smin, a->sminlen = b->sminlen;
+	if ( b->smax && ( !a->smax || compare_text( b->smax, b->smaxlen, a->smax, a->smaxlen ) > 0 ) ) {
+		a->smax = b->smax, a->smaxlen = b->smaxlen;
+	}
+
+	a->rows += b->rows, a->values += b->values, a->ints += b->ints, a->reals += b->reals;
+	a->maxlen = ( b->maxlen > a->maxlen ) ? b->maxlen : a->maxlen;
+	for ( int i = 0; i < ( 1 << PROFILE_HLL_BITS ); i++ ) {
+		a->hll[ i ] = ( b->hll[ i ] > a->hll[ i ] ) ? b->hll[ i ] : a->hll[ i ];
+	}
+
+	// A value missing from a full sketch could have been counted up to its smallest counter there
+	for ( int i = 0; i < PROFILE_SKETCH; i++ ) {
+		amin = ( !i || a->top[ i ].count < amin ) ? a->top[ i ].count : amin;
+		bmin = ( !i || b->top[ i ].count < bmin ) ? b->top[ i ].count : bmin;
+	}
+
+	// Counters for the same value are added, then only the biggest are kept
+	for ( topk_t *k = a->top; k < a->top + PROFILE_SKETCH; k++ ) {
+		if ( k->count ) {
+			top[ n ] = *k, top[ n ].count += bmin, top[ n++ ].err += bmin;
+		}
+	}
+
+	an = n;
+	for ( topk_t *k = b->top; k < b->top + PROFILE_SKETCH; k++ ) {
+		int i = 0;
+		for ( ; k->count && i < an && ( top[ i ].h != k->h || top[ i ].len != k->len || memcmp( top[ i ].v, k->v, k->len ) ); i++ );
+		if ( k->count && i < an )
+			top[ i ].count += k->count - bmin, top[ i ].err += k->err - bmin;
+		else if ( k->count ) {
+			top[ n ] = *k, top[ n ].count += amin, top[ n++ ].err += amin;
+		}
+	}
+
+	sort_topk( top, n );
+	memset( a->top, 0, sizeof( a->top ) );
+	memcpy( a->top, top, sizeof( topk_t ) * ( ( n < PROFILE_SKETCH ) ? n : PROFILE_SKETCH ) );
+}
+
+
+/**
+ * static double profile_distinct ( profile_t *p ) 
+ *
+ * Estimate the distinct values of a column from its HyperLogLog 
+ * registers, counting empty registers instead while there are many.
+ *
+ */
+static double profile_distinct ( profile_t *p ) {
+	const double m = 1 << PROFILE_HLL_BITS;
+	double sum = 0, e = 0;
+	int zeroes = 0;
+
+	for ( int i = 0; i < ( 1 << PROFILE_HLL_BITS ); i++ ) {
+		sum += ldexp( 1.0, -p->hll[ i ] ), zeroes += !p->hll[ i ];
+	}
+
+	e = ( 0.7213 / ( 1 + 1.079 / m ) ) * m * m / sum;
+	return ( e <= 2.5 * m && zeroes ) ? m * log( m / zeroes ) : e;
+}
+
+
+/**
+ * static void type_from_profile ( header_t *h, profile_t *p, const typemap_t *types ) 
+ *
+ * Narrow a column's preferred type down with its profile.  Integers 
+ * get the smallest type their range fits in, short strings get a 
+ * VARCHAR, columns without blanks are NOT NULL, and ones where every
+ * value looks unique are candidate primary keys.
+ *
+ */
+static void type_from_profile ( header_t *h, profile_t *p, const typemap_t *types ) {
+	typemap_t *t = NULL;
+
+	if ( h->type == T_INTEGER && p->ints ) {
+		unsigned long size = ( p->imin >= SCHAR_MIN && p->imax <= SCHAR_MAX ) ? 1 
+			: ( p->imin >= SHRT_MIN && p->imax <= SHRT_MAX ) ? 2
+			: ( p->imin >= -8388608 && p->imax <= 8388607 ) ? 3
+			: ( p->imin >= INT_MIN && p->imax <= INT_MAX ) ? 4 : 8;
+		if ( ( t = get_typemap_by_size( types, T_INTEGER, size ) ) ) {
+			h->ptype = t;
+		}
+	}
+	else if ( ( h->type == T_STRING || h->type == T_CHAR ) && p->maxlen && p->maxlen <= PROFILE_VARCHAR_MAX ) {
+		if ( ( t = get_typemap_by_nname( types, "varchar" ) ) ) {
+			h->ptype = t, h->maxlen = p->maxlen;
+		}
+	}
+
+	// The HyperLogLog estimate is only so close, so this is a hint and not a constraint
+	h->notnull = ( p->rows && p->values == p->rows );
+	h->candidate = h->notnull && ( h->type == T_INTEGER || h->type == T_STRING || h->type == T_CHAR || h->type == T_UUID ) 
+		&& profile_distinct( p ) >= p->rows - ( p->rows / 20.0 );
+}
+
+
+/**
+ * typedef struct sample_t 
+ *
+ * One thread's share of the rows that types are inferred from.
+ *
+ */
+typedef struct sample_t {
+	const unsigned char *start; // first line of this share
+	const unsigned char *end; // lines starting here or later belong to the next share
+	unsigned long every; // bytes to jump between lines, or 0 for every line
+	const unsigned char *base; // start of the file, for error messages
+	int hlen;
+	type_t *types; // each column's type, widened over every line seen
+	int *dates; // and each shape of date seen (1 << what date_from_text() found)
+	digits_t *digits; // and the digits of its numbers
+	profile_t *profile; // and its profile, if --profile asked for one
+	unsigned long rows; // lines seen, for the profile
+	char err[ ERRLEN ];
+} sample_t;
+
+
+/**
+ * static void *sample_lines ( void *arg ) 
+ *
+ * Widen the type of each column over the lines of one sample_t.
+ *
+ */
+static void *sample_lines ( void *arg ) {
+	sample_t *sm = (sample_t *)arg;
+	const unsigned char *dset = (unsigned char *)&delset[ 2 ];
+	const int dlen = strlen( &delset[ 2 ] );
+
+	for ( const unsigned char *line = sm->start, *eol = NULL, *stop = NULL; line < sm->end; ) {
+		int ci = 0;
+
+		if ( !( eol = memchr( line, '\n', sm->end - line ) ) ) {
+			eol = sm->end;
 		}
 
-	#ifdef BMYSQL_H
-		else if ( oconn->stream == STREAM_MYSQL ) {
-			mysql_t *b = (mysql_t *)oconn->conn;
-		#if 0
-			int status = 0;
-			status = mysql_bind_param( oconn->conn, iconn->hlen, b->bindargs, NULL );
-			if ( status != 0 ) {
-				const char fmt[] = "MySQL bind failed: '%s'";
-				snprintf( err, errlen, fmt, mysql_error( oconn->conn )  );
-				return 0;
+		// Blank lines have nothing to say
+		stop = ( eol > line && eol[ -1 ] == '\r' ) ? eol - 1 : eol;
+		sm->rows += ( stop > line );
+		for ( const unsigned char *f = line, *c = line; f < stop; c++ ) {
+			int len = 0;
+			unsigned char *v = NULL;
+			type_t t = T_NULL;
+			date_t d;
+
+			if ( c < stop && !memchr( dset, *c, dlen ) ) {
+				continue;
+			}
+
+			if ( ci >= sm->hlen ) {
+				const char fmt[] = "Column count does not match header count (%d) at byte %ld";
+				snprintf( sm->err, sizeof( sm->err ), fmt, sm->hlen, (long)( line - sm->base ) );
+				return NULL;
 			}
 
-			status = mysql_real_query( oconn->conn, ffmt, strlen( ffmt ) );
-			if ( status != 0 ) {
-				const char fmt[] = "MySQL real query failed: '%s'";
-				snprintf( err, errlen, fmt, mysql_error( oconn->conn )  );
-				return 0;
+			v = trim( (unsigned char *)f, " ", c - f, &len );
+			if ( ( t = get_type( v, T_NULL, len ) ) == T_DATE )
+				sm->dates[ ci ] |= 1 << date_from_text( v, len, &d );
+			else if ( t == T_INTEGER || t == T_DOUBLE ) {
+				digits_t *dg = &sm->digits[ ci ];
+				const unsigned char *dot = ( t == T_DOUBLE ) ? memchr( v, '.', len ) : NULL;
+				int whole = ( ( dot ) ? dot - v : len ) - ( *v == '-' ), scale = ( dot ) ? len - ( dot - v ) - 1 : 0;
+				dg->whole = ( whole > dg->whole ) ? whole : dg->whole;
+				dg->scale = ( scale > dg->scale ) ? scale : dg->scale;
+				if ( dot ) {
+					dg->fixed = ( !dg->fixed || dg->fixed == scale ) ? scale : -1;
+				}
 			}
-		#else
-			// TODO: Statements are probably preferred, but its simpler to do it the other way
-			// Prepare the statement
-			if ( mysql_stmt_prepare( b->stmt, b->query, strlen( b->query ) ) != 0 ) {
-				const char fmt[] = "MySQL statement prepare failure: '%s'";
-				snprintf( err, errlen, fmt, mysql_stmt_error( b->stmt )  );
-				return 0;
+			sm->types[ ci ] = widen_type( sm->types[ ci ], t );
+			if ( sm->profile ) {
+				profile_value( &sm->profile[ ci ], v, len, t );
 			}
+			ci++, f = c + 1;
+		}
 
-			// Use the parameter count to check that everything worked (probably useless)
-			if ( mysql_stmt_param_count( b->stmt ) != iconn->hlen ) {
-				snprintf( err, errlen, "MySQL column header count mismatch." );
-				return 0;
-			}
+		// Spread samples jump ahead, then pick up the next line that starts after that
+		if ( sm->every && line + sm->every > eol + 1 ) {
+			const unsigned char *jump = line + sm->every - 1;
+			line = ( jump < sm->end && ( jump = memchr( jump, '\n', sm->end - jump ) ) ) ? jump + 1 : sm->end;
+			continue;
+		}
 
-			if ( mysql_stmt_bind_param( b->stmt, b->bindargs ) != 0 ) {
-				const char fmt[] = "MySQL bind failure: '%s'";
-				snprintf( err, errlen, fmt, mysql_stmt_error( b->stmt )  );
-				return 0;
-			}
+		line = eol + 1;
+	}
 
-			//printf( "%p ?= %p %d\n", (void *)oconn->typemap, (void *)mysql_map, oconn->typemap == mysql_map );
-			if ( mysql_stmt_execute( b->stmt ) != 0 ) {
-				const char fmt[] = "MySQL statement exec failure: '%s'";
-				snprintf( err, errlen, fmt, mysql_stmt_error( b->stmt ) );
-				return 0;
-			}
+	return NULL;
+}
 
-			WPRINTF( "MySQL commit successful.\n" );
-		#endif
+
+/**
+ * static type_t *sample_types ( dsn_t *conn, config_t *conf, profile_t *profile, char *err, int errlen ) 
+ *
+ * Infer each column of a file from --sample rows: the first few, a 
+ * spread across the whole file, or all of them.  Big samples are cut
+ * into chunks on line boundaries and read by several threads, and the
+ * chunks' types are widened together at the end.  If `profile` isn't 
+ * NULL, every row is read, and each column is profiled into it too.
+ *
+ */
+static type_t *sample_types ( dsn_t *conn, config_t *conf, profile_t *profile, char *err, int errlen ) {
+	file_t *file = (file_t *)conn->conn;
+	const unsigned char *start = file->map, *end = file->map + ( file->size - file->offset );
+	const unsigned char *eol = memchr( start, '\n', end - start );
+	unsigned long every = 0, work = end - start;
+	sample_t sm[ SAMPLE_THREADS ];
+	pthread_t threads[ SAMPLE_THREADS ];
+	int started[ SAMPLE_THREADS ] = { 0 };
+	type_t *types = NULL;
+	int *dates = NULL;
+	digits_t *digits = NULL;
+	profile_t *profiles = NULL;
+	unsigned long sample = ( profile ) ? 0 : conf->wsample;
+	long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+	int n = 1, ok = 1;
+
+	// Spread rows are chosen by distance into the file, since rows can't be numbered without reading them
+	if ( sample && conf->wspread )
+		every = ( end - start ) / sample, work = sample * ( ( eol ) ? eol - start + 1 : 1 );
+	else if ( sample ) {
+		end = skip_lines( (unsigned char *)start, end - start, sample ), work = end - start;
+	}
+
+	n = work / SAMPLE_MIN_BYTES;
+	n = ( n > SAMPLE_THREADS ) ? SAMPLE_THREADS : ( n > cpus ) ? cpus : ( n < 1 ) ? 1 : n;
+
+	if ( !( types = malloc( sizeof( type_t ) * conn->hlen * ( n + 1 ) ) ) || !( dates = malloc( sizeof( int ) * conn->hlen * n ) )
+		|| !( digits = malloc( sizeof( digits_t ) * conn->hlen * ( n + 1 ) ) ) ) {
+		const char fmt[] = "Out of memory when sampling types: %s";
+		snprintf( err, errlen, fmt, strerror( errno ) );
+		free( types ), free( dates );
+		return NULL;
+	}
+
+	// The first chunk is profiled straight into `profile`, and the rest are added to it
+	if ( profile && n > 1 && !( profiles = malloc( sizeof( profile_t ) * conn->hlen * ( n - 1 ) ) ) ) {
+		const char fmt[] = "Out of memory when profiling columns: %s";
+		snprintf( err, errlen, fmt, strerror( errno ) );
+		free( types ), free( dates ), free( digits );
+		return NULL;
+	}
+
+	if ( profiles ) {
+		memset( profiles, 0, sizeof( profile_t ) * conn->hlen * ( n - 1 ) );
+	}
+
+	// T_NULL (0) is where every column starts widening from
+	memset( types, 0, sizeof( type_t ) * conn->hlen * ( n + 1 ) );
+	memset( dates, 0, sizeof( int ) * conn->hlen * n );
+	memset( digits, 0, sizeof( digits_t ) * conn->hlen * ( n + 1 ) );
+	memset( sm, 0, sizeof( sm ) );
+
+	for ( int i = 0; i < n; i++ ) {
+		const unsigned char *s = start + ( end - start ) / n * i;
+		if ( i && ( s = memchr( s, '\n', end - s ) ) ) {
+			s++;
 		}
-	#endif
 
-	#ifdef BPGSQL_H
-		else if ( oconn->stream == STREAM_PGSQL ) {
-			pgsql_t *b = (pgsql_t *)oconn->conn;
+		sm[ i ].start = ( s ) ? s : end, sm[ i ].end = end, sm[ i ].every = every;
+		sm[ i ].base = file->start, sm[ i ].hlen = conn->hlen;
+		sm[ i ].types = &types[ conn->hlen * ( i + 1 ) ];
+		sm[ i ].dates = &dates[ conn->hlen * i ];
+		sm[ i ].digits = &digits[ conn->hlen * ( i + 1 ) ];
+		sm[ i ].profile = ( !profile || !i ) ? profile : &profiles[ conn->hlen * ( i - 1 ) ];
+		if ( i ) {
+			sm[ i - 1 ].end = sm[ i ].start;
+		}
+	}
 
-			PGresult *r = PQexecParams(
-				b->conn,
-				b->query,
-				iconn->hlen,
-				b->bindoids,
-				(const char * const *)b->bindargs,
-				b->bindlens,
-				(int *)b->bindfmts,
-				0
-			);
+	for ( int i = 1; i < n; i++ ) {
+		started[ i ] = !pthread_create( &threads[ i ], NULL, sample_lines, &sm[ i ] );
+	}
 
-			if ( PQresultStatus( r ) != PGRES_COMMAND_OK ) {
-				const char fmt[] = "PostgreSQL commit failed: %s";
-				snprintf( err, errlen, fmt, PQresultErrorMessage( r ) );
-				return 0;
+	// Whatever didn't get a thread is sampled here instead
+	for ( int i = 0; i < n; i++ ) {
+		if ( !started[ i ] ) {
+			sample_lines( &sm[ i ] );
+		}
+	}
+
+	for ( int i = 0; i < n; i++ ) {
+		if ( started[ i ] ) {
+			pthread_join( threads[ i ], NULL );
+		}
+
+		if ( ok && *sm[ i ].err ) {
+			snprintf( err, errlen, "%s in file '%s'", sm[ i ].err, conn->connstr );
+			ok = 0;
+		}
+
+		for ( int ci = 0; ci < conn->hlen; ci++ ) {
+			digits_t *a = &digits[ ci ], *b = &sm[ i ].digits[ ci ];
+			types[ ci ] = widen_type( types[ ci ], sm[ i ].types[ ci ] );
+			conn->headers[ ci ]->date |= sm[ i ].dates[ ci ];
+			a->whole = ( b->whole > a->whole ) ? b->whole : a->whole;
+			a->scale = ( b->scale > a->scale ) ? b->scale : a->scale;
+			a->fixed = ( !a->fixed ) ? b->fixed : ( b->fixed && b->fixed != a->fixed ) ? -1 : a->fixed;
+			if ( profile && i ) {
+				sm[ i ].profile[ ci ].rows = sm[ i ].rows;
+				profile_merge( &profile[ ci ], &sm[ i ].profile[ ci ] );
+			}
+			else if ( profile ) {
+				profile[ ci ].rows = sm[ i ].rows;
 			}
+		}
+	}
 
-			WPRINTF( "Commit successful, freeing duplicated values\n" );
-			PQclear( r );
+	for ( int ci = 0; ci < conn->hlen; ci++ ) {
+		header_t *h = conn->headers[ ci ];
+		digits_t *dg = &digits[ ci ];
 
-			// Free all of the allocated values here
-			int ii = 0;
-			for ( char **bb = b->bindargs; ii < iconn->hlen; bb++, ii++ ) free( *bb );
+		// Times of day don't share a column with dates
+		if ( types[ ci ] == T_DATE && ( h->date & ( 1 << DATE_HAS_TIME ) ) && ( h->date & ~( 1 << DATE_HAS_TIME ) ) ) {
+			types[ ci ] = T_STRING;
 		}
-	#endif
 
-	#if 0
-		//Suffix
-		if ( oconn->type == DB_FILE ) {
-			file_t *file = (file_t *)oconn->conn;
-			( FF.suffix ) ? FDPRINTF( file->fd, FF.suffix ) : 0;
-			//( FF.newline ) ? FDPRINTF( file->fd, "\n" ) : 0;
+		// Numbers always written with the same decimals are amounts, not measurements,
+		// and ones with more digits than a double holds can't be doubles either
+		if ( types[ ci ] == T_DOUBLE && ( dg->fixed > 0 || dg->whole + dg->scale > DECIMAL_DIGITS ) ) {
+			types[ ci ] = T_DECIMAL;
+			h->scale = ( dg->scale > DECIMAL_MAX_SCALE ) ? DECIMAL_MAX_SCALE : dg->scale;
+			h->precision = h->scale + ( ( dg->whole > DECIMAL_WHOLE ) ? dg->whole : DECIMAL_WHOLE );
+			h->precision = ( h->precision > DECIMAL_MAX_PRECISION ) ? DECIMAL_MAX_PRECISION : h->precision;
 		}
-	#endif
 	}
 
-	return 1;
-}
+	free( dates ), free( digits ), free( profiles );
+	if ( !ok ) {
+		free( types );
+		return NULL;
+	}
 
+	return types;
+}
 
 
+#ifdef DEBUG_H
 /**
- * close_dsn( dsn_t *conn )
+ * static double bench_pass ( unsigned char **v, unsigned int *lens, unsigned long n, type_t (*fn)( unsigned char *, type_t, unsigned int ), type_t *types ) 
  *
- * Closes a data source: `conn`.
+ * Classify n fields with fn, and time it.
  *
  */
-void close_dsn( dsn_t *conn ) {
-	WPRINTF( "Attempting to close %s at %p", conn->connstr, (void *)conn->conn );
+static double bench_pass ( unsigned char **v, unsigned int *lens, unsigned long n, type_t (*fn)( unsigned char *, type_t, unsigned int ), type_t *types ) {
+	struct timespec a, b;
 
-	if ( conn->conn ) {
-		if ( conn->type == DB_FILE ) {
-			// Cast
-			file_t *file = (file_t *)conn->conn;
+	clock_gettime( CLOCK_MONOTONIC, &a );
+	for ( unsigned long i = 0; i < n; i++ ) {
+		types[ i ] = fn( v[ i ], T_NULL, lens[ i ] );
+	}
+	clock_gettime( CLOCK_MONOTONIC, &b );
 
-			// Free this
-			if ( file->start && munmap( (void *)file->start, file->size ) == -1 ) {
-				fprintf( stderr, "munmap() %s", strerror( errno ) );
-			}
+	return ( b.tv_sec - a.tv_sec ) + ( b.tv_nsec - a.tv_nsec ) / 1e9;
+}
 
-			// Close if the file is not stdout or in
-			if ( file->fd > 2 && close( file->fd ) == -1 ) {
-				fprintf( stderr, "close() %s", strerror( errno ) );
-			}
 
-			free( file );
+/**
+ * int bench_types ( dsn_t *conn, char *err, int errlen ) 
+ *
+ * Time get_type() against get_type_scalar() over every field of a 
+ * file input, and count the fields where they disagree.  Fields are
+ * split up front, so only the classifiers are timed.
+ *
+ */
+int bench_types ( dsn_t *conn, char *err, int errlen ) {
+	file_t *file = (file_t *)conn->conn;
+	const unsigned char *dset = (unsigned char *)delset, *end = NULL;
+	const int dlen = strlen( delset );
+	unsigned char **v = NULL;
+	unsigned int *lens = NULL;
+	type_t *ta = NULL, *tb = NULL;
+	unsigned long n = 0, max = 0, diff = 0;
+	double old = 0, new = 0;
+
+	if ( conn->type != DB_FILE ) {
+		snprintf( err, errlen, "--bench-types needs a file input" );
+		return 0;
+	}
+
+	// Fields are at most one per byte
+	end = file->map + ( file->size - file->offset ), max = end - file->map + 1;
+	if ( !( v = malloc( sizeof( unsigned char * ) * max ) ) || !( lens = malloc( sizeof( unsigned int ) * max ) )
+		|| !( ta = malloc( sizeof( type_t ) * max ) ) || !( tb = malloc( sizeof( type_t ) * max ) ) ) {
+		snprintf( err, errlen, "Out of memory: %s", strerror( errno ) );
+		free( v ), free( lens ), free( ta );
+		return 0;
+	}
+
+	for ( const unsigned char *f = file->map, *c = file->map; c <= end; c++ ) {
+		if ( c == end || memchr( dset, *c, dlen ) ) {
+			v[ n ] = (unsigned char *)f, lens[ n++ ] = c - f, f = c + 1;
 		}
-	#ifdef BSQLITE_H
-		else if ( conn->type == DB_SQLITE ) {
-			fprintf( stderr, "SQLite3 not done yet.\n" );
+	}
+
+	// Warm up, then time each one
+	bench_pass( v, lens, n, get_type, tb );
+	old = bench_pass( v, lens, n, get_type_scalar, ta );
+	new = bench_pass( v, lens, n, get_type, tb );
+
+	for ( unsigned long i = 0; i < n; i++ ) {
+		diff += ta[ i ] != tb[ i ];
+	}
+
+	fprintf( stderr, "%lu fields, %lu classified differently\n", n, diff );
+	fprintf( stderr, "get_type_scalar(): %.3fs (%.1f ns/field)\n", old, old * 1e9 / ( n ? n : 1 ) );
+	fprintf( stderr, "get_type():        %.3fs (%.1f ns/field)\n", new, new * 1e9 / ( n ? n : 1 ) );
+	free( v ), free( lens ), free( ta ), free( tb );
+	return 1;
+}
+#endif
+
+
+/**
+ * typedef struct cache_t 
+ *
+ * The header of a --cache file.  It is followed by one cached_t for 
+ * each column.
+ *
+ */
+typedef struct cache_t {
+	char magic[ 8 ];
+	unsigned long long key; // fingerprint_dsn() of the layout it was inferred for
+	int hlen;
+} cache_t;
+
+
+/**
+ * typedef struct cached_t 
+ *
+ * Everything types_from_dsn() worked out about one column.
+ *
+ */
+typedef struct cached_t {
+	char label[ 128 ];
+	char ptype[ 64 ]; // name of the preferred type in the output typemap
+	int type, pbasetype, precision, scale, date, maxlen, notnull, candidate;
+} cached_t;
+
+
+/**
+ * static unsigned long long fingerprint_dsn ( dsn_t *iconn, dsn_t *oconn, config_t *conf ) 
+ *
+ * Hash the header line of a file along with everything else that 
+ * changes what types_from_dsn() infers: the delimiter, the output's
+ * types, and the options for coercion, sampling and profiling.
+ *
+ */
+static unsigned long long fingerprint_dsn ( dsn_t *iconn, dsn_t *oconn, config_t *conf ) {
+	file_t *file = (file_t *)iconn->conn;
+	const unsigned char *s = file->start, *eol = memchr( s, '\n', file->size );
+	unsigned long long h = 14695981039346656037ULL;
+	char opts[ 64 ] = { 0 };
+	const char *parts[] = { &delset[ 2 ], conf->wcoerce, conf->wautocast, opts };
+
+	for ( ; s < ( ( eol ) ? eol : (unsigned char *)file->start + file->size ); s++ ) {
+		h = ( h ^ *s ) * 1099511628211ULL;
+	}
+
+	snprintf( opts, sizeof( opts ), "%lu %d %d", conf->wsample, conf->wspread, conf->wprofile );
+	for ( int i = 0; i < sizeof( parts ) / sizeof( char * ); i++ ) {
+		h = ( h ^ 0xff ) * 1099511628211ULL;
+		for ( const char *c = parts[ i ]; c && *c; c++ ) {
+			h = ( h ^ (unsigned char)*c ) * 1099511628211ULL;
 		}
-	#endif
-	#ifdef BMYSQL_H
-		else if ( conn->type == DB_MYSQL ) {
-			mysql_t *db = ( mysql_t *)conn->conn;
-			mysql_free_result( db->res );
-			mysql_close( (MYSQL *)db->conn );
-			free( db );
+	}
+
+	// The names in the typemap tell the engines apart
+	for ( const typemap_t *t = oconn->typemap; t && t->ntype != TYPEMAP_TERM; t++ ) {
+		h = ( h ^ t->basetype ) * 1099511628211ULL;
+		for ( const char *c = t->name; c && *c; c++ ) {
+			h = ( h ^ (unsigned char)*c ) * 1099511628211ULL;
 		}
-	#endif
-	#ifdef BPGSQL_H
-		else if ( conn->type == DB_POSTGRESQL ) {
-			pgsql_t *db = ( pgsql_t *)conn->conn;
-			PQclear( db->res );
-			PQfinish( (PGconn *)db->conn );
-			free( db );
+	}
+
+	return h;
+}
+
+
+/**
+ * static int load_cache ( const char *path, unsigned long long key, dsn_t *iconn, dsn_t *oconn ) 
+ *
+ * Read the types cached at path into the input's headers, as long as 
+ * they were inferred for the same layout and every column still has
+ * the same name and a type the output knows.  Anything else is 
+ * treated as no cache at all, and leaves the headers alone.
+ *
+ */
+static int load_cache ( const char *path, unsigned long long key, dsn_t *iconn, dsn_t *oconn ) {
+	cache_t h;
+	cached_t *c = NULL;
+	typemap_t **ptypes = NULL;
+	int fd = open( path, O_RDONLY ), ok = 1;
+	size_t size = 0;
+
+	if ( fd == -1 ) {
+		return 0;
+	}
+
+	if ( read( fd, &h, sizeof( h ) ) != sizeof( h ) || memcmp( h.magic, CACHE_MAGIC, sizeof( h.magic ) ) 
+		|| h.key != key || h.hlen != iconn->hlen ) {
+		close( fd );
+		return 0;
+	}
+
+	size = sizeof( cached_t ) * h.hlen;
+	if ( !( c = malloc( size ) ) || !( ptypes = malloc( sizeof( typemap_t * ) * h.hlen ) ) || read( fd, c, size ) != size ) {
+		free( c ), free( ptypes ), close( fd );
+		return 0;
+	}
+
+	close( fd );
+	for ( int i = 0; ok && i < h.hlen; i++ ) {
+		const typemap_t *t = oconn->typemap;
+		c[ i ].label[ sizeof( c[ i ].label ) - 1 ] = '\0', c[ i ].ptype[ sizeof( c[ i ].ptype ) - 1 ] = '\0';
+		for ( ; t->ntype != TYPEMAP_TERM && ( t->basetype != c[ i ].pbasetype || !t->name || strcmp( t->name, c[ i ].ptype ) ); t++ );
+		ptypes[ i ] = ( t->ntype != TYPEMAP_TERM ) ? (typemap_t *)t : NULL;
+		ok = ptypes[ i ] && !strcmp( c[ i ].label, iconn->headers[ i ]->label );
+	}
+
+	for ( int i = 0; ok && i < h.hlen; i++ ) {
+		header_t *st = iconn->headers[ i ];
+		st->type = c[ i ].type, st->ptype = ptypes[ i ];
+		st->precision = c[ i ].precision, st->scale = c[ i ].scale, st->date = c[ i ].date;
+		st->maxlen = c[ i ].maxlen, st->notnull = c[ i ].notnull, st->candidate = c[ i ].candidate;
+	}
+
+	free( c ), free( ptypes );
+	return ok;
+}
+
+
+/**
+ * static void save_cache ( const char *path, unsigned long long key, dsn_t *iconn ) 
+ *
+ * Write the types inferred for each column to path, for load_cache().
+ *
+ */
+static void save_cache ( const char *path, unsigned long long key, dsn_t *iconn ) {
+	cache_t h;
+	cached_t *c = NULL;
+	size_t size = sizeof( cached_t ) * iconn->hlen;
+	int fd = -1;
+
+	memset( &h, 0, sizeof( h ) );
+	memcpy( h.magic, CACHE_MAGIC, sizeof( h.magic ) );
+	h.key = key, h.hlen = iconn->hlen;
+
+	if ( ( c = malloc( size ) ) ) {
+		memset( c, 0, size );
+		for ( int i = 0; i < iconn->hlen; i++ ) {
+			header_t *st = iconn->headers[ i ];
+			snprintf( c[ i ].label, sizeof( c[ i ].label ), "%s", st->label );
+			snprintf( c[ i ].ptype, sizeof( c[ i ].ptype ), "%s", st->ptype->name );
+			c[ i ].type = st->type, c[ i ].pbasetype = st->ptype->basetype;
+			c[ i ].precision = st->precision, c[ i ].scale = st->scale, c[ i ].date = st->date;
+			c[ i ].maxlen = st->maxlen, c[ i ].notnull = st->notnull, c[ i ].candidate = st->candidate;
 		}
-	#endif
 	}
 
-	if ( conn->connstr ) {
-		free( conn->connstr );
+	// Not being able to save it only costs the next run a sample
+	if ( !c || ( fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 
+		|| write( fd, &h, sizeof( h ) ) != sizeof( h ) || write( fd, c, size ) != size ) {
+		fprintf( stderr, "WARNING: Could not write type cache '%s': %s\n", path, strerror( errno ) );
 	}
 
-	conn->conn = NULL;
+	if ( fd > -1 ) {
+		close( fd );
+	}
+
+	free( c );
 }
 
 
@@ -3695,6 +9334,7 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 	char *ename = NULL;
 	coerce_t **ctypes = NULL;
 	coerce_t **atypes = NULL;
+	nameidx_t cnames = { 0 }, anames = { 0 }, tnames = { 0 };
 
 	// Create a map of what a specific type should ALWAYS map to
 	if ( conf->wautocast && !( atypes = create_ctypes( conf->wautocast, iconn, oconn, err, errlen ) ) )
@@ -3707,6 +9347,13 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 	fprintf( stderr, "AUTOCASTED TYPES\n" ), print_ctypes( atypes ), fprintf( stderr, "\n" );
 	fprintf( stderr, "COERCED TYPES\n" ), print_ctypes( ctypes ), fprintf( stderr, "\n" );
 
+	// Index both lists and the output's type names once, rather than walking them for each column
+	if ( !index_ctypes( &cnames, ctypes ) || !index_ctypes( &anames, atypes ) || !index_typemap( &tnames, oconn->typemap ) ) {
+		const char fmt[] = "Out of memory when indexing types: %s";
+		snprintf( err, errlen, fmt, strerror( errno ) );
+		return 0;
+	}
+
 #if 0
 	if ( ov ) {
 		int ctypeslen = 0;
@@ -3754,12 +9401,14 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 
 	//
 	if ( iconn->type == DB_FILE ) {
-		zw_t p;
 		int count = 0;
 		unsigned int rowlen = 0;
-		unsigned int dlen = strlen( delset );
 		unsigned char *s = NULL;
 		file_t *file = NULL;
+		type_t *types = NULL;
+		profile_t *profile = NULL;
+		unsigned long long key = 0;
+		char path[ PATH_MAX ] = { 0 };
 
 		// Catch any silly errors that may have been made on the way back here
 		if ( !( file = (file_t *)iconn->conn ) ) {
@@ -3773,77 +9422,139 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 			rowlen++;
 		}
 
-		// Check that col count - 1 == occurrence of delimiters in file
-		if ( ( iconn->hlen - 1 ) != ( count = memstrocc( file->map, &delset[2], rowlen ) ) ) {
+		// Check that col count - 1 == occurrence of delimiters in file (unless --offset left no rows)
+		if ( file->offset < file->size && ( iconn->hlen - 1 ) != ( count = memstrocc( file->map, &delset[2], rowlen ) ) ) {
 			const char fmt[] = "Header count and column count differ in file: %s (%d != %d)";
 			snprintf( err, errlen, fmt, iconn->connstr, iconn->hlen, count );
 			return 0;
 		}
 
-		// Check that we have more than 2 lines (so we don't overrun the extract buffer)
-		if ( s ) {
-			rowlen++, memset( &p, 0, sizeof( zw_t ) );
+		// A layout seen before with the same options can skip inference, records_from_dsn() still checks every value
+		if ( conf->wcache ) {
+			key = fingerprint_dsn( iconn, oconn, conf );
+			snprintf( path, sizeof( path ), "%s/%016llx" CACHE_SUFFIX, conf->wcache, key );
+			if ( !conf->wrefresh && load_cache( path, key, iconn, oconn ) ) {
+				free_ctypes( atypes ), free_ctypes( ctypes );
+				free_nameidx( &cnames ), free_nameidx( &anames ), free_nameidx( &tnames );
+				return 1;
+			}
 		}
-		else {
-			// No terminating \r or \n SHOULDN'T be a problem.  But I'll need to test it...
-			// I'll need to also add \0 to the (del)imiter (set)
+
+		// --profile reads every row, and keeps statistics about each column on the way
+		if ( conf->wprofile && ( !( profile = malloc( sizeof( profile_t ) * iconn->hlen ) ) || !memset( profile, 0, sizeof( profile_t ) * iconn->hlen ) ) ) {
+			const char fmt[] = "Out of memory when profiling columns: %s";
+			snprintf( err, errlen, fmt, strerror( errno ) );
+			return 0;
 		}
 
+		// Widen each column's type over a sample of rows, instead of trusting the first
+		if ( !( types = sample_types( iconn, conf, profile, err, errlen ) ) ) {
+			free( profile );
+			return 0;
+		}
 
-		// Move through the rest of the entries in the row and approximate types
-		for ( int i = 0; memwalk( &p, file->map, (unsigned char *)delset, rowlen, dlen ); i++ ) {
+		for ( int i = 0; i < iconn->hlen; i++ ) {
 			header_t *st = iconn->headers[ i ];
-			char *t = NULL;
 			const char *ctype = NULL;
-			int len = 0;
 			typemap_t *cm = NULL;
 
 			// Check if any of these are looking for a coerced type
-			if ( ctypes && ( ctype = find_ctype( ctypes, st->label ) ) ) {
-				if ( !( cm = get_typemap_by_nname( oconn->typemap, ctype ) ) ) {
+			if ( ctypes && ( ctype = find_ctype( &cnames, st->label ) ) ) {
+				if ( !( cm = nameidx_get( &tnames, ctype ) ) ) {
 					// TODO: Complete this message
 					const char fmt[] = "FILE: Failed to find desired type '%s' at column '%s'";
 					snprintf( err, errlen, fmt, ctype, st->label );
+					free( types ), free( profile );
 					return 0;
 				}
 			}
-			else if ( atypes ) {
 
+			// TODO: Assuming a column that was always blank is a string might not always be the best move
+			st->type = ( types[ i ] == T_NULL ) ? T_STRING : types[ i ];
+			st->ptype = ( cm ) ? cm : get_typemap_by_btype( oconn->typemap, st->type );
+
+			// Dates, times and timestamps each get their own type where there is one
+			if ( !cm && st->type == T_DATE ) {
+				int found = ( st->date == 1 << DATE_HAS_DATE ) ? DATE_HAS_DATE : ( st->date == 1 << DATE_HAS_TIME ) ? DATE_HAS_TIME : DATE_HAS_DATE | DATE_HAS_TIME;
+				st->ptype = get_typemap_by_date( oconn->typemap, found );
+			}
+
+			// A profile can narrow the type down further
+			if ( !cm && profile ) {
+				type_from_profile( st, &profile[ i ], oconn->typemap );
 			}
+		}
 
-			// TODO: Assuming a blank value is a string might not always be the best move
-			if ( !p.size || !( p.size - 1 ) ) {
-				st->type = T_STRING;
-				st->ptype = get_typemap_by_btype( oconn->typemap, T_STRING );
-				continue;
+		if ( conf->wcache ) {
+			save_cache( path, key, iconn );
+		}
+
+		free( types ), free( profile );
+	}
+#ifdef BSQLITE_H
+	else if ( iconn->type == DB_SQLITE ) {
+		sqlite3_t *b = (sqlite3_t *)iconn->conn;
+		const char eng[] = "SQLite3";
+
+		for ( int i = 0, fcount = sqlite3_column_count( b->stmt ); i < fcount; i++ ) {
+			header_t *st = iconn->headers[ i ];
+			const char *name = sqlite3_column_name( b->stmt, i );
+			const char *ctypename = NULL;
+			type_t btype = type_from_sqlite( b->stmt, i, b->status == SQLITE_ROW );
+			const char *decl = NULL;
+			typemap_t *nm = NULL, *cm = NULL, *am = NULL;
+
+			// SQLite only has affinities, so the base type picks the native one
+			if ( !( nm = get_typemap_by_btype( iconn->typemap, btype ) ) ) {
+				snprintf( err, errlen, "Unsupported %s type received: %s", eng, itypes[ btype ] );
+				return 0;
+			}
+
+			// Decimals may still have been declared with their digits
+			if ( btype == T_DECIMAL && ( decl = sqlite3_column_decltype( b->stmt, i ) ) && ( decl = strchr( decl, '(' ) ) ) {
+				sscanf( decl, "( %d , %d", &st->precision, &st->scale );
+			}
+
+			// Check if there are any matching coerced types for this column
+			if ( ctypes && ( ctypename = find_ctype( &cnames, name ) ) ) {
+				cm = nameidx_get( &tnames, ctypename );
+				if ( !cm ) {
+					const char fmt[] = "%s: Failed to find desired type '%s' for column '%s' for supported %s types ";
+					snprintf( err, errlen, fmt, eng, ctypename, name, ename );
+					return 0;
+				}
+			}
+			// Check if any --auto rules have been declared 
+			else if ( atypes && ( ctypename = find_atype( &anames, nm->name ) ) ) {
+				cm = nameidx_get( &tnames, ctypename );
+				if ( !cm ) {
+					const char fmt[] = "%s: Auto conversion to type '%s' failed for column '%s'";
+					snprintf( err, errlen, fmt, eng, ctypename, name );
+					return 0;
+				}
 			}
 
-			// Try to copy again
-			if ( !( t = copy( &((char *)file->map)[ p.pos ], p.size - 1, &len, CASE_NONE ) ) ) {
-				// TODO: This isn't very clear, but it is unlikely we'll ever run into it...
-				const char fmt[] = "FILE: Encountered memory bound at line 2, column %d";
-				snprintf( err, errlen, fmt, i );
-				return 0;
-			}
+			// Set the native type always
+			st->ntype = nm;
 
-			// Handle NULL or empty strings
-			if ( !len ) {
-				st->type = T_STRING;
-				st->ptype = get_typemap_by_btype( oconn->typemap, T_STRING );
-				continue;
+			// Now, we set the preferred type
+			if ( cm )
+				st->ptype = cm, st->type = cm->basetype;
+			else if ( iconn->type == oconn->type )
+				st->ptype = nm, st->type = nm->basetype;
+			else {
+				// Different output type, and no coercion, so find the closest match
+				if ( !( am = get_typemap_by_btype( oconn->typemap, nm->basetype ) ) ) {
+					const char fmt[] = "%s: Failed to find matching type "
+						"for column '%s', type '%s' in supported %s types ";
+					snprintf( err, errlen, fmt, eng, name, nm->name, get_conn_type( oconn->type ) );
+					return 0;
+				}
+				st->ptype = am;
+				st->type = nm->basetype;
 			}
-
-			// This will be the default type
-			st->type = get_type( (unsigned char *)t, T_STRING, len );
-			st->ptype = ( cm ) ? cm : get_typemap_by_btype( oconn->typemap, st->type );
-			free( t );
 		}
 	}
-#ifdef BSQLITE_H
-	else if ( iconn->type == DB_SQLITE ) {
-		snprintf( err, errlen, "%s", "SQLite3 driver not done yet" );
-		return 0;
-	}
 #endif
 
 #ifdef BMYSQL_H
@@ -3851,7 +9562,7 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 		mysql_t *b = (mysql_t *)iconn->conn;
 		const char eng[] = "MySQL";
 
-		for ( int i = 0, fcount = mysql_field_count( b->conn ); i < fcount; i++ ) {
+		for ( int i = 0, fcount = mysql_num_fields( b->res ); i < fcount; i++ ) {
 			MYSQL_FIELD *f = mysql_fetch_field_direct( b->res, i );
 			header_t *st = iconn->headers[ i ];
 			const char *name = f->name;
@@ -3867,8 +9578,8 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 			}
 
 			// Check if there are any matching coerced types for this column
-			if ( ctypes && ( ctypename = find_ctype( ctypes, name ) ) ) {
-				cm = get_typemap_by_nname( oconn->typemap, ctypename );
+			if ( ctypes && ( ctypename = find_ctype( &cnames, name ) ) ) {
+				cm = nameidx_get( &tnames, ctypename );
 				if ( !cm ) {
 					const char fmt[] = "%s: Failed to find desired type '%s' for column '%s' for supported %s types ";
 					snprintf( err, errlen, fmt, eng, ctypename, name, ename );
@@ -3876,8 +9587,8 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 				}
 			}
 			// Check if any --auto rules have been declared 
-			else if ( atypes && ( ctypename = find_atype( atypes, nm->name ) ) ) {
-				cm = get_typemap_by_nname( oconn->typemap, ctypename );
+			else if ( atypes && ( ctypename = find_atype( &anames, nm->name ) ) ) {
+				cm = nameidx_get( &tnames, ctypename );
 				if ( !cm ) {
 					const char fmt[] = "%s: Auto conversion to type '%s' failed for column '%s'";
 					snprintf( err, errlen, fmt, eng, ctypename, name );
@@ -3908,10 +9619,15 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 				st->ptype = am;
 				st->type = nm->basetype; //am->basetype would work too
 			}
+
+			// The length of a DECIMAL counts its sign and point too
+			if ( nm->basetype == T_DECIMAL ) {
+				st->scale = f->decimals;
+				st->precision = f->length - ( f->decimals > 0 ) - !( f->flags & UNSIGNED_FLAG );
+			}
 		
 		#if 0
 			st->maxlen = 0;
-			st->precision = 0;
 			st->filter = 0;
 			st->date = 0;
 		#endif
@@ -3939,8 +9655,8 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 			}
 
 			// Check if there are any matching coerced types for this column
-			if ( ctypes && ( ctypename = find_ctype( ctypes, name ) ) ) {
-				cm = get_typemap_by_nname( oconn->typemap, ctypename );
+			if ( ctypes && ( ctypename = find_ctype( &cnames, name ) ) ) {
+				cm = nameidx_get( &tnames, ctypename );
 				if ( !cm ) {
 					const char fmt[] = "%s: Failed to find desired type '%s' for column '%s' for supported %s types ";
 					snprintf( err, errlen, fmt, eng, ctypename, name, ename );
@@ -3948,8 +9664,8 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 				}
 			}
 			// Check if any --auto rules have been declared 
-			else if ( atypes && ( ctypename = find_atype( atypes, nm->name ) ) ) {
-				cm = get_typemap_by_nname( oconn->typemap, ctypename );
+			else if ( atypes && ( ctypename = find_atype( &anames, nm->name ) ) ) {
+				cm = nameidx_get( &tnames, ctypename );
 				if ( !cm ) {
 					const char fmt[] = "%s: Auto conversion to type '%s' failed for column '%s'";
 					snprintf( err, errlen, fmt, eng, ctypename, name );
@@ -3980,10 +9696,15 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 				st->ptype = am;
 				st->type = nm->basetype;					
 			}
+
+			// A numeric's precision and scale are packed into its modifier, which is -1 without them
+			if ( pgtype == PG_NUMERICOID && PQfmod( b->res, i ) >= 4 ) {
+				st->precision = ( ( PQfmod( b->res, i ) - 4 ) >> 16 ) & 0xffff;
+				st->scale = ( PQfmod( b->res, i ) - 4 ) & 0xffff;
+			}
 		
 		#if 0
 			st->maxlen = 0;
-			st->precision = 0;
 			st->filter = 0;
 			st->date = 0; // The timezone data?
 		#endif
@@ -3993,6 +9714,38 @@ int types_from_dsn( dsn_t * iconn, dsn_t *oconn, config_t *conf, char *err, int
 #endif
 
 	free_ctypes( atypes ), free_ctypes( ctypes );
+	free_nameidx( &cnames ), free_nameidx( &anames ), free_nameidx( &tnames );
+	return 1;
+}
+
+
+/**
+ * static int can_pushdown ( config_t *conf, dsn_t *ic, dsn_t *oc ) 
+ *
+ * Check if a copy can run on the server as INSERT ... SELECT.  Both 
+ * sides need the same engine, reached the same way, and nothing else
+ * can have asked for the rows to come through here.
+ *
+ */
+static int can_pushdown ( config_t *conf, dsn_t *ic, dsn_t *oc ) {
+	if ( !conf->wconvert || conf->wnopushdown || conf->wparallel > 1 || conf->wwriters > 1 ) {
+		return 0;
+	}
+
+	if ( ic->type != oc->type || ( ic->type != DB_MYSQL && ic->type != DB_POSTGRESQL ) ) {
+		return 0;
+	}
+
+	// The output connection runs the SELECT, so it has to be the same login
+	if ( strcmp( ic->hostname, oc->hostname ) || ic->port != oc->port || strcmp( ic->username, oc->username ) ) {
+		return 0;
+	}
+
+	// Postgres can't reach into other databases, MySQL can when we name the table
+	if ( strcmp( ic->dbname, oc->dbname ) && ( ic->type == DB_POSTGRESQL || conf->wquery ) ) {
+		return 0;
+	}
+
 	return 1;
 }
 
@@ -4087,6 +9840,8 @@ int scaffold_dsn ( config_t *conf, dsn_t *ic, dsn_t *oc, char *err, int errlen
 			oc->typemap = mysql_map;
 		else if ( ic->type == DB_POSTGRESQL )
 			oc->typemap = pgsql_map;
+		else if ( ic->type == DB_SQLITE )
+			oc->typemap = sqlite3_map;
 		else {
 			oc->typemap = default_map;
 		}	
@@ -4097,9 +9852,18 @@ int scaffold_dsn ( config_t *conf, dsn_t *ic, dsn_t *oc, char *err, int errlen
 			oc->typemap = mysql_map;
 		else if ( oc->type == DB_POSTGRESQL )
 			oc->typemap = pgsql_map;
+		else if ( oc->type == DB_SQLITE )
+			oc->typemap = sqlite3_map;
 		else {
 			oc->typemap = default_map;
 		}	
+
+		// Same server, so the server can do the copy itself
+		ic->pushdown = oc->pushdown = can_pushdown( conf, ic, oc );
+
+		// Postgres on both ends can pass COPY data through (check_pipe() looks at the types later)
+		ic->pipe = oc->pipe = !oc->pushdown && conf->wconvert && ic->type == DB_POSTGRESQL 
+			&& oc->type == DB_POSTGRESQL && conf->wparallel < 2 && conf->wwriters < 2;
 	}
 
 
@@ -4125,6 +9889,115 @@ int cmd_headers ( dsn_t *conn ) {
 }
 
 
+/**
+ * cmd_count ( dsn_t *, config_t *, char *, int )
+ * ===========================
+ *
+ * Dump the row count only and stop.
+ *
+ */
+int cmd_count ( dsn_t *conn, config_t *conf, char *err, int errlen ) {
+	unsigned long count = 0;
+	if ( !count_dsn( conn, conf, &count, err, errlen ) ) {
+		return 0;
+	}
+	printf( "%lu\n", count );
+	destroy_dsn_headers( conn );
+	return 1;
+}
+
+
+/**
+ * static void print_json_text ( const unsigned char *v, unsigned int len ) 
+ *
+ * Print a value as a JSON string.
+ *
+ */
+static void print_json_text ( const unsigned char *v, unsigned int len ) {
+	putchar( '"' );
+	for ( const unsigned char *e = v + len; v < e; v++ ) {
+		if ( *v == '"' || *v == '\\' )
+			printf( "\\%c", *v );
+		else if ( *v < 32 || *v == 127 )
+			printf( "\\u%04x", *v );
+		else {
+			putchar( *v );
+		}
+	}
+	putchar( '"' );
+}
+
+
+/**
+ * cmd_profile ( dsn_t *, config_t *, char *, int )
+ * ===========================
+ *
+ * Read every row of a file, and dump statistics about each column 
+ * as JSON.
+ *
+ */
+int cmd_profile ( dsn_t *conn, config_t *conf, char *err, int errlen ) {
+	profile_t *profile = NULL;
+	type_t *types = NULL;
+
+	if ( conn->type != DB_FILE ) {
+		const char fmt[] = "--profile only works with file inputs, databases already know their types";
+		snprintf( err, errlen, fmt );
+		return 0;
+	}
+
+	if ( !( profile = malloc( sizeof( profile_t ) * conn->hlen ) ) || !memset( profile, 0, sizeof( profile_t ) * conn->hlen ) ) {
+		const char fmt[] = "Out of memory when profiling columns: %s";
+		snprintf( err, errlen, fmt, strerror( errno ) );
+		return 0;
+	}
+
+	if ( !( types = sample_types( conn, conf, profile, err, errlen ) ) ) {
+		free( profile );
+		return 0;
+	}
+
+	printf( "[" );
+	for ( int i = 0; i < conn->hlen; i++ ) {
+		profile_t *p = &profile[ i ];
+		type_t t = ( types[ i ] == T_NULL ) ? T_STRING : types[ i ];
+
+		printf( "%s{\"column\": ", ( i ) ? ",\n" : "" );
+		print_json_text( (unsigned char *)conn->headers[ i ]->label, strlen( conn->headers[ i ]->label ) );
+		printf( ", \"type\": \"%s\", \"rows\": %lu, \"nulls\": %lu", &itypes[ t ][ 2 ], p->rows, p->rows - p->values );
+
+		// Numbers have a numeric range, everything else goes by byte order
+		if ( t == T_INTEGER )
+			printf( ", \"min\": %lld, \"max\": %lld", p->imin, p->imax );
+		else if ( ( t == T_DOUBLE || t == T_DECIMAL ) && ( p->ints + p->reals ) )
+			printf( ", \"min\": %.15g, \"max\": %.15g", p->nmin, p->nmax );
+		else if ( p->smin ) {
+			printf( ", \"min\": " ), print_json_text( p->smin, p->sminlen );
+			printf( ", \"max\": " ), print_json_text( p->smax, p->smaxlen );
+		}
+
+		// Counts are exact until the sketch fills up, then they're estimates with their error
+		sort_topk( p->top, PROFILE_SKETCH );
+		printf( ", \"maxlen\": %lu, \"distinct\": %.0f, \"top\": [", p->maxlen, profile_distinct( p ) );
+		for ( int k = 0; k < PROFILE_TOPK && p->top[ k ].count - p->top[ k ].err > 1; k++ ) {
+			printf( "%s{\"value\": ", ( k ) ? ", " : "" );
+			print_json_text( p->top[ k ].v, p->top[ k ].len );
+			if ( p->top[ k ].err )
+				printf( ", \"estimate\": %lu, \"error\": %lu}", p->top[ k ].count, p->top[ k ].err );
+			else {
+				printf( ", \"count\": %lu}", p->top[ k ].count );
+			}
+		}
+		printf( "]}" );
+	}
+	printf( "]\n" );
+
+	free( types ), free( profile );
+	destroy_dsn_headers( conn );
+	return 1;
+}
+
+
 
 /**
  * void free_ctypes( coerce_t **ctypes ) 
@@ -4194,13 +10067,35 @@ int help () {
 		{ "-T", "table <arg>", "Use the specified table when connecting to a database for source data"  },
 		{ "-Q", "query <arg>", "Use this query to filter data from datasource"  },
 		{ "-y", "stats",       "Dump stats at the end of an operation"  },
+		{ "",   "bulk",        "Tune output database sessions for bulk loading"  },
+		{ "",   "defer-indexes", "Drop secondary indexes while loading, then rebuild them"  },
+		{ "",   "stage",       "Load into a shadow table, then swap it with the target"  },
+		{ "",   "copy",        "Read Postgres input with COPY in text format"  },
+		{ "",   "copy-csv",    "Read Postgres input with COPY in CSV format"  },
+		{ "",   "binary",      "Read Postgres input in binary instead of text"  },
+		{ "",   "parallel-read <arg>", "Read the input table over <arg> connections"  },
+		{ "",   "split-column <arg>", "Split --parallel-read ranges on column <arg>"  },
+		{ "",   "ordered",     "Keep --parallel-read rows in key order"  },
+		{ "",   "parallel-write <arg>", "Write to the output database over <arg> connections"  },
+		{ "",   "no-pushdown", "Never copy with INSERT ... SELECT on the server"  },
+		{ "",   "pipeline", "Read and write a Postgres to Postgres copy on two threads"  },
+		{ "-L", "limit <arg>",   "Limit the result count to <arg>"  },
+		{ "",   "offset <arg>",  "Skip the first <arg> rows of the input"  },
+		{ "",   "count",       "Count the rows of the input and stop"  },
+		{ "",   "index",       "Keep a line index next to file inputs for later runs"  },
+		{ "",   "progress",    "Show progress (and an ETA with --index) while converting"  },
+		{ "",   "sample <arg>", "Infer file types from <arg> rows, or 'all' of them"  },
+		{ "",   "spread",      "Spread --sample rows across the whole file"  },
+		{ "",   "profile",     "Profile each column of a file input, or tighten --schema with it"  },
+		{ "",   "cache <arg>", "Cache the types inferred for a file layout in directory <arg>"  },
+		{ "",   "refresh-cache", "Infer types again and replace what --cache has"  },
 #if 0
 		{ "-D", "datasource <arg>",   "Use the specified connection string to connect to a database for source data"  },
-		{ "-L", "limit <arg>",   "Limit the result count to <arg>"  },
 		{ "",   "buffer-size <arg>",  "Process only this many rows at a time when reading source data"  },
 #endif
 		{ "-A", "auto",        "Set a default coercion for a specific type (e.g. blob=text)" },
 		{ "-X", "dumpdsn",     "Dump the DSN only. (DEBUG)" },
+		{ "",   "bench-types", "Time the value classifier over a file input. (DEBUG)" },
 		{ "-h", "help",        "Show help." },
 	};
 
@@ -4235,6 +10130,27 @@ static config_t config = {
 	.wspcase = 0,
 	.wid = 0,   // Use a unique ID when reading from a datasource
 	.wstats = 0,   // Use the stats
+	.wbulk = 0,   // Tune output sessions for bulk loading
+	.wdefer = 0,   // Drop secondary indexes during a load
+	.wstage = 0,   // Load into a shadow table and swap
+	.wcopy = COPY_NONE,   // Read Postgres input with COPY
+	.wbinary = 0,   // Read Postgres input in binary
+	.wparallel = 0,   // Read the input over this many connections
+	.wsplitcol = NULL,   // Column to split --parallel-read ranges on
+	.wordered = 0,   // Keep --parallel-read rows in order
+	.wwriters = 0,   // Write the output over this many connections
+	.wnopushdown = 0,   // Always move rows through here
+	.wpipeline = 0,   // Read and write a pipe on separate threads
+	.wlimit = 0,   // Read no more than this many rows
+	.woffset = 0,   // Skip this many rows before reading
+	.windex = 0,   // Keep a sidecar line index next to file inputs
+	.wcount = 0,   // Count the rows of the input only
+	.wprogress = 0,   // Show progress while converting
+	.wsample = SAMPLE_ROWS,   // Rows of a file to infer types from
+	.wspread = 0,   // Spread the --sample rows across the whole file
+	.wprofile = 0,   // Profile every column of a file input
+	.wcache = NULL,   // Directory to cache the types inferred for a file layout in
+	.wrefresh = 0,   // Infer types again, even if they are cached
 	.wcutcols = NULL,  // The user wants to cut columns
 	.widname = NULL,  // The unique ID column name
 	.wcoerce = NULL,  // The user wants to override certain types
@@ -4369,6 +10285,27 @@ void print_config( config_t *config ) {
 	fprintf( stderr, "%-20s= %d\n", "wspcase", config->wspcase );
 	fprintf( stderr, "%-20s= %s\n", "wid", config->wid );
 	fprintf( stderr, "%-20s= %d\n", "wstats", config->wstats );
+	fprintf( stderr, "%-20s= %d\n", "wbulk", config->wbulk );
+	fprintf( stderr, "%-20s= %d\n", "wdefer", config->wdefer );
+	fprintf( stderr, "%-20s= %d\n", "wstage", config->wstage );
+	fprintf( stderr, "%-20s= %d\n", "wcopy", config->wcopy );
+	fprintf( stderr, "%-20s= %d\n", "wbinary", config->wbinary );
+	fprintf( stderr, "%-20s= %d\n", "wparallel", config->wparallel );
+	fprintf( stderr, "%-20s= %s\n", "wsplitcol", config->wsplitcol );
+	fprintf( stderr, "%-20s= %d\n", "wordered", config->wordered );
+	fprintf( stderr, "%-20s= %d\n", "wwriters", config->wwriters );
+	fprintf( stderr, "%-20s= %d\n", "wnopushdown", config->wnopushdown );
+	fprintf( stderr, "%-20s= %d\n", "wpipeline", config->wpipeline );
+	fprintf( stderr, "%-20s= %lu\n", "wlimit", config->wlimit );
+	fprintf( stderr, "%-20s= %lu\n", "woffset", config->woffset );
+	fprintf( stderr, "%-20s= %d\n", "windex", config->windex );
+	fprintf( stderr, "%-20s= %d\n", "wcount", config->wcount );
+	fprintf( stderr, "%-20s= %d\n", "wprogress", config->wprogress );
+	fprintf( stderr, "%-20s= %lu\n", "wsample", config->wsample );
+	fprintf( stderr, "%-20s= %d\n", "wspread", config->wspread );
+	fprintf( stderr, "%-20s= %d\n", "wprofile", config->wprofile );
+	fprintf( stderr, "%-20s= %s\n", "wcache", config->wcache );
+	fprintf( stderr, "%-20s= %d\n", "wrefresh", config->wrefresh );
 	fprintf( stderr, "%-20s= %s\n", "wcutcols", config->wcutcols );
 	fprintf( stderr, "%-20s= %s\n", "widname", config->widname );
 	fprintf( stderr, "%-20s= %s\n", "wcoerce", config->wcoerce );
@@ -4403,6 +10340,7 @@ int main ( int argc, char *argv[] ) {
 	dsn_t input, output;
 	char schema_fmt[ MAX_STMT_SIZE ];
 	struct timespec stimer, etimer;
+	int profileonly = 0;
 
 	// Initialize all the things
 	memset( schema_fmt, 0, MAX_STMT_SIZE );
@@ -4451,9 +10389,75 @@ int main ( int argc, char *argv[] ) {
 			config.wclass = 1, config.wspcase = CASE_CAMEL;
 		else if ( EVALARG( *argv, "-y", "--stats" ) )
 			config.wstats = 1;
+		else if ( !strcmp( *argv, "--bulk" ) )
+			config.wbulk = 1;
+		else if ( !strcmp( *argv, "--defer-indexes" ) )
+			config.wdefer = 1;
+		else if ( !strcmp( *argv, "--stage" ) )
+			config.wstage = 1;
+		else if ( !strcmp( *argv, "--copy" ) )
+			config.wcopy = COPY_TEXT;
+		else if ( !strcmp( *argv, "--copy-csv" ) )
+			config.wcopy = COPY_CSV;
+		else if ( !strcmp( *argv, "--binary" ) )
+			config.wbinary = 1;
+		else if ( !strcmp( *argv, "--parallel-read" ) ) {
+			if ( !*( ++argv ) || ( config.wparallel = atoi( *argv ) ) < 1 ) {
+				return ERRPRINTF( ERRCODE, "%s\n", "--parallel-read needs a number of connections." );
+			}
+		}
+		else if ( !strcmp( *argv, "--split-column" ) && !SAVEARG( argv, config.wsplitcol ) )
+			return ERRPRINTF( ERRCODE, "%s\n", "No argument specified for --split-column." );
+		else if ( !strcmp( *argv, "--ordered" ) )
+			config.wordered = 1;
+		else if ( !strcmp( *argv, "--parallel-write" ) ) {
+			if ( !*( ++argv ) || ( config.wwriters = atoi( *argv ) ) < 1 ) {
+				return ERRPRINTF( ERRCODE, "%s\n", "--parallel-write needs a number of connections." );
+			}
+		}
+		else if ( !strcmp( *argv, "--no-pushdown" ) )
+			config.wnopushdown = 1;
+		else if ( !strcmp( *argv, "--pipeline" ) )
+			config.wpipeline = 1;
+		else if ( EVALARG( *argv, "-L", "--limit" ) ) {
+			char *end = NULL;
+			if ( !*( ++argv ) || !isdigit( **argv ) || !( config.wlimit = strtoul( *argv, &end, 10 ) ) || *end ) {
+				return ERRPRINTF( ERRCODE, "%s\n", "--limit needs a number of rows." );
+			}
+		}
+		else if ( !strcmp( *argv, "--offset" ) ) {
+			char *end = NULL;
+			if ( !*( ++argv ) || !isdigit( **argv ) || ( config.woffset = strtoul( *argv, &end, 10 ), *end ) ) {
+				return ERRPRINTF( ERRCODE, "%s\n", "--offset needs a number of rows." );
+			}
+		}
+		else if ( !strcmp( *argv, "--count" ) )
+			config.wcount = 1;
+		else if ( !strcmp( *argv, "--index" ) )
+			config.windex = 1;
+		else if ( !strcmp( *argv, "--progress" ) )
+			config.wprogress = 1;
+		else if ( !strcmp( *argv, "--sample" ) ) {
+			char *end = NULL;
+			if ( *( ++argv ) && !strcmp( *argv, "all" ) )
+				config.wsample = 0;
+			else if ( !*argv || !isdigit( **argv ) || !( config.wsample = strtoul( *argv, &end, 10 ) ) || *end ) {
+				return ERRPRINTF( ERRCODE, "%s\n", "--sample needs a number of rows or 'all'." );
+			}
+		}
+		else if ( !strcmp( *argv, "--spread" ) )
+			config.wspread = 1;
+		else if ( !strcmp( *argv, "--profile" ) )
+			config.wprofile = 1;
+		else if ( !strcmp( *argv, "--cache" ) && !SAVEARG( argv, config.wcache ) )
+			return ERRPRINTF( ERRCODE, "%s\n", "No directory specified for --cache." );
+		else if ( !strcmp( *argv, "--refresh-cache" ) )
+			config.wrefresh = 1;
 	#ifdef DEBUG_H
 		else if ( DEVAL( EVALARG( *argv, "-X", "--dumpdsn" ) ) ) 
 			config.wdumpdsn = 1;
+		else if ( !strcmp( *argv, "--bench-types" ) )
+			config.wbenchtypes = 1;
 	#endif
 		else if ( EVALARG( *argv, "-R", "--row-delimiter" ) && !SAVEARG( argv, config.wrowd ) )
 			return ERRPRINTF( ERRCODE, "%s\n", "No argument specified for --coerce." );
@@ -4560,6 +10564,11 @@ int main ( int argc, char *argv[] ) {
 		return ERRPRINTF( ERRCODE, "Selected stream '%s' is invalid.", config.wstype );
 	}
 
+	// The stage table is already loaded without its indexes
+	if ( config.wstage && config.wdefer ) {
+		return ERRPRINTF( ERRCODE, "%s\n", "--defer-indexes can't be used with --stage, which already builds indexes after the load." );
+	}
+
 	// The datasource names are dynamically allocated right now.
 	// Stick to that until we can get back to it...
 	// TODO: Connection strings should be statically allocated
@@ -4592,9 +10601,12 @@ int main ( int argc, char *argv[] ) {
 
 	// If the user didn't actually specify an action, we should close and tell them that
 	// what they did is useless.
-	if ( !config.wconvert && !config.wschema && !config.wheaders )
+	if ( !config.wconvert && !config.wschema && !config.wheaders && !config.wcount && !config.wprofile && !DEVAL( config.wbenchtypes ) )
 		return ERRPRINTF( ERRCODE, "No action specified, exiting.\n" );
 
+	// --profile on its own just dumps the profile
+	profileonly = config.wprofile && !config.wconvert && !config.wschema;
+
 	// The dsn is always going to be the input
 	if ( !parse_dsn_info( &input, err, sizeof( err  ) ) ) {
 		close_dsn( &input );
@@ -4605,15 +10617,22 @@ int main ( int argc, char *argv[] ) {
 	if ( config.wtable && strlen( config.wtable ) < sizeof( input.tablename ) )
 		snprintf( input.tablename, sizeof( input.tablename ), "%s", config.wtable );
 
+	// Mark the input source as an input source (open_dsn() depends on this)
+	input.input = 1;
+
+	// Scaffold before opening, so that a pushdown never runs the input query
+	if ( !config.wheaders && !config.wcount && !profileonly && !DEVAL( config.wbenchtypes ) && !scaffold_dsn( &config, &input, &output, err, sizeof( err ) ) ) {
+		close_dsn( &input );
+		close_dsn( &output );
+		return ERRPRINTF( ERRCODE, "%s", err );
+	}
+
 	// Open the DSN first (regardless of type)
 	if ( !open_dsn( &input, &config, err, sizeof( err ) ) ) {
 		close_dsn( &input );
 		return ERRPRINTF( ERRCODE, "DSN open failed: %s\n", err );
 	}
 
-	// Mark the input source as an input source
-	input.input = 1;
-
 	// Create the header_t here
 	if ( !headers_from_dsn( &input, &config, err, sizeof( err ) ) ) {
 		close_dsn( &input );
@@ -4628,44 +10647,73 @@ int main ( int argc, char *argv[] ) {
 		return 0;
 	}
 
-	// Scaffolding can fail
-	if ( !scaffold_dsn( &config, &input, &output, err, sizeof( err ) ) ) {
-		close_dsn( &input );
-		close_dsn( &output );
-		return ERRPRINTF( ERRCODE, "%s", err );
-	}
-
 	// output should be marked too
 	output.input = 0;
 
 	// The input datasource has to be prepared too
-	if ( !prepare_dsn_for_read( &input, err, sizeof( err ) ) ) {
-		destroy_dsn_headers( &input );
+	if ( !prepare_dsn_for_read( &input, &config, err, sizeof( err ) ) ) {
 		close_dsn( &input );
+		destroy_dsn_headers( &input );
 		return ERRPRINTF( ERRCODE, "Failed to prepare DSN: %s.\n", err );
 	}
 
+#ifdef DEBUG_H
+	// Compare the classifiers only
+	if ( config.wbenchtypes ) {
+		if ( !bench_types( &input, err, sizeof( err ) ) ) {
+			close_dsn( &input );
+			destroy_dsn_headers( &input );
+			return ERRPRINTF( ERRCODE, "Benchmark failed: %s\n", err );
+		}
+		close_dsn( &input );
+		destroy_dsn_headers( &input );
+		return 0;
+	}
+#endif
+
+	// Count the rows only
+	if ( config.wcount ) {
+		if ( !cmd_count( &input, &config, err, sizeof( err ) ) ) {
+			close_dsn( &input );
+			destroy_dsn_headers( &input );
+			return ERRPRINTF( ERRCODE, "Count failed: %s\n", err );
+		}
+		close_dsn( &input );
+		return 0;
+	}
+
+	// Profile the columns only
+	if ( profileonly ) {
+		if ( !cmd_profile( &input, &config, err, sizeof( err ) ) ) {
+			close_dsn( &input );
+			destroy_dsn_headers( &input );
+			return ERRPRINTF( ERRCODE, "Profile failed: %s\n", err );
+		}
+		close_dsn( &input );
+		return 0;
+	}
+
 	// This should assert, but we check it anyway 
 	if ( !input.typemap || !output.typemap ) {
-		destroy_dsn_headers( &input );
 		close_dsn( &input );
+		destroy_dsn_headers( &input );
 		return ERRPRINTF( ERRCODE, "Failed to prepare DSN: %s.\n", err );
 	}
 
 	// Get the types of each thing in the column
 	if ( !types_from_dsn( &input, &output, &config, err, sizeof( err ) ) ) {
-		destroy_dsn_headers( &input );
 		close_dsn( &input );
 		close_dsn( &output );
+		destroy_dsn_headers( &input );
 		return ERRPRINTF( ERRCODE, "typeget failed: %s\n", err );
 	}
 
 	// Create a schema
 	if ( config.wschema ) {
 		if ( !schema_from_dsn( &input, &output, schema_fmt, MAX_STMT_SIZE, err, sizeof( err ) ) ) {
-			destroy_dsn_headers( &input );
 			close_dsn( &output );
 			close_dsn( &input );
+			destroy_dsn_headers( &input );
 			return ERRPRINTF( ERRCODE, "Schema build failed: %s\n", err );
 		}
 
@@ -4684,6 +10732,11 @@ int main ( int argc, char *argv[] ) {
 			else if ( output.type == DB_POSTGRESQL ) {
 				output.stream = STREAM_PGSQL;
 			}
+		#ifdef BSQLITE_H
+			else if ( output.type == DB_SQLITE ) {
+				output.stream = STREAM_SQLITE;
+			}
+		#endif
 		}
 
 #if 1
@@ -4692,8 +10745,8 @@ int main ( int argc, char *argv[] ) {
 		// Test and try to create if it does not exist
 		if ( !test_dsn( &output, err, sizeof( err ) ) && !create_dsn( &input, &output, err, sizeof( err ) ) ) {
 			//close_dsn( &output );
-			destroy_dsn_headers( &input );
 			close_dsn( &input );
+			destroy_dsn_headers( &input );
 			return ERRPRINTF( ERRCODE, "Output DSN '%s' is inaccessible or could not be created: %s\n", output.connstr, err );
 		}
 	#else
@@ -4707,8 +10760,8 @@ int main ( int argc, char *argv[] ) {
 
 		// Open the output dsn
 		if ( !open_dsn( &output, &config, err, sizeof( err ) ) ) {
-			destroy_dsn_headers( &input );
 			close_dsn( &input );
+			destroy_dsn_headers( &input );
 			return ERRPRINTF( ERRCODE, "DSN open failed: %s\n", err );
 		}
 
@@ -4718,13 +10771,61 @@ int main ( int argc, char *argv[] ) {
 	fprintf( stderr, "[ CONFIG ]\n" ), print_config( &config );	
 #endif
 
-		// Try to prepare
-		if ( !prepare_dsn_for_write( &output, &input, err, sizeof( err ) ) ) {
+		// Split the read across several connections if asked
+		if ( config.wparallel > 1 && !start_readers( &input, &config, err, sizeof( err ) ) ) {
+			close_dsn( &input );
+			close_dsn( &output );
+			destroy_dsn_headers( &input );
+			return ERRPRINTF( ERRCODE, "Failed to start parallel read: %s\n", err );
+		}
+
+		// Load into a shadow table if asked
+		if ( config.wstage && !stage_dsn( &input, &output, err, sizeof( err ) ) ) {
+			abort_stage( &output );
+			close_dsn( &input );
+			close_dsn( &output );
+			destroy_dsn_headers( &input );
+			return ERRPRINTF( ERRCODE, "Failed to create staging table: %s\n", err );
+		}
+
+		// Only pipe COPY data into a table with the same column types
+		if ( output.pipe && !check_pipe( &config, &input, &output, err, sizeof( err ) ) ) {
+			if ( config.wstage ) {
+				abort_stage( &output );
+			}
+			close_dsn( &input );
+			close_dsn( &output );
 			destroy_dsn_headers( &input );
+			return ERRPRINTF( ERRCODE, "Failed to start reading input: %s\n", err );
+		}
+
+		// Try to prepare (pushdowns and pipes write nothing from here)
+		if ( !output.pushdown && !output.pipe && !prepare_dsn_for_write( &output, &input, err, sizeof( err ) ) ) {
+			if ( config.wstage ) {
+				abort_stage( &output );
+			}
 			close_dsn( &input );
+			destroy_dsn_headers( &input );
 			return ERRPRINTF( ERRCODE, "Prepare output DSN failed: %s\n", err );
 		}
 
+		// Share the writes between several connections if asked
+		if ( config.wwriters > 1 && !start_writers( &output, &input, &config, err, sizeof( err ) ) ) {
+			unprepare_dsn( &output );
+			close_dsn( &output );
+			close_dsn( &input );
+			destroy_dsn_headers( &input );
+			return ERRPRINTF( ERRCODE, "Failed to start parallel writes: %s\n", err );
+		}
+
+		// Drop secondary indexes and constraints until the load is done
+		if ( config.wdefer && !defer_ddl( &output, err, sizeof( err ) ) ) {
+			close_dsn( &input );
+			close_dsn( &output );
+			destroy_dsn_headers( &input );
+			return ERRPRINTF( ERRCODE, "Failed to defer indexes: %s\n", err );
+		}
+
 
 		// Set these automatically... 
 		if ( output.stream == STREAM_RAW ) {
@@ -4741,13 +10842,56 @@ print_dsn( &output );
 
 		// Need to write a "pre" node in some cases
 
-		// Control the streaming / buffering from here
-		for ( int i = 0; i < 1; i++ ) {
+		// An index knows the total up front, so progress can give an ETA
+		struct timespec pstart;
+		unsigned long ptotal = 0;
+		if ( config.wprogress ) {
+			char perr[ ERRLEN ] = { 0 };
+			clock_gettime( CLOCK_MONOTONIC, &pstart );
+			if ( input.type == DB_FILE && ( (file_t *)input.conn )->index ) {
+				count_dsn( &input, &config, &ptotal, perr, sizeof( perr ) );
+			}
+		}
+
+		// Let the server copy the table itself, or pass Postgres COPY data through
+		if ( ( output.pushdown && !pushdown_dsn( &config, &input, &output, err, sizeof( err ) ) ) 
+			|| ( output.pipe && !pipe_dsn( &config, &input, &output, err, sizeof( err ) ) ) ) {
+			char rerr[ ERRLEN ] = { 0 };
+			if ( config.wdefer && !recreate_ddl( &output, 0, rerr, sizeof( rerr ) ) ) {
+				fprintf( stderr, "%s\n", rerr );
+			}
+			if ( config.wstage ) {
+				abort_stage( &output );
+			}
+			close_dsn( &output );
+			close_dsn( &input );
+			destroy_dsn_headers( &input );
+			return ERRPRINTF( ERRCODE, "Failed to copy table: %s.\n", err );
+		}
+
+		// Control the streaming / buffering from here (unless that did it)
+		for ( ; !output.pushdown && !output.pipe; ) {
+			// --limit cuts the last batch short (databases already stop at it)
+			int count = ( config.wlimit && config.wlimit - input.rtotal < BATCH_SIZE ) ? config.wlimit - input.rtotal : BATCH_SIZE;
+
+			if ( !count ) {
+				break;
+			}
 
 			// Stream to records
-			if ( !records_from_dsn( &input, 1000, 0, err, sizeof( err ) ) ) {
-				destroy_dsn_headers( &input );
+			if ( !records_from_dsn( &input, count, input.rtotal, err, sizeof( err ) ) ) {
+				char rerr[ ERRLEN ] = { 0 };
+				if ( output.writers ) {
+					stop_writers( &output );
+				}
+				if ( config.wdefer && !recreate_ddl( &output, 0, rerr, sizeof( rerr ) ) ) {
+					fprintf( stderr, "%s\n", rerr );
+				}
+				if ( config.wstage ) {
+					abort_stage( &output );
+				}
 				close_dsn( &input );
+				destroy_dsn_headers( &input );
 				return ERRPRINTF( ERRCODE, "Failed to generate records from data source: %s.\n", err );
 			}
 
@@ -4757,20 +10901,86 @@ print_dsn( &output );
 			}
 			#endif
 
-			// Do the transport (buffering can be added pretty soon)
-			if ( !transform_from_dsn( &input, &output, 0, 0, err, sizeof(err) ) ) {
+			// Stop once the source runs dry
+			if ( !input.rlen ) {
+				break;
+			}
+
+			// Do the transport (the offset tells it whether this is the first batch), or let the writers do it
+			if ( ( output.writers ) ? !queue_rows( &input, &output, err, sizeof( err ) ) : !transform_from_dsn( &input, &output, 0, input.rtotal, err, sizeof(err) ) ) {
 				fprintf( stderr, "Failed to transform records from data source: %s\n", err );
-				destroy_dsn_headers( &input );
+				if ( output.writers ) {
+					stop_writers( &output );
+				}
+				if ( config.wdefer && !recreate_ddl( &output, 0, err, sizeof( err ) ) ) {
+					fprintf( stderr, "%s\n", err );
+				}
+				if ( config.wstage ) {
+					abort_stage( &output );
+				}
 				close_dsn( &input );
+				destroy_dsn_headers( &input );
 				return 1;
 			}
 			// Destroy the rows
+			input.rtotal += input.rlen;
 			destroy_dsn_rows( &input );
+
+			if ( config.wprogress ) {
+				print_progress( input.rtotal, ptotal, &pstart, 0 );
+			}
 		} // end for
 
+		if ( config.wprogress ) {
+			print_progress( input.rtotal, ptotal, &pstart, 1 );
+		}
+
+		// Wait for the writers to catch up
+		if ( output.writers && !finish_writers( &output, err, sizeof( err ) ) ) {
+			fprintf( stderr, "Failed to write records: %s\n", err );
+			if ( config.wdefer && !recreate_ddl( &output, 0, err, sizeof( err ) ) ) {
+				fprintf( stderr, "%s\n", err );
+			}
+			unprepare_dsn( &output );
+			close_dsn( &output );
+			close_dsn( &input );
+			destroy_dsn_headers( &input );
+			return ERRCODE;
+		}
+
+		// Put the shadow table in place of the real one
+		if ( config.wstage && !swap_stage( &output, err, sizeof( err ) ) ) {
+			fprintf( stderr, "Failed to swap staging table: %s\n", err );
+			abort_stage( &output );
+			unprepare_dsn( &output );
+			close_dsn( &output );
+			close_dsn( &input );
+			destroy_dsn_headers( &input );
+			return ERRCODE;
+		}
+
+		// Commit anything the output is still holding
+		if ( !finish_dsn_for_write( &output, err, sizeof( err ) ) ) {
+			fprintf( stderr, "Failed to finish writing records: %s\n", err );
+			unprepare_dsn( &output );
+			close_dsn( &output );
+			close_dsn( &input );
+			destroy_dsn_headers( &input );
+			return ERRCODE;
+		}
+
 		// once we get to the end, "dismount" whatever preparations we made
 		unprepare_dsn( &output );
 
+		// Rebuild anything --defer-indexes dropped
+		if ( config.wdefer && !recreate_ddl( &output, 1, err, sizeof( err ) ) ) {
+			fprintf( stderr, "%s\n", err );
+			close_dsn( &output );
+			close_dsn( &input );
+			destroy_dsn_headers( &input );
+			return ERRCODE;
+		}
+
 		// close our open data source
 		close_dsn( &output );
 	}
@@ -4778,17 +10988,22 @@ print_dsn( &output );
 	// Show the stats if we did that
 	if ( config.wstats ) {
 		clock_gettime( CLOCK_REALTIME, &etimer );
-		fprintf( stdout, "%d record(s) copied...\n", input.rlen );
+		fprintf( stdout, "%lu record(s) copied...\n", input.rtotal );
 		fprintf( stdout, "Time elapsed: %ld.%ld\n",
 			etimer.tv_sec - stimer.tv_sec,
 			etimer.tv_nsec - stimer.tv_nsec
 		);
+
+		// Show anything --bulk changed
+		if ( config.wbulk ) {
+			print_bulk_profile( &output );
+		}
 	}
 
+	// Close the DSN (this waits for any readers still using the headers)
+	close_dsn( &input );
+
 	// Destroy the headers
 	destroy_dsn_headers( &input );
-
-	// Close the DSN
-	close_dsn( &input );
 	return 0;
 }